@@ -0,0 +1,101 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+// Minimal CBOR (RFC 8949) primitives for the sysutils wire protocol.
+//
+// Only what the protocol needs: integers, text strings, booleans, null,
+// floats on input, and maps/arrays of either length form. Writers always use
+// indefinite-length maps and arrays so a message can be streamed without
+// knowing member counts up front. On a stream socket each CBOR message is
+// preceded by its length as a 4-byte big-endian integer.
+
+#ifndef SYSUTIL_CBOR_H
+#define SYSUTIL_CBOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sysutil {
+
+enum class CborMajor : std::uint8_t {
+  Unsigned = 0,
+  Negative = 1,
+  Bytes = 2,
+  Text = 3,
+  Array = 4,
+  Map = 5,
+  Tag = 6,
+  Simple = 7,
+};
+
+// Additional-info value that marks an indefinite length, and the break byte
+// that ends such an item.
+constexpr std::uint8_t kCborIndefinite = 31;
+constexpr char kCborBreak = static_cast<char>(0xFF);
+constexpr char kCborFalse = static_cast<char>(0xF4);
+constexpr char kCborTrue = static_cast<char>(0xF5);
+constexpr char kCborNull = static_cast<char>(0xF6);
+// Length prefix in front of every CBOR message on a stream socket.
+constexpr std::size_t kCborFramePrefix = 4;
+
+// Decoded initial byte plus argument of one data item.
+struct CborHead {
+  CborMajor major = CborMajor::Simple;
+  // Low five bits of the initial byte.
+  std::uint8_t info = 0;
+  // Length, count or integer value; the raw bits for floats.
+  std::uint64_t value = 0;
+  // Bytes taken by the head itself.
+  std::size_t size = 0;
+  bool indefinite() const { return info == kCborIndefinite; }
+};
+
+// Decodes the head at pos. Returns false when it is truncated or reserved.
+bool read_cbor_head(std::string_view data, std::size_t pos, CborHead& head);
+// Returns the offset just past the data item at pos, or npos when the item is
+// malformed, truncated or nested too deeply.
+std::size_t skip_cbor_item(std::string_view data, std::size_t pos);
+// Decodes a text string item (either length form) into out.
+bool read_cbor_text(std::string_view item, std::string& out);
+// Decodes an integer or float item as a double.
+bool read_cbor_number(std::string_view item, double& out);
+
+void append_cbor_head(std::string& out, CborMajor major, std::uint64_t value);
+void append_cbor_text(std::string& out, std::string_view text);
+void append_cbor_int(std::string& out, long long value);
+void append_cbor_uint(std::string& out, unsigned long long value);
+void append_cbor_double(std::string& out, double value);
+
+// Reserves the length prefix of a message that starts at out.size().
+std::size_t begin_cbor_frame(std::string& out);
+// Fills in the prefix reserved at start with the bytes written since.
+void finish_cbor_frame(std::string& out, std::size_t start);
+// Reads a frame prefix. Returns false when fewer than four bytes are given.
+bool read_cbor_frame_length(std::string_view data, std::uint32_t& length);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_CBOR_H
@@ -24,81 +24,14 @@
 #ifndef SYSUTIL_CONFIG_H
 #define SYSUTIL_CONFIG_H
 
+#include <cstdint>
+#include <memory>
 #include <optional>
-#include <string>
 
-namespace sysutil {
+// SysutilConfig and kConfigFields are generated from misc/sysutil_config.json.
+#include "config_generated.h"
 
-struct SysutilConfig {
-  // Cached platform type id (if known).
-  std::optional<int> platform_type;
-  // Cached platform name (if known).
-  std::optional<std::string> platform_name;
-  // Persisted debug flag.
-  std::optional<bool> debug_enabled;
-  // Enable hostname updates from sysutils.
-  std::optional<bool> set_hostname;
-  // Pending OpenHD reset request.
-  std::optional<bool> reset_requested;
-  // Selected camera type id.
-  std::optional<int> camera_type;
-  // Selected secondary camera type id.
-  std::optional<int> camera2_type;
-  // Selected primary camera resolution/fps string, e.g. 1280x720@60.
-  std::optional<std::string> camera_resolution_fps;
-  // Selected secondary camera resolution/fps string, e.g. 640x480@30.
-  std::optional<std::string> camera2_resolution_fps;
-  // Raspberry Pi 5 CSI connector selection ("cam0" or "cam1").
-  std::optional<std::string> camera_port;
-  std::optional<std::string> camera2_port;
-  // Initial IP-camera settings supplied by ImageWriter.
-  std::optional<std::string> ip_camera_address;
-  std::optional<std::string> ip_camera_pipeline;
-  std::optional<std::string> camera2_ip_camera_address;
-  std::optional<std::string> camera2_ip_camera_pipeline;
-  std::optional<int> ip_camera_bitrate_mbits;
-  // Requested boot mode ("air" or "ground").
-  std::optional<std::string> run_mode;
-  // First-boot gate for one-time detection tasks.
-  std::optional<bool> firstboot;
-  // Detected init system (e.g. systemd or init.d).
-  std::optional<std::string> init_system;
-  // Detected shell type (e.g. busybox or bash).
-  std::optional<std::string> shell;
-  // WiFi hardware configuration.
-  std::optional<bool> wifi_enable_autodetect;
-  std::optional<std::string> wifi_wb_link_cards;
-  std::optional<std::string> wifi_hotspot_card;
-  std::optional<bool> wifi_monitor_card_emulate;
-  std::optional<bool> wifi_force_no_link_but_hotspot;
-  std::optional<bool> wifi_local_network_enable;
-  std::optional<std::string> wifi_local_network_ssid;
-  std::optional<std::string> wifi_local_network_password;
-  // Networking configuration.
-  std::optional<std::string> nw_ethernet_card;
-  std::optional<std::string> nw_manual_forwarding_ips;
-  std::optional<bool> nw_forward_to_localhost_58xx;
-  // Ethernet link configuration.
-  std::optional<std::string> ground_unit_ip;
-  std::optional<std::string> air_unit_ip;
-  std::optional<int> video_port;
-  std::optional<int> telemetry_port;
-  // Microhard link configuration.
-  std::optional<bool> disable_microhard_detection;
-  std::optional<bool> force_microhard;
-  std::optional<std::string> microhard_username;
-  std::optional<std::string> microhard_password;
-  std::optional<std::string> microhard_ip_air;
-  std::optional<std::string> microhard_ip_ground;
-  std::optional<std::string> microhard_ip_range;
-  std::optional<int> microhard_video_port;
-  std::optional<int> microhard_telemetry_port;
-  // Generic configuration.
-  std::optional<bool> gen_enable_last_known_position;
-  std::optional<int> gen_rf_metrics_level;
-  // Service control.
-  std::optional<bool> disable_openhd_service;
-};
+namespace sysutil {
 
 // Result of attempting to load the config file.
 enum class ConfigLoadResult {
@@ -107,9 +40,35 @@ enum class ConfigLoadResult {
   Error,
 };
 
+// Immutable view of the config file shared between threads. A new snapshot
+// is published whenever the file is reloaded or rewritten.
+struct ConfigSnapshot {
+  ConfigLoadResult result = ConfigLoadResult::NotFound;
+  SysutilConfig config;
+  // Increases by one each time a snapshot with different values is published.
+  std::uint64_t generation = 0;
+};
+
 // Returns the on-disk sysutils config path.
 const char* sysutil_config_path();
-// Loads config values from disk into the provided struct.
+// True when the config holds a value for the field.
+bool config_has_field(const SysutilConfig& config, const ConfigField& field);
+// True when both configs hold the same value (or both none) for the field.
+bool config_field_equal(const SysutilConfig& a, const SysutilConfig& b,
+                        const ConfigField& field);
+// Identifies this daemon run: random, non-zero and below 2^53 so JSON clients
+// keep every bit. Generations restart at 1 on every start, so a generation is
+// only meaningful together with the epoch it was reported with.
+std::uint64_t config_epoch();
+// Returns the fields changed after generation since up to and including
+// until, as a bitmask over kConfigFields indices. nullopt when the journal no
+// longer covers the range and the caller must send everything.
+std::optional<std::uint64_t> config_changes_between(std::uint64_t since,
+                                                    std::uint64_t until);
+// Returns the current config snapshot. Reads the file only when the cache was
+// invalidated; otherwise this costs a shared_ptr copy.
+std::shared_ptr<const ConfigSnapshot> sysutil_config_snapshot();
+// Copies the current snapshot into the provided struct (for read-modify-write).
 ConfigLoadResult load_sysutil_config(SysutilConfig& config);
 // Writes config values only if the config file does not yet exist.
 bool write_sysutil_config_if_missing(const SysutilConfig& config);
@@ -117,6 +76,14 @@ bool write_sysutil_config_if_missing(const SysutilConfig& config);
 bool write_sysutil_config(const SysutilConfig& config);
 // Removes the config file if it exists.
 bool remove_sysutil_config();
+// Starts an inotify watch on the config directory and returns its fd, or -1.
+// The caller polls the fd and calls handle_sysutil_config_watch() when it is
+// readable. Without a watch every snapshot read stats the file instead.
+int open_sysutil_config_watch();
+// Drains the watch fd and invalidates the cache on external changes.
+void handle_sysutil_config_watch();
+// Closes the watch fd.
+void close_sysutil_config_watch();
 
 }  // namespace sysutil
 
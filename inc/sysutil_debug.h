@@ -27,20 +27,20 @@
 #include <optional>
 #include <string>
 
+#include "sysutil_protocol.h"
+
 namespace sysutil {
 
 // Initializes debug state by reading config and scanning debug.txt triggers.
 void init_debug_info();
 // Returns whether debug is enabled.
 bool debug_enabled();
-// Tests if the incoming message requests debug state.
-bool is_debug_request(const std::string& line);
-// Builds the debug response JSON payload.
-std::string build_debug_response();
-// Tests if the incoming message updates debug state.
-bool is_debug_update(const std::string& line);
-// Applies a debug update request and returns a response payload.
-std::string handle_debug_update(const std::string& line);
+// Registers the debug request handlers with the dispatcher.
+void register_debug_handlers();
+// Writes the debug response JSON payload.
+void build_debug_response(JsonWriter& out);
+// Applies a debug update request and writes the response payload.
+void handle_debug_update(const ParsedMessage& request, JsonWriter& out);
 // Syncs the OpenHD debug marker and optionally restarts OpenHD services.
 bool apply_openhd_debug_marker(const std::optional<bool>& enabled,
                                bool restart_services);
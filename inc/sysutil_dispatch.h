@@ -0,0 +1,78 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#ifndef SYSUTIL_DISPATCH_H
+#define SYSUTIL_DISPATCH_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "sysutil_protocol.h"
+
+namespace sysutil {
+
+// Writes the response line for a single indexed request into response.
+using RequestHandler =
+    std::function<void(const ParsedMessage& request, JsonWriter& response)>;
+// Returns a value that changes whenever the state behind a response does.
+using ResponseGeneration = std::function<std::uint64_t()>;
+
+struct RequestHandlerInfo {
+  // Request "type" value the handler answers, e.g. sysutil.platform.request.
+  std::string type;
+  RequestHandler handler;
+  // Worker lane for handlers that block (subprocesses, sockets, sysfs
+  // probes). Empty means the handler is fast and runs on the socket thread.
+  std::string lane;
+};
+
+// Registers a handler for a request type. Modules call this at startup from
+// their register_*_handlers() function. Returns false if the type is taken.
+bool register_request_handler(const std::string& type, RequestHandler handler,
+                              const std::string& lane = {});
+// Registers a read-only handler whose response is kept and replayed for plain
+// requests (no members besides "type" and "id") until generation() changes.
+// generation() runs before every request and must be cheap.
+bool register_cached_request_handler(const std::string& type,
+                                     RequestHandler handler,
+                                     ResponseGeneration generation,
+                                     const std::string& lane = {});
+// Runs info's handler. If it throws, whatever it wrote is discarded and a
+// sysutil.error response (echoing the request "id") is written instead, so
+// every request still gets exactly one response.
+void run_request_handler(const RequestHandlerInfo& info,
+                         const ParsedMessage& request, JsonWriter& response);
+// Writes a sysutil.error response line.
+void build_error_response(JsonWriter& out, std::string_view message);
+// Looks up the handler for a request type; returns nullptr when unknown.
+const RequestHandlerInfo* find_request_handler(std::string_view type);
+// Returns all registered handlers in registration order.
+const std::deque<RequestHandlerInfo>& request_handlers();
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_DISPATCH_H
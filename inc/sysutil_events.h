@@ -0,0 +1,79 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+// Server-push events for subscribed sysutils clients.
+//
+// Modules publish when their state changes; the socket server installs a sink
+// that fans the event out to connections subscribed to the topic. Payloads
+// are only built when at least one client listens.
+
+#ifndef SYSUTIL_EVENTS_H
+#define SYSUTIL_EVENTS_H
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace sysutil {
+
+enum class EventTopic {
+  Status,
+  Wifi,
+  Update,
+  Partitions,
+  Debug,
+};
+
+constexpr std::size_t kEventTopicCount = 5;
+
+// Receives built event lines. Called on the publishing thread.
+using EventSink = std::function<void(EventTopic topic, std::string payload)>;
+
+// Returns the wire name of a topic, e.g. "status".
+const char* event_topic_name(EventTopic topic);
+// Parses a wire topic name.
+std::optional<EventTopic> parse_event_topic(std::string_view name);
+// Installs the sink that delivers events (nullptr disables delivery).
+void set_event_sink(EventSink sink);
+// Tracks subscriber counts so publishers can skip building unused payloads.
+void add_event_subscriber(EventTopic topic);
+void remove_event_subscriber(EventTopic topic);
+bool has_event_subscribers(EventTopic topic);
+// Hands a built event to the sink.
+void deliver_event(EventTopic topic, std::string payload);
+
+// Builds and delivers an event when the topic has subscribers. The builder
+// is not called otherwise, so publishing from hot paths is a single load.
+template <typename Builder>
+void publish_event(EventTopic topic, Builder&& build) {
+  if (has_event_subscribers(topic)) {
+    deliver_event(topic, build());
+  }
+}
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_EVENTS_H
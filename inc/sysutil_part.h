@@ -33,6 +33,8 @@
 #include <string>
 #include <vector>
 
+#include "sysutil_protocol.h"
+
 namespace sysutil {
 
 struct PartitionInfo {
@@ -78,11 +80,15 @@ bool resize_partition_firstboot();
 // Also exposes legacy /config and /conf aliases when /Config is mounted.
 void mount_known_partitions();
 
-// Builds a JSON response with the current partition layout.
-std::string build_partitions_response();
+// Writes a JSON response with the current partition layout.
+void build_partitions_response(JsonWriter& out);
 
 // Handles resize requests (placeholder for future partitioning flows).
-std::string handle_partition_resize_request(const std::string& choice);
+void handle_partition_resize_request(const std::string& choice,
+                                     JsonWriter& out);
+
+// Registers the partition request handlers with the dispatcher.
+void register_part_handlers();
 
 }  // namespace sysutil
 
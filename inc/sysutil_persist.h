@@ -0,0 +1,97 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Crash-safe, debounced file persistence for the small config files the
+// daemon owns on the SD card.
+//
+// Every write goes to a temp file that is fsynced and renamed over the target,
+// followed by an fsync of the directory, so a power cut leaves either the old
+// or the new file. Writes whose bytes match the file on disk are skipped.
+// Scheduled writes are coalesced per path over a short window on a background
+// thread; read_persisted_file() sees queued bytes before they hit the disk.
+
+#ifndef SYSUTIL_PERSIST_H
+#define SYSUTIL_PERSIST_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sysutil {
+
+// Identifies one version of a file on disk.
+struct FileStamp {
+  bool exists = false;
+  dev_t device = 0;
+  ino_t inode = 0;
+  off_t size = 0;
+  std::int64_t mtime_ns = 0;
+
+  bool operator==(const FileStamp& other) const {
+    return exists == other.exists && device == other.device &&
+           inode == other.inode && size == other.size &&
+           mtime_ns == other.mtime_ns;
+  }
+  bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+// Counters for tracking flash wear.
+struct PersistStats {
+  // Bytes handed to write(2) for temp files.
+  std::uint64_t bytes_written = 0;
+  // Files replaced on disk.
+  std::uint64_t files_written = 0;
+  // Writes dropped because the file already held the same bytes.
+  std::uint64_t writes_skipped = 0;
+  // Scheduled writes superseded by a newer one before they were written.
+  std::uint64_t writes_coalesced = 0;
+};
+
+// Returns the stamp of path (exists == false when it cannot be stat'ed).
+FileStamp stat_file_stamp(const std::string& path);
+// Writes content to path now, atomically. Creates the parent directory.
+bool write_file_atomic(const std::string& path, std::string_view content);
+// Queues content for path. Without a running persist worker this writes
+// synchronously; otherwise failures are only logged.
+bool schedule_file_write(const std::string& path, std::string content);
+// Drops a queued write for path, e.g. before removing the file.
+void discard_file_write(const std::string& path);
+// Reads the newest content of path: queued bytes if a write is pending,
+// otherwise the file. Returns false when neither is available.
+bool read_persisted_file(const std::string& path, std::string& content);
+// True when path on disk is exactly the version this layer last wrote.
+bool persisted_file_is_current(const std::string& path);
+// Writes every queued file now. Call before reboot.
+bool flush_persisted_files();
+// Starts the background writer. Calling it again is a no-op.
+void start_persist_worker();
+// Flushes queued writes and joins the background writer.
+void stop_persist_worker();
+// Returns a copy of the persistence counters.
+PersistStats persist_stats();
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_PERSIST_H
@@ -26,6 +26,8 @@
 
 #include <string>
 
+#include "sysutil_protocol.h"
+
 namespace sysutil {
 
 struct PlatformInfo {
@@ -39,16 +41,14 @@ struct PlatformInfo {
 PlatformInfo discover_platform_info();
 // Initializes cached platform info (loading config or detecting when needed).
 void init_platform_info();
-// Returns the cached platform info, initializing on first use.
-const PlatformInfo& platform_info();
-// Tests if the incoming message is a platform request.
-bool is_platform_request(const std::string& line);
-  // Builds the platform response JSON payload.
-  std::string build_platform_response();
-  // Tests if the incoming message requests platform update or refresh.
-  bool is_platform_update_request(const std::string& line);
-  // Handles platform update/refresh requests and returns response JSON.
-  std::string handle_platform_update(const std::string& line);
+// Returns a copy of the cached platform info, initializing on first use.
+PlatformInfo platform_info();
+// Registers the platform request handlers with the dispatcher.
+void register_platform_handlers();
+  // Writes the platform response JSON payload.
+  void build_platform_response(JsonWriter& out);
+  // Handles platform update/refresh requests and writes the response JSON.
+  void handle_platform_update(const ParsedMessage& request, JsonWriter& out);
 
 }  // namespace sysutil
 
@@ -21,17 +21,136 @@
  * © OpenHD, All Rights Reserved.
  ******************************************************************************/
 
+
 #ifndef SYSUTIL_PROTOCOL_H
 #define SYSUTIL_PROTOCOL_H
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace sysutil {
 
+// Wire encoding of a connection. JSON lines are the default; a client may
+// switch to length-prefixed CBOR with sysutil.encoding.request.
+enum class Encoding {
+  Json,
+  Cbor,
+};
+
+constexpr std::size_t kEncodingCount = 2;
+
+// Returns the wire name of an encoding, e.g. "cbor".
+const char* encoding_name(Encoding encoding);
+// Parses a wire encoding name.
+std::optional<Encoding> parse_encoding(std::string_view name);
+
+// Index over the top-level members of one JSON object.
+//
+// The constructor tokenizes the text once and records key and value spans as
+// offsets; values are only decoded when a getter asks for them. Keys inside
+// nested values or string contents never match a lookup. Malformed input
+// keeps the members parsed before the error, so truncated lines still yield
+// their leading fields.
+//
+// A CBOR map is indexed the same way; getters then decode CBOR items and the
+// raw accessors return CBOR bytes instead of JSON text.
+class ParsedMessage {
+ public:
+  enum class ValueKind : std::uint8_t {
+    String,
+    Number,
+    Bool,
+    Null,
+    Object,
+    Array,
+  };
+
+  ParsedMessage() = default;
+  // Indexes text without copying it; text must outlive the message.
+  explicit ParsedMessage(std::string_view text,
+                         Encoding encoding = Encoding::Json);
+  // Indexes a private copy of text, e.g. for requests handed to a worker.
+  static ParsedMessage owning(std::string text,
+                              Encoding encoding = Encoding::Json);
+
+  // True when the whole text was a well-formed object.
+  bool valid() const { return valid_; }
+  Encoding encoding() const { return encoding_; }
+  // Returns the indexed text.
+  std::string_view text() const;
+  bool has(std::string_view key) const;
+
+  std::optional<std::string> get_string(std::string_view key) const;
+  // Integers only; fractional parts are truncated, overflow yields nullopt.
+  std::optional<int> get_int(std::string_view key) const;
+  // Non-negative integers only, e.g. millisecond timestamps and generations.
+  std::optional<std::uint64_t> get_uint64(std::string_view key) const;
+  // Accepts true/false or 0/1.
+  std::optional<bool> get_bool(std::string_view key) const;
+  // Accepts an array of strings or a single string.
+  std::optional<std::vector<std::string>> get_string_list(
+      std::string_view key) const;
+  // Raw text of a string (quotes included) or integer value, in the message's
+  // encoding.
+  std::optional<std::string_view> get_raw_scalar(std::string_view key) const;
+  // Raw text of any value, e.g. a nested object for a ParsedMessage of the
+  // same encoding.
+  std::optional<std::string_view> get_raw(std::string_view key) const;
+  // Raw text of each element of an array value.
+  std::optional<std::vector<std::string_view>> get_raw_list(
+      std::string_view key) const;
+
+  // Positional access to the members in document order, for callers that
+  // walk the whole object once instead of looking keys up.
+  std::size_t size() const { return members_.size(); }
+  // Undecoded key text; keys with escapes compare against their raw form.
+  std::string_view key_at(std::size_t index) const;
+  std::optional<std::string> string_at(std::size_t index) const;
+  std::optional<int> int_at(std::size_t index) const;
+  std::optional<bool> bool_at(std::size_t index) const;
+
+ private:
+  struct Member {
+    std::uint32_t key_begin = 0;
+    std::uint32_t key_end = 0;
+    std::uint32_t value_begin = 0;
+    std::uint32_t value_end = 0;
+    ValueKind kind = ValueKind::Null;
+  };
+
+  void index();
+  void index_cbor();
+  const Member* find(std::string_view key) const;
+  std::string_view value_text(const Member& member) const;
+  std::optional<std::string> string_of(const Member* member) const;
+  std::optional<int> int_of(const Member* member) const;
+  std::optional<bool> bool_of(const Member* member) const;
+
+  std::string storage_;
+  std::string_view view_;
+  bool owning_ = false;
+  bool valid_ = false;
+  Encoding encoding_ = Encoding::Json;
+  std::vector<Member> members_;
+};
+
+// Field helpers kept for callers that look at a single field; each call
+// indexes the payload once.
 // Extracts a string field value from a JSON-like payload.
 std::optional<std::string> extract_string_field(const std::string& line,
                                                 const std::string& field);
+// Extracts a string array field (or a single string) from a JSON-like payload.
+std::optional<std::vector<std::string>> extract_string_list_field(
+    const std::string& line, const std::string& field);
+// Extracts the raw JSON text of a string or integer field (quotes included
+// for strings), for echoing a value back without re-encoding it.
+std::optional<std::string> extract_raw_scalar_field(const std::string& line,
+                                                    const std::string& field);
 // Extracts an integer field value from a JSON-like payload.
 std::optional<int> extract_int_field(const std::string& line,
                                      const std::string& field);
@@ -39,6 +158,190 @@ std::optional<int> extract_int_field(const std::string& line,
 std::optional<bool> extract_bool_field(const std::string& line,
                                        const std::string& field);
 
+// Splits a byte stream into newline-terminated lines without copying them.
+//
+// Received bytes accumulate in one buffer and lines are handed out as views
+// into it. Consumed bytes are dropped in bulk on the next append(), so a burst
+// of many small lines costs a single memmove instead of one erase per line.
+// A line longer than max_line is skipped up to its newline and reported once
+// as Overlong rather than truncated.
+//
+// Once a connection switches to CBOR the framer reads a 4-byte big-endian
+// length in front of each message instead of scanning for newlines.
+class LineFramer {
+ public:
+  enum class Result {
+    Line,
+    Overlong,
+    NeedMore,
+  };
+
+  explicit LineFramer(std::size_t max_line) : max_line_(max_line) {}
+
+  // Adds received bytes. Invalidates views returned by next().
+  void append(const char* data, std::size_t size);
+  // Switches framing for the bytes not yet handed out.
+  void set_length_prefixed(bool enabled);
+  // Yields the next complete line without its '\n'. The view stays valid
+  // until the next append().
+  Result next(std::string_view& line);
+  // Bytes held for a line whose newline has not arrived yet.
+  std::size_t pending() const { return buffer_.size() - start_; }
+
+ private:
+  std::string buffer_;
+  // First byte not yet handed out.
+  std::size_t start_ = 0;
+  // Bytes after start_ already searched for a newline.
+  std::size_t scanned_ = 0;
+  // Set while dropping the rest of an overlong line.
+  bool discarding_ = false;
+  bool length_prefixed_ = false;
+  // Bytes of an overlong length-prefixed message still to be dropped.
+  std::size_t skip_ = 0;
+  std::size_t max_line_;
+};
+
+// Streams one JSON line into a caller-owned buffer.
+//
+// Commas between members and elements are inserted automatically and strings
+// are escaped straight into the buffer in one pass. The buffer keeps its
+// capacity across reset(), so a connection reuses one allocation for every
+// response, and take() moves the finished line out without copying it.
+//
+// With Encoding::Cbor the same calls produce a length-prefixed CBOR message
+// (indefinite-length maps and arrays) instead of a JSON line, so handlers
+// serve both encodings unchanged.
+class JsonWriter {
+ public:
+  JsonWriter() = default;
+  // Adopts buffer as storage; its contents are discarded, its capacity kept.
+  explicit JsonWriter(std::string buffer);
+
+  // Selects the encoding of the next message.
+  void set_encoding(Encoding encoding) { encoding_ = encoding; }
+  Encoding encoding() const { return encoding_; }
+
+  // Restricts the next message to the named members, for requests carrying
+  // "fields". Containers are always written so nested members stay
+  // reachable; a requested container is written whole. The top-level type,
+  // ok and message members are always kept, and has_<name> follows <name>.
+  // Cleared by reset().
+  void set_projection(std::vector<std::string> fields);
+
+  JsonWriter& begin_object();
+  JsonWriter& begin_object(std::string_view key);
+  JsonWriter& end_object();
+  JsonWriter& begin_array();
+  JsonWriter& begin_array(std::string_view key);
+  JsonWriter& end_array();
+
+  // Object members.
+  JsonWriter& field(std::string_view key, std::string_view value);
+  JsonWriter& field(std::string_view key, const char* value);
+  JsonWriter& field(std::string_view key, bool value);
+  template <typename T,
+            std::enable_if_t<std::is_integral_v<T> &&
+                                 !std::is_same_v<T, bool>,
+                             int> = 0>
+  JsonWriter& field(std::string_view key, T value) {
+    if (!wanted(key)) {
+      return *this;
+    }
+    write_key(key);
+    write_integer(value);
+    return *this;
+  }
+  JsonWriter& field_null(std::string_view key);
+  // Writes already-encoded JSON as the member value (transcoded for CBOR).
+  JsonWriter& field_raw(std::string_view key, std::string_view json);
+
+  // Array elements.
+  JsonWriter& value(std::string_view value);
+  JsonWriter& value(const char* value);
+  JsonWriter& value(bool value);
+  template <typename T,
+            std::enable_if_t<std::is_integral_v<T> &&
+                                 !std::is_same_v<T, bool>,
+                             int> = 0>
+  JsonWriter& value(T value) {
+    separate();
+    write_integer(value);
+    return *this;
+  }
+  JsonWriter& value_raw(std::string_view json);
+  // Appends a finished message from a writer of the same encoding as an
+  // element, e.g. one sub-response of a batch.
+  JsonWriter& value_message(std::string_view message);
+
+  // Makes key:raw the first member of the next top-level object, e.g. to
+  // echo a request id ahead of whatever the response builder writes. raw is
+  // a value in the writer's encoding, as returned by get_raw_scalar().
+  void lead_with(std::string_view key, std::string_view raw);
+  // Appends an already-encoded message in the writer's encoding (e.g. a
+  // cached response), splicing the lead_with() member in after its start.
+  JsonWriter& line_raw(std::string_view line);
+
+  // Terminates the line; the socket protocol is newline delimited. For CBOR
+  // this fills in the message's length prefix instead.
+  JsonWriter& end_line();
+
+  // Clears the text but keeps the allocation.
+  void reset();
+  bool empty() const { return buffer_.empty(); }
+  const std::string& str() const { return buffer_; }
+  // Moves the finished text out; the writer is empty afterwards.
+  std::string take();
+
+ private:
+  void separate();
+  void write_key(std::string_view key);
+  void open(char bracket);
+  void close(char bracket);
+  bool cbor() const { return encoding_ == Encoding::Cbor; }
+  bool wanted(std::string_view key) const {
+    return projection_.empty() || pass_depth_ != 0 || projected(key);
+  }
+  bool projected(std::string_view key) const;
+  void open_member(std::string_view key, char bracket);
+  template <typename T>
+  void write_integer(T value) {
+    if constexpr (std::is_signed_v<T>) {
+      write_signed(static_cast<long long>(value));
+    } else {
+      write_unsigned(static_cast<unsigned long long>(value));
+    }
+  }
+  void write_signed(long long value);
+  void write_unsigned(unsigned long long value);
+
+  std::string buffer_;
+  // Pre-encoded member from lead_with(), including its key.
+  std::string lead_;
+  Encoding encoding_ = Encoding::Json;
+  // Offset of the current CBOR message's length prefix.
+  std::size_t frame_start_ = 0;
+  // Requested member names; empty writes everything.
+  std::vector<std::string> projection_;
+  // Depth of a requested container being written whole, or 0.
+  unsigned pass_depth_ = 0;
+  // Bit n is set once the container at depth n holds an item.
+  std::uint64_t has_items_ = 0;
+  unsigned depth_ = 0;
+};
+
+// Appends one JSON value (or a whole JSON line) to out as CBOR. Returns false
+// on malformed input.
+bool append_json_as_cbor(std::string& out, std::string_view json);
+// Re-encodes a JSON line as a length-prefixed CBOR message, e.g. to hand one
+// event payload to CBOR clients. Returns an empty string on malformed input.
+std::string json_line_to_cbor(std::string_view line);
+
+// Appends text to out with JSON string escaping (no surrounding quotes).
+void append_json_escaped(std::string& out, std::string_view text);
+// Returns text with JSON string escaping applied.
+std::string json_escape(std::string_view text);
+
 }  // namespace sysutil
 
 #endif  // SYSUTIL_PROTOCOL_H
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+// Single-threaded epoll reactor used by the sysutils socket server.
+//
+// File descriptors are registered once in edge-triggered mode and timers are
+// backed by timerfd, so the daemon only wakes up when there is real work.
+// Other threads hand work back to the reactor thread through post().
+
+#ifndef SYSUTIL_REACTOR_H
+#define SYSUTIL_REACTOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sysutil {
+
+class Reactor {
+ public:
+  using FdCallback = std::function<void(std::uint32_t events)>;
+  using TimerCallback = std::function<void()>;
+  using Task = std::function<void()>;
+
+  Reactor() = default;
+  ~Reactor();
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+  // Creates the epoll instance and the wakeup eventfd.
+  bool open();
+  // Registers a file descriptor; EPOLLET is added to the requested events.
+  bool add(int fd, std::uint32_t events, FdCallback callback);
+  // Unregisters a file descriptor. Pending events for it are discarded.
+  void remove(int fd);
+  // Creates a disarmed timerfd-backed timer and returns its id (-1 on error).
+  int add_timer(TimerCallback callback);
+  // Arms a timer. A zero interval makes it a one-shot timer.
+  bool arm_timer(int timer, std::chrono::milliseconds delay,
+                 std::chrono::milliseconds interval =
+                     std::chrono::milliseconds(0));
+  // Disarms a timer without removing it.
+  bool disarm_timer(int timer);
+  // Wakes up a blocked run_once(). Async-signal-safe.
+  void wakeup();
+  // Queues a task to run on the reactor thread. Safe to call from any thread.
+  void post(Task task);
+  // Blocks until at least one event arrives and dispatches it.
+  // Returns false on a fatal epoll error.
+  bool run_once();
+
+ private:
+  struct Registration {
+    int fd = -1;
+    FdCallback callback;
+  };
+
+  std::uint64_t register_fd(int fd, std::uint32_t events, FdCallback callback);
+  void close_timers();
+  void run_posted();
+
+  int epoll_fd_ = -1;
+  int wakeup_fd_ = -1;
+  std::uint64_t next_token_ = 1;
+  std::unordered_map<std::uint64_t, std::shared_ptr<Registration>> by_token_;
+  std::unordered_map<int, std::uint64_t> token_by_fd_;
+  std::unordered_set<int> timers_;
+  std::mutex posted_mutex_;
+  std::vector<Task> posted_;
+};
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_REACTOR_H
@@ -25,24 +25,35 @@
 #define SYSUTIL_SETTINGS_H
 
 #include <string>
+#include <string_view>
+
+#include "sysutil_protocol.h"
 
 namespace sysutil {
 
+// Returns the run mode the daemon acts on: the configured mode normalized,
+// "ground" when unset or unknown, and always "air" on X20.
+std::string effective_run_mode(std::string_view configured_mode,
+                               int platform_type);
+
 // Consumes boot-time marker files and persists them in sysutils config.
 void sync_settings_from_files();
 
-// True when the payload requests sysutils settings.
-bool is_settings_request(const std::string& line);
-// True when the payload updates sysutils settings.
-bool is_settings_update(const std::string& line);
-// True when the payload requests camera setup.
-bool is_camera_setup_request(const std::string& line);
-// Builds the settings response payload.
-std::string build_settings_response();
-// Applies a settings update and returns a response payload.
-std::string handle_settings_update(const std::string& line);
-// Applies camera setup and returns a response payload.
-std::string handle_camera_setup_request(const std::string& line);
+// Registers the settings and camera setup request handlers with the dispatcher.
+void register_settings_handlers();
+// Writes the settings response payload. With since_generation and a matching
+// since_epoch set, only the fields changed after that generation are sent, or
+// not_modified.
+void build_settings_response(const ParsedMessage& request, JsonWriter& out);
+// Applies a settings update and writes the response payload.
+void handle_settings_update(const ParsedMessage& request, JsonWriter& out);
+// Validates a batch of setting changes, persists them in one write and runs
+// each dependent side effect at most once. All-or-nothing.
+void handle_settings_transaction(const ParsedMessage& request,
+                                 JsonWriter& out);
+// Applies camera setup and writes the response payload.
+void handle_camera_setup_request(const ParsedMessage& request,
+                                 JsonWriter& out);
 
 }  // namespace sysutil
 
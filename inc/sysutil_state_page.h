@@ -0,0 +1,140 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+// Read-only shared-memory page with the daemon's current state, for readers
+// that poll at frame rate (OpenHD, QOpenHD, the glide UI) without a socket
+// round trip or a JSON parse.
+//
+// The page is a StatePage at offset 0 of kStatePagePath. The daemon is the
+// only writer and guards every update with a seqlock on `sequence`: it is odd
+// while an update is in progress and advances by two per update. Readers map
+// the file read-only and use read_state_page(). After shutdown the page is
+// left with `running` cleared until the file is unlinked.
+
+#ifndef SYSUTIL_STATE_PAGE_H
+#define SYSUTIL_STATE_PAGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "sysutil_status.h"
+
+namespace sysutil {
+
+constexpr const char* kStatePagePath = "/run/openhd/openhd_sys_state";
+// "OHSP" in little-endian byte order.
+constexpr std::uint32_t kStatePageMagic = 0x5053484Fu;
+// Bumped whenever the layout of StatePageData changes.
+constexpr std::uint32_t kStatePageVersion = 1;
+
+// Modules whose generation counter is published on the page. Each counter
+// increases whenever that module's state changes.
+enum class StateModule : std::uint32_t {
+  Status,
+  Config,
+  Platform,
+  Wifi,
+  Update,
+};
+constexpr std::size_t kStateModuleCount = 5;
+
+// Fixed-size copy of the daemon state. Strings are NUL-terminated and
+// truncated to fit.
+struct StatePageData {
+  std::uint8_t running = 0;
+  std::uint8_t has_status = 0;
+  std::uint8_t has_error = 0;
+  std::uint8_t updating = 0;
+  std::int32_t severity = 0;
+  std::int32_t platform_type = 0;
+  std::uint32_t reserved = 0;
+  std::uint64_t status_updated_ms = 0;
+  std::uint64_t generations[kStateModuleCount] = {};
+  // Effective run mode, as reported by sysutil.settings.
+  char run_mode[16] = {};
+  char status_type[32] = {};
+  char state[64] = {};
+  char description[128] = {};
+  char message[256] = {};
+};
+
+struct StatePage {
+  std::uint32_t magic;
+  std::uint32_t version;
+  // Size of StatePage as written, so readers can detect a layout mismatch.
+  std::uint32_t size;
+  std::atomic<std::uint32_t> sequence;
+  StatePageData data;
+};
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+              "the seqlock counter must be usable across processes");
+
+// Copies a consistent snapshot out of a mapped page. Returns false when the
+// page is not a compatible state page or no stable copy was seen within
+// max_attempts tries.
+inline bool read_state_page(const StatePage& page, StatePageData& out,
+                            int max_attempts = 64) {
+  if (page.magic != kStatePageMagic || page.version != kStatePageVersion ||
+      page.size != sizeof(StatePage)) {
+    return false;
+  }
+  for (int attempt = 0; attempt < max_attempts; ++attempt) {
+    const std::uint32_t before = page.sequence.load(std::memory_order_acquire);
+    if (before & 1u) {
+      continue;
+    }
+    std::memcpy(&out, &page.data, sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (page.sequence.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Creates the page and maps it for writing. Updates before this (or after a
+// failure) only change the in-process copy, which init_state_page() writes
+// out, so it can be called at any point during startup.
+bool init_state_page();
+// Clears `running`, unmaps the page and removes the file.
+void close_state_page();
+
+// Publishes the latest status and bumps the Status generation.
+void state_page_set_status(const StatusSnapshot& status);
+// Publishes the platform id and bumps the Platform generation.
+void state_page_set_platform(int platform_type);
+// Publishes the effective run mode for the configured one (as the settings
+// response reports it) and bumps the Config generation.
+void state_page_set_config(std::string_view run_mode);
+// Publishes whether an update is running and bumps the Update generation.
+void state_page_set_updating(bool updating);
+// Bumps a module's generation without other changes.
+void state_page_bump(StateModule module);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_STATE_PAGE_H
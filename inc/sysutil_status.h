@@ -24,9 +24,13 @@
 #ifndef SYSUTIL_STATUS_H
 #define SYSUTIL_STATUS_H
 
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
 
+#include "sysutil_protocol.h"
+
 namespace sysutil {
 
 struct StatusSnapshot {
@@ -37,20 +41,53 @@ struct StatusSnapshot {
   std::string description;
   std::string message;
   std::string type;
+  // Who reported it: "openhd" (or the message's "source") for OpenHD
+  // messages, the state name for sysutils' own steps.
+  std::string source;
   std::uint64_t updated_ms = 0;
+  // steady_clock time of the last report. Drives expiry, so a wall clock
+  // step (NTP, GPS time) can't expire or pin sources; never sent to clients.
+  std::uint64_t received_ms = 0;
 };
 
 // Handles incoming status messages and logs important state.
-void handle_status_message(const std::string& line);
+void handle_status_message(const ParsedMessage& request);
 
 // Tests if the given path points to an existing regular file.
 bool is_regular_file(const std::string& path);
 
-// Checks whether the message is a status request.
-bool is_status_request(const std::string& line);
+// Registers the status request handlers with the dispatcher.
+void register_status_handlers();
+
+// Returns a copy of the aggregated status: the worst source that has reported
+// within the last 30 s (the most recent source never expires). Takes no
+// lock; text is truncated to the published record sizes.
+StatusSnapshot status_snapshot();
 
 // Builds a JSON response that reports the latest status.
-std::string build_status_response();
+void build_status_response(JsonWriter& out);
+
+// Writes the recorded status history newer than the request's since_ms
+// (default 0), oldest first.
+void build_status_history_response(const ParsedMessage& request,
+                                   JsonWriter& out);
+
+// Loads the history saved at the last shutdown in front of the entries
+// recorded since startup. Call once /Config is mounted.
+void load_status_history();
+
+// Saves the status history to /Config for the next boot.
+bool save_status_history();
+
+// Publishes coalesced indicator.status changes that are due, drops sources
+// that stopped reporting, and returns the delay until it must run again, or
+// zero when nothing is waiting. Run from the daemon's timer.
+std::chrono::milliseconds run_status_timer();
+
+// Called (from any thread) when a change or an expiring source starts
+// waiting, so the daemon can schedule run_status_timer(). nullptr disables
+// it.
+void set_status_timer_notifier(std::function<void()> notifier);
 
 // Updates the current status snapshot from sysutils itself.
 void set_status(const std::string& state,
@@ -26,22 +26,22 @@
 
 #include <string>
 
+#include "sysutil_protocol.h"
+
 namespace sysutil {
 
 // Starts the background update worker.
 void init_update_worker();
 
-// Checks whether a message requests an update run.
-bool is_update_request(const std::string& line);
-
-// Handles an update request and returns a response payload.
-std::string handle_update_request(const std::string& line);
+// Registers the update request handlers with the dispatcher.
+void register_update_handlers();
 
-// Checks whether a message requests update package version information.
-bool is_update_info_request(const std::string& line);
+// Handles an update request and writes the response payload.
+void handle_update_request(const ParsedMessage& request, JsonWriter& out);
 
-// Handles an update info request and returns update worker state.
-std::string handle_update_info_request(const std::string& line);
+// Handles an update info request and writes the update worker state.
+void handle_update_info_request(const ParsedMessage& request,
+                                JsonWriter& out);
 
 // Returns true while an update is running.
 bool is_updating();
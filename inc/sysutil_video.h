@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "sysutil_protocol.h"
+
 namespace sysutil {
 
 // Generates the decode script and systemd service file based on the detected platform.
@@ -15,13 +17,14 @@ void start_ground_video_if_needed();
 // Starts OpenHD Glide before slower boot probes on RK3566 Bookworm units.
 void start_openhd_glide_early_if_needed();
 
-// Starts OpenHD services; starts QOpenHD in ground mode.
-void start_openhd_services_if_needed();
+// Starts OpenHD services; starts QOpenHD in ground mode. restart_openhd
+// restarts an already running OpenHD, e.g. so it picks up a debug change.
+void start_openhd_services_if_needed(bool restart_openhd = false);
 
-// Returns true when the payload requests sysutils to handle video decode.
-bool is_video_request(const std::string& line);
-// Handles a video decode request and returns a JSON response.
-std::string handle_video_request(const std::string& line);
+// Registers the video request handlers with the dispatcher.
+void register_video_handlers();
+// Handles a video decode request and writes the JSON response.
+void handle_video_request(const ParsedMessage& request, JsonWriter& out);
 
 }  // namespace sysutil
 
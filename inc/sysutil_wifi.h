@@ -24,9 +24,12 @@
 #ifndef SYSUTIL_WIFI_H
 #define SYSUTIL_WIFI_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "sysutil_protocol.h"
+
 namespace sysutil {
 
 struct WifiCardInfo {
@@ -58,6 +61,9 @@ struct WifiCardInfo {
   std::string artosyn_tunnel_detail;
 };
 
+// True when every field matches, i.e. a refresh found nothing new.
+bool operator==(const WifiCardInfo& a, const WifiCardInfo& b);
+
 // Initializes cached Wi-Fi info (loading overrides and detecting cards).
 void init_wifi_info();
 
@@ -67,26 +73,25 @@ void refresh_wifi_info();
 // Returns true when at least one OpenHD wifibroadcast card is detected.
 bool has_openhd_wifibroadcast_cards();
 
-// Returns cached Wi-Fi card info (initializes if needed).
-const std::vector<WifiCardInfo>& wifi_cards();
-
-// Checks whether a request asks for Wi-Fi info.
-bool is_wifi_request(const std::string& line);
+// Returns a copy of the cached Wi-Fi card info (initializes if needed).
+std::vector<WifiCardInfo> wifi_cards();
 
-// Builds JSON response for Wi-Fi info requests.
-std::string build_wifi_response();
+// Returns a value that changes whenever the cached card list does; keys the
+// cached sysutil.wifi response.
+std::uint64_t wifi_generation();
 
-// Checks whether a request asks to update Wi-Fi overrides or refresh detection.
-bool is_wifi_update_request(const std::string& line);
+// Registers the Wi-Fi and link control request handlers with the dispatcher.
+void register_wifi_handlers();
 
-// Handles Wi-Fi update requests and returns response JSON.
-std::string handle_wifi_update(const std::string& line);
+// Writes the JSON response for Wi-Fi info requests.
+void build_wifi_response(JsonWriter& out);
 
-// Checks whether a request asks to control RF link settings.
-bool is_link_control_request(const std::string& line);
+// Handles Wi-Fi update requests and writes the response JSON.
+void handle_wifi_update(const ParsedMessage& request, JsonWriter& out);
 
-// Handles RF link control requests and returns response JSON.
-std::string handle_link_control_request(const std::string& line);
+// Handles RF link control requests and writes the response JSON.
+void handle_link_control_request(const ParsedMessage& request,
+                                 JsonWriter& out);
 
 }  // namespace sysutil
 
@@ -0,0 +1,51 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+// Bounded worker pool for request handlers that block on subprocesses,
+// sockets or slow sysfs probes.
+//
+// Jobs are grouped into lanes: jobs submitted to the same lane run one at a
+// time in submission order, jobs from different lanes run in parallel.
+
+#ifndef SYSUTIL_WORKER_POOL_H
+#define SYSUTIL_WORKER_POOL_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace sysutil {
+
+using WorkerJob = std::function<void()>;
+
+// Starts the worker threads. Calling it again is a no-op.
+void start_worker_pool(std::size_t thread_count, std::size_t max_queued_jobs);
+// Queues a job on a lane. Returns false when the pool is stopped or full.
+bool submit_worker_job(const std::string& lane, WorkerJob job);
+// Drops queued jobs, waits for running jobs and joins the worker threads.
+void stop_worker_pool();
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_WORKER_POOL_H
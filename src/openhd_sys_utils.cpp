@@ -1,47 +1,94 @@
+#include <algorithm>
 #include <cstdlib>
 #include <cerrno>
 #include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <optional>
 #include <csignal>
 #include <string>
 #include <string_view>
 #include <chrono>
-#include <poll.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
+#include <sys/epoll.h>
+#include <deque>
 #include <unordered_map>
 #include <unistd.h>
 #include <vector>
 #include <fcntl.h>
 
 #include "version_generated.h"
+#include "sysutil_cbor.h"
 #include "sysutil_config.h"
 #include "sysutil_firstboot.h"
 #include "sysutil_debug.h"
+#include "sysutil_dispatch.h"
+#include "sysutil_events.h"
 #include "sysutil_hostname.h"
 #include "sysutil_led.h"
 #include "sysutil_part.h"
+#include "sysutil_persist.h"
 #include "sysutil_platform.h"
 #include "sysutil_protocol.h"
+#include "sysutil_reactor.h"
 #include "sysutil_settings.h"
+#include "sysutil_state_page.h"
 #include "sysutil_status.h"
 #include "sysutil_update.h"
 #include "sysutil_serial.h"
 #include "sysutil_video.h"
 #include "sysutil_wifi.h"
+#include "sysutil_worker_pool.h"
 
 namespace {
 constexpr std::string_view kSocketDir = "/run/openhd";
 constexpr std::string_view kSocketPath = "/run/openhd/openhd_sys.sock";
+// Same protocol over SOCK_SEQPACKET: one request or response per packet, no
+// trailing newline required.
+constexpr std::string_view kSeqSocketPath = "/run/openhd/openhd_sys_seq.sock";
 constexpr std::size_t kMaxLineLength = 4096;
+constexpr auto kWifiRetryInterval = std::chrono::seconds(5);
+constexpr std::size_t kWorkerThreads = 3;
+constexpr std::size_t kMaxQueuedWorkerJobs = 32;
+// Requests a single client may have running on the worker pool at once.
+constexpr std::size_t kMaxInFlightPerClient = 8;
+// Sub-requests a single sysutil.batch may carry.
+constexpr std::size_t kMaxBatchRequests = 16;
+// Outbound bytes a client may have queued before the overflow policy applies.
+constexpr std::size_t kDefaultHighWaterBytes = 256 * 1024;
+// Responses handed to a single sendmsg() call.
+constexpr int kMaxIovecs = 32;
+// Sent response buffers up to this capacity are kept for the next response.
+constexpr std::size_t kMaxRecycledBufferBytes = 64 * 1024;
 bool gDebug = false;
+
+enum class OverflowPolicy {
+    Disconnect,
+    DropOldest,
+};
+
+struct OutboundLimits {
+    std::size_t highWaterBytes = kDefaultHighWaterBytes;
+    OverflowPolicy policy = OverflowPolicy::Disconnect;
+};
+
+OutboundLimits gOutboundLimits;
+// Whether the SOCK_SEQPACKET endpoint is being served.
+bool gSeqpacketListening = false;
 volatile std::sig_atomic_t gStopRequested = 0;
+sysutil::Reactor* gReactor = nullptr;
 
 void signalHandler(int) {
+    const int savedErrno = errno;
     gStopRequested = 1;
+    if (gReactor != nullptr) {
+        gReactor->wakeup();
+    }
+    errno = savedErrno;
 }
 
 bool installSignalHandlers() {
@@ -81,47 +128,44 @@ private:
     bool active_ = false;
 };
 
+// Flushes queued config writes and joins the persist worker on every exit
+// path out of main().
+class PersistWorkerGuard {
+public:
+    PersistWorkerGuard() { sysutil::start_persist_worker(); }
+    ~PersistWorkerGuard() { sysutil::stop_persist_worker(); }
+
+    PersistWorkerGuard(const PersistWorkerGuard&) = delete;
+    PersistWorkerGuard& operator=(const PersistWorkerGuard&) = delete;
+};
+
+// Publishes the shared-memory state page for the daemon's lifetime, so early
+// returns don't leave a page claiming the daemon is running.
+class StatePageGuard {
+public:
+    StatePageGuard() { sysutil::init_state_page(); }
+    ~StatePageGuard() { sysutil::close_state_page(); }
+
+    StatePageGuard(const StatePageGuard&) = delete;
+    StatePageGuard& operator=(const StatePageGuard&) = delete;
+};
+
 bool setNonBlocking(int fd) {
     const int flags = fcntl(fd, F_GETFL, 0);
     if (flags == -1) return false;
     return fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
 }
 
-bool sendAll(int fd, const std::string& data) {
-    std::size_t offset = 0;
-    while (offset < data.size()) {
-        const ssize_t written =
-            ::send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
-        if (written > 0) {
-            offset += static_cast<std::size_t>(written);
-            continue;
-        }
-        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            pollfd pfd{fd, POLLOUT, 0};
-            int ready = ::poll(&pfd, 1, 500);
-            if (ready <= 0) {
-                return false;
-            }
-            continue;
-        }
-        if (written < 0 && errno == EINTR) {
-            continue;
-        }
-        return false;
-    }
-    return true;
-}
-
-bool removeStaleSocket() {
+bool removeStaleSocket(std::string_view path) {
     std::error_code ec;
-    if (!std::filesystem::exists(kSocketPath, ec)) {
+    if (!std::filesystem::exists(path, ec)) {
         return true;
     }
-    if (::unlink(std::string(kSocketPath).c_str()) < 0) {
+    if (::unlink(std::string(path).c_str()) < 0) {
         std::perror("unlink stale socket");
         return false;
     }
-    std::cout << "Removed stale socket at " << kSocketPath << std::endl;
+    std::cout << "Removed stale socket at " << path << std::endl;
     return true;
 }
 
@@ -136,7 +180,7 @@ void remove_space_image() {
     }
 }
 
-int createAndBindSocket() {
+int createAndBindSocket(std::string_view path, int type) {
     std::error_code ec;
     std::filesystem::create_directories(kSocketDir, ec);
     if (ec) {
@@ -144,11 +188,11 @@ int createAndBindSocket() {
         return -1;
     }
 
-    if (!removeStaleSocket()) {
+    if (!removeStaleSocket(path)) {
         return -1;
     }
 
-    int serverFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    int serverFd = ::socket(AF_UNIX, type, 0);
     if (serverFd < 0) {
         std::perror("socket");
         return -1;
@@ -156,12 +200,12 @@ int createAndBindSocket() {
 
     sockaddr_un addr{};
     addr.sun_family = AF_UNIX;
-    if (kSocketPath.size() >= sizeof(addr.sun_path)) {
-        std::cerr << "Socket path is too long: " << kSocketPath << std::endl;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path is too long: " << path << std::endl;
         ::close(serverFd);
         return -1;
     }
-    std::strncpy(addr.sun_path, std::string(kSocketPath).c_str(), sizeof(addr.sun_path) - 1);
+    std::strncpy(addr.sun_path, std::string(path).c_str(), sizeof(addr.sun_path) - 1);
 
     mode_t oldMask = ::umask(0);
     if (::bind(serverFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
@@ -172,7 +216,7 @@ int createAndBindSocket() {
     }
     ::umask(oldMask);
 
-    if (::chmod(std::string(kSocketPath).c_str(), 0660) < 0) {
+    if (::chmod(std::string(path).c_str(), 0660) < 0) {
         std::perror("chmod");
         ::close(serverFd);
         return -1;
@@ -191,153 +235,759 @@ int createAndBindSocket() {
     return serverFd;
 }
 
-void closeClient(int fd, std::unordered_map<int, std::string>& buffers) {
+// A response slot keeps replies in request order while some of them are
+// still being computed on the worker pool.
+struct PendingResponse {
+    bool ready = false;
+    // Requests that carried an "id" may be answered out of order.
+    bool tagged = false;
+    bool sent = false;
+    // Encoding the payload was written in; a sysutil.encoding.request reply
+    // is still in the old one.
+    sysutil::Encoding encoding = sysutil::Encoding::Json;
+    std::string payload;
+};
+
+struct ClientState {
+    // Distinguishes this connection from a later one that reuses the fd.
+    std::uint64_t id = 0;
+    // Accepted on the SOCK_SEQPACKET endpoint: every read is one request and
+    // every response goes out as its own packet.
+    bool seqpacket = false;
+    // Wire encoding of requests, responses and events on this connection.
+    sysutil::Encoding encoding = sysutil::Encoding::Json;
+    sysutil::LineFramer framer{kMaxLineLength};
+    std::deque<PendingResponse> responses;
+    // Sequence number of responses.front().
+    std::uint64_t headSeq = 0;
+    std::size_t inFlight = 0;
+    // Responses waiting for the socket to become writable. The first
+    // outboundOffset bytes of outbound.front() were already sent.
+    std::deque<std::string> outbound;
+    std::size_t outboundOffset = 0;
+    std::size_t outboundBytes = 0;
+    // Storage of the last fully sent response, reused by the next one.
+    std::string spare;
+    // Drops are logged once per connection to keep a stuck client from
+    // flooding the journal.
+    bool dropLogged = false;
+    // Bit per sysutil::EventTopic the client subscribed to.
+    std::uint32_t subscriptions = 0;
+};
+
+using ClientMap = std::unordered_map<int, ClientState>;
+
+std::uint32_t topicBit(sysutil::EventTopic topic) {
+    return 1u << static_cast<unsigned>(topic);
+}
+
+void setSubscriptions(ClientState& client, std::uint32_t subscriptions) {
+    for (std::size_t i = 0; i < sysutil::kEventTopicCount; ++i) {
+        const auto topic = static_cast<sysutil::EventTopic>(i);
+        const bool had = (client.subscriptions & topicBit(topic)) != 0;
+        const bool wants = (subscriptions & topicBit(topic)) != 0;
+        if (wants && !had) {
+            sysutil::add_event_subscriber(topic);
+        } else if (had && !wants) {
+            sysutil::remove_event_subscriber(topic);
+        }
+    }
+    client.subscriptions = subscriptions;
+}
+
+void closeClient(sysutil::Reactor& reactor, int fd, ClientMap& clients) {
+    reactor.remove(fd);
     ::close(fd);
-    buffers.erase(fd);
+    auto it = clients.find(fd);
+    if (it != clients.end()) {
+        setSubscriptions(it->second, 0);
+        clients.erase(it);
+    }
 }
 
-void closeAllClients(std::unordered_map<int, std::string>& buffers) {
-    for (auto& entry : buffers) {
+void closeAllClients(sysutil::Reactor& reactor, ClientMap& clients) {
+    for (auto& entry : clients) {
+        reactor.remove(entry.first);
         ::close(entry.first);
+        setSubscriptions(entry.second, 0);
+    }
+    clients.clear();
+}
+
+void loadOutboundLimits() {
+    const auto snapshot = sysutil::sysutil_config_snapshot();
+    if (snapshot->result != sysutil::ConfigLoadResult::Loaded) {
+        return;
+    }
+    const sysutil::SysutilConfig& config = snapshot->config;
+    if (config.socket_high_water_bytes && *config.socket_high_water_bytes > 0) {
+        gOutboundLimits.highWaterBytes =
+            static_cast<std::size_t>(*config.socket_high_water_bytes);
+    }
+    if (config.socket_overflow_policy) {
+        if (*config.socket_overflow_policy == "drop_oldest") {
+            gOutboundLimits.policy = OverflowPolicy::DropOldest;
+        } else if (*config.socket_overflow_policy == "disconnect") {
+            gOutboundLimits.policy = OverflowPolicy::Disconnect;
+        } else {
+            std::cerr << "Unknown socket_overflow_policy '"
+                      << *config.socket_overflow_policy
+                      << "', using disconnect." << std::endl;
+        }
+    }
+}
+
+// Keeps a sent response's allocation so the next response on this connection
+// can be written without growing a fresh buffer.
+void recycleBuffer(ClientState& client, std::string buffer) {
+    if (buffer.capacity() > client.spare.capacity() &&
+        buffer.capacity() <= kMaxRecycledBufferBytes) {
+        client.spare = std::move(buffer);
+    }
+}
+
+// Sends queued responses one packet each; queueOutbound() already removed
+// their framing. Packets are atomic, so there is never a partially sent
+// response.
+bool flushPackets(int fd, ClientState& client) {
+    while (!client.outbound.empty()) {
+        const std::string& payload = client.outbound.front();
+        const std::size_t length = payload.size();
+        const ssize_t written = ::send(fd, payload.data(), length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            if (errno != EMSGSIZE) {
+                return false;
+            }
+            std::cerr << "Client fd " << fd << ": dropping " << length
+                      << "-byte response larger than the socket buffer."
+                      << std::endl;
+        }
+        client.outboundBytes -= payload.size();
+        recycleBuffer(client, std::move(client.outbound.front()));
+        client.outbound.pop_front();
     }
-    buffers.clear();
+    return true;
 }
 
-bool handleClientData(int fd, std::unordered_map<int, std::string>& buffers) {
-    char readBuf[1024];
+// Writes as much of the outbound queue as the socket accepts, gathering
+// several queued responses into one sendmsg() call. Stops on EAGAIN and
+// resumes on the next EPOLLOUT edge. Returns false when the connection failed.
+bool flushOutbound(int fd, ClientState& client) {
+    if (client.seqpacket) {
+        return flushPackets(fd, client);
+    }
+    while (!client.outbound.empty()) {
+        iovec iov[kMaxIovecs];
+        int count = 0;
+        std::size_t offset = client.outboundOffset;
+        for (auto it = client.outbound.begin();
+             it != client.outbound.end() && count < kMaxIovecs; ++it) {
+            iov[count].iov_base = const_cast<char*>(it->data()) + offset;
+            iov[count].iov_len = it->size() - offset;
+            offset = 0;
+            ++count;
+        }
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = static_cast<std::size_t>(count);
+        const ssize_t written = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        auto remaining = static_cast<std::size_t>(written);
+        client.outboundBytes -= remaining;
+        while (remaining > 0) {
+            const std::size_t pending =
+                client.outbound.front().size() - client.outboundOffset;
+            if (remaining < pending) {
+                client.outboundOffset += remaining;
+                break;
+            }
+            remaining -= pending;
+            recycleBuffer(client, std::move(client.outbound.front()));
+            client.outbound.pop_front();
+            client.outboundOffset = 0;
+        }
+    }
+    return true;
+}
+
+// Applies the overflow policy once a client stops draining its queue.
+// Returns false when the client has to be disconnected.
+bool enforceHighWater(int fd, ClientState& client) {
+    if (client.outboundBytes <= gOutboundLimits.highWaterBytes) {
+        return true;
+    }
+    if (gOutboundLimits.policy == OverflowPolicy::Disconnect) {
+        std::cerr << "Client fd " << fd << " exceeded "
+                  << gOutboundLimits.highWaterBytes
+                  << " queued bytes, disconnecting." << std::endl;
+        return false;
+    }
+    // Never drop a partially sent response or the newest one.
+    const std::size_t first = client.outboundOffset > 0 ? 1 : 0;
+    std::size_t dropped = 0;
+    while (client.outboundBytes > gOutboundLimits.highWaterBytes &&
+           client.outbound.size() > first + 1) {
+        const auto victim =
+            client.outbound.begin() + static_cast<std::ptrdiff_t>(first);
+        client.outboundBytes -= victim->size();
+        client.outbound.erase(victim);
+        ++dropped;
+    }
+    if (dropped > 0 && !client.dropLogged) {
+        client.dropLogged = true;
+        std::cerr << "Client fd " << fd
+                  << " is not draining, dropping oldest queued responses."
+                  << std::endl;
+    }
+    return true;
+}
+
+// Appends one message, written in the given encoding, to the outbound queue.
+void queueOutbound(ClientState& client, std::string payload,
+                   sysutil::Encoding encoding) {
+    if (gDebug) {
+        if (encoding == sysutil::Encoding::Cbor) {
+            std::cout << "sysutils => " << payload.size() << " bytes of CBOR\n";
+        } else {
+            std::cout << "sysutils => " << payload;
+        }
+    }
+    // Packets carry no newline or CBOR length prefix. Strip them now, while
+    // the payload's own encoding is known.
+    if (client.seqpacket) {
+        if (encoding == sysutil::Encoding::Cbor) {
+            payload.erase(0, std::min(payload.size(), sysutil::kCborFramePrefix));
+        } else if (!payload.empty() && payload.back() == '\n') {
+            payload.pop_back();
+        }
+    }
+    client.outboundBytes += payload.size();
+    client.outbound.push_back(std::move(payload));
+}
+
+// Moves every response that may be sent to the outbound queue and writes
+// what the socket accepts. Returns false when the client has to be
+// closed.
+bool flushResponses(int fd, ClientState& client) {
+    // Tagged responses go out as soon as they are ready; untagged ones keep
+    // their place behind every earlier request.
+    for (auto& slot : client.responses) {
+        if (slot.ready && slot.tagged && !slot.sent) {
+            queueOutbound(client, std::move(slot.payload), slot.encoding);
+            slot.sent = true;
+        }
+    }
+    while (!client.responses.empty() && client.responses.front().ready) {
+        auto& slot = client.responses.front();
+        if (!slot.sent) {
+            queueOutbound(client, std::move(slot.payload), slot.encoding);
+        }
+        client.responses.pop_front();
+        ++client.headSeq;
+    }
+    if (!flushOutbound(fd, client)) {
+        return false;
+    }
+    return enforceHighWater(fd, client);
+}
+
+// Fills a response slot once its worker job finished. Runs on the reactor
+// thread; the client may have disconnected in the meantime.
+void completeResponse(sysutil::Reactor& reactor, ClientMap& clients, int fd,
+                      std::uint64_t clientId, std::uint64_t seq,
+                      std::string payload) {
+    auto it = clients.find(fd);
+    if (it == clients.end() || it->second.id != clientId) {
+        return;
+    }
+    auto& client = it->second;
+    --client.inFlight;
+    auto& slot = client.responses[seq - client.headSeq];
+    slot.ready = true;
+    slot.payload = std::move(payload);
+    if (!flushResponses(fd, client)) {
+        closeClient(reactor, fd, clients);
+    }
+}
+
+// Handles sysutil.subscribe / sysutil.unsubscribe. Topics are validated
+// before anything changes, so a bad topic leaves the subscription untouched.
+void handleSubscription(ClientState& client,
+                        const sysutil::ParsedMessage& request, bool subscribe,
+                        sysutil::JsonWriter& out) {
+    const char* responseType = subscribe ? "sysutil.subscribe.response"
+                                         : "sysutil.unsubscribe.response";
+    std::uint32_t requested = 0;
+    const auto topics = request.get_string_list("topics");
+    if (topics) {
+        for (const auto& name : *topics) {
+            const auto topic = sysutil::parse_event_topic(name);
+            if (!topic) {
+                out.begin_object()
+                    .field("type", responseType)
+                    .field("ok", false)
+                    .field("message", "Unknown topic: " + name)
+                    .end_object()
+                    .end_line();
+                return;
+            }
+            requested |= topicBit(*topic);
+        }
+    } else if (!subscribe) {
+        // A bare unsubscribe drops every topic.
+        requested = client.subscriptions;
+    }
+    setSubscriptions(client, subscribe ? (client.subscriptions | requested)
+                                       : (client.subscriptions & ~requested));
+
+    out.begin_object()
+        .field("type", responseType)
+        .field("ok", true)
+        .begin_array("topics");
+    for (std::size_t i = 0; i < sysutil::kEventTopicCount; ++i) {
+        const auto topic = static_cast<sysutil::EventTopic>(i);
+        if ((client.subscriptions & topicBit(topic)) != 0) {
+            out.value(sysutil::event_topic_name(topic));
+        }
+    }
+    out.end_array().end_object().end_line();
+}
+
+// Handles sysutil.encoding.request. The reply goes out in the old encoding;
+// every message after it, in both directions, uses the new one.
+void handleEncodingRequest(ClientState& client,
+                           const sysutil::ParsedMessage& request,
+                           sysutil::JsonWriter& out) {
+    out.begin_object().field("type", "sysutil.encoding.response");
+    const auto name = request.get_string("encoding");
+    const auto encoding =
+        name ? sysutil::parse_encoding(*name) : std::nullopt;
+    if (!encoding) {
+        out.field("ok", false)
+            .field("message", "Unsupported encoding")
+            .field("encoding", sysutil::encoding_name(client.encoding))
+            .end_object()
+            .end_line();
+        return;
+    }
+    // A worker reply built in the old encoding could otherwise arrive after
+    // the switch.
+    if (client.inFlight > 0) {
+        out.field("ok", false)
+            .field("message", "Requests still pending")
+            .field("encoding", sysutil::encoding_name(client.encoding))
+            .end_object()
+            .end_line();
+        return;
+    }
+    client.encoding = *encoding;
+    client.framer.set_length_prefixed(*encoding == sysutil::Encoding::Cbor);
+    out.field("ok", true)
+        .field("encoding", sysutil::encoding_name(*encoding))
+        .end_object()
+        .end_line();
+}
+
+// Handles sysutil.hello: everything a client needs to configure itself in one
+// round trip instead of probing request types one by one.
+void handleHello(const ClientState& client, sysutil::JsonWriter& out) {
+    out.begin_object()
+        .field("type", "sysutil.hello.response")
+        .field("ok", true)
+        .field("version", OPENHD_SYS_UTILS_VERSION)
+        .begin_array("types");
+    // Connection-level requests are answered before the dispatcher.
+    for (const char* type : {"sysutil.hello", "sysutil.batch",
+                             "sysutil.subscribe", "sysutil.unsubscribe",
+                             "sysutil.encoding.request"}) {
+        out.value(type);
+    }
+    for (const auto& info : sysutil::request_handlers()) {
+        out.value(info.type);
+    }
+    out.end_array().begin_array("topics");
+    for (std::size_t i = 0; i < sysutil::kEventTopicCount; ++i) {
+        out.value(sysutil::event_topic_name(static_cast<sysutil::EventTopic>(i)));
+    }
+    out.end_array().begin_array("encodings");
+    for (std::size_t i = 0; i < sysutil::kEncodingCount; ++i) {
+        out.value(sysutil::encoding_name(static_cast<sysutil::Encoding>(i)));
+    }
+    out.end_array()
+        .field("encoding", sysutil::encoding_name(client.encoding))
+        .begin_array("framings")
+        .value("lines")
+        .value("length_prefixed")
+        .value("packets")
+        .end_array()
+        .field("framing", client.seqpacket ? "packets"
+                          : client.encoding == sysutil::Encoding::Cbor
+                              ? "length_prefixed"
+                              : "lines")
+        .begin_object("sockets")
+        .field("stream", kSocketPath);
+    if (gSeqpacketListening) {
+        out.field("seqpacket", kSeqSocketPath);
+    }
+    out.end_object()
+        .begin_object("limits")
+        .field("max_message_bytes", kMaxLineLength)
+        .field("max_in_flight", kMaxInFlightPerClient)
+        .field("max_batch_requests", kMaxBatchRequests)
+        .field("max_queued_bytes", gOutboundLimits.highWaterBytes)
+        .field("drop_oldest",
+               gOutboundLimits.policy == OverflowPolicy::DropOldest)
+        .end_object()
+        .end_object()
+        .end_line();
+}
+
+// Queues an event on every subscribed connection. Runs on the reactor thread.
+void deliverEvent(sysutil::Reactor& reactor, ClientMap& clients,
+                  sysutil::EventTopic topic, const std::string& payload) {
+    std::vector<int> failed;
+    // Transcoded once, for the first CBOR subscriber.
+    std::optional<std::string> cborPayload;
+    for (auto& entry : clients) {
+        auto& client = entry.second;
+        if ((client.subscriptions & topicBit(topic)) == 0) {
+            continue;
+        }
+        if (client.encoding == sysutil::Encoding::Cbor) {
+            if (!cborPayload) {
+                cborPayload = sysutil::json_line_to_cbor(payload);
+            }
+            if (cborPayload->empty()) {
+                continue;
+            }
+            queueOutbound(client, *cborPayload, client.encoding);
+        } else {
+            queueOutbound(client, payload, client.encoding);
+        }
+        if (!flushOutbound(entry.first, client) ||
+            !enforceHighWater(entry.first, client)) {
+            failed.push_back(entry.first);
+        }
+    }
+    for (const int fd : failed) {
+        closeClient(reactor, fd, clients);
+    }
+}
+
+// Sub-responses of one sysutil.batch. Only touched on the reactor thread.
+struct BatchState {
+    // Carries the batch's own id lead and the recycled buffer.
+    sysutil::JsonWriter response;
+    std::vector<std::string> parts;
+    std::size_t remaining = 0;
+};
+
+std::string finishBatch(BatchState& batch) {
+    auto& out = batch.response;
+    out.begin_object()
+        .field("type", "sysutil.batch.response")
+        .field("ok", true)
+        .begin_array("responses");
+    for (const auto& part : batch.parts) {
+        out.value_message(part);
+    }
+    out.end_array().end_object().end_line();
+    return out.take();
+}
+
+// Requests may name the members they need in "fields"; the rest of a
+// large response (wifi cards, settings) is then never written.
+void applyProjection(const sysutil::ParsedMessage& request,
+                     sysutil::JsonWriter& response) {
+    if (auto fields = request.get_string_list("fields")) {
+        response.set_projection(std::move(*fields));
+    }
+}
+
+// Runs the sub-requests of a sysutil.batch and answers with one response
+// holding their replies in request order. Fast handlers run inline; lane
+// handlers run concurrently on the worker pool, and the batch occupies a
+// single response slot until the last of them finishes.
+void dispatchBatch(sysutil::Reactor& reactor, ClientMap& clients, int fd,
+                   ClientState& client, const sysutil::ParsedMessage& request,
+                   sysutil::JsonWriter& response, bool tagged) {
+    const auto requests = request.get_raw_list("requests");
+    const char* error = nullptr;
+    if (!requests || requests->empty()) {
+        error = "Batch without requests";
+    } else if (requests->size() > kMaxBatchRequests) {
+        error = "Too many requests in batch";
+    } else if (client.inFlight >= kMaxInFlightPerClient) {
+        error = "Too many pending requests: sysutil.batch";
+    }
+    if (error != nullptr) {
+        sysutil::build_error_response(response, error);
+        client.responses.push_back(
+            {true, tagged, false, response.encoding(), response.take()});
+        return;
+    }
+
+    auto batch = std::make_shared<BatchState>();
+    batch->response = std::move(response);
+    batch->parts.resize(requests->size());
+    batch->remaining = requests->size();
+    const std::uint64_t seq = client.headSeq + client.responses.size();
+    const std::uint64_t clientId = client.id;
+    client.responses.push_back({false, tagged, false, client.encoding, {}});
+    ++client.inFlight;
+
+    for (std::size_t i = 0; i < requests->size(); ++i) {
+        const std::string_view text = (*requests)[i];
+        const sysutil::ParsedMessage sub(text, client.encoding);
+        sysutil::JsonWriter writer;
+        writer.set_encoding(client.encoding);
+        const auto subId = sub.get_raw_scalar("id");
+        if (subId) {
+            writer.lead_with("id", *subId);
+        }
+        const auto type = sub.get_string("type").value_or("");
+        const auto* info = sysutil::find_request_handler(type);
+        if (type == "sysutil.hello") {
+            handleHello(client, writer);
+        } else if (type == "sysutil.batch" || type == "sysutil.subscribe" ||
+                   type == "sysutil.unsubscribe" ||
+                   type == "sysutil.encoding.request") {
+            // These change connection state or nest batches.
+            sysutil::build_error_response(
+                writer, "Not allowed in sysutil.batch: " + type);
+        } else if (info == nullptr) {
+            sysutil::build_error_response(
+                writer, "Unknown sysutil request: " + type);
+        } else if (info->lane.empty()) {
+            applyProjection(sub, writer);
+            sysutil::run_request_handler(*info, sub, writer);
+        } else {
+            applyProjection(sub, writer);
+            const bool queued = sysutil::submit_worker_job(
+                info->lane,
+                [info, sub = sysutil::ParsedMessage::owning(std::string(text),
+                                                      client.encoding),
+                 writer = std::move(writer), batch, i, &reactor, &clients, fd,
+                 clientId, seq]() mutable {
+                    sysutil::run_request_handler(*info, sub, writer);
+                    reactor.post([batch, i, &reactor, &clients, fd, clientId,
+                                  seq, payload = writer.take()]() mutable {
+                        batch->parts[i] = std::move(payload);
+                        if (--batch->remaining == 0) {
+                            completeResponse(reactor, clients, fd, clientId,
+                                             seq, finishBatch(*batch));
+                        }
+                    });
+                });
+            if (queued) {
+                continue;
+            }
+            // The rejected job took the writer with it.
+            writer.reset();
+            if (subId) {
+                writer.lead_with("id", *subId);
+            }
+            sysutil::build_error_response(writer, "Worker queue full: " + type);
+        }
+        batch->parts[i] = writer.take();
+        --batch->remaining;
+    }
+
+    // Nothing went to the pool: fill the slot now instead of waiting for a
+    // completion that will never be posted.
+    if (batch->remaining == 0) {
+        auto& slot = client.responses[seq - client.headSeq];
+        slot.ready = true;
+        slot.payload = finishBatch(*batch);
+        --client.inFlight;
+    }
+}
+
+void dispatchLine(sysutil::Reactor& reactor, ClientMap& clients, int fd,
+                  ClientState& client, std::string_view line) {
+    const sysutil::ParsedMessage request(line, client.encoding);
+    const auto type = request.get_string("type");
+    if (!type || type->rfind("sysutil.", 0) != 0) {
+        sysutil::handle_status_message(request);
+        return;
+    }
+    // Responses are written into the connection's recycled buffer; the
+    // request "id", if any, is echoed as the first field.
+    sysutil::JsonWriter response(std::move(client.spare));
+    response.set_encoding(client.encoding);
+    const auto requestId = request.get_raw_scalar("id");
+    if (requestId) {
+        response.lead_with("id", *requestId);
+    }
+    const bool tagged = requestId.has_value();
+    auto reply = [&]() {
+        client.responses.push_back(
+            {true, tagged, false, response.encoding(), response.take()});
+    };
+    if (*type == "sysutil.subscribe" || *type == "sysutil.unsubscribe") {
+        handleSubscription(client, request, *type == "sysutil.subscribe",
+                           response);
+        reply();
+        return;
+    }
+    if (*type == "sysutil.hello") {
+        handleHello(client, response);
+        reply();
+        return;
+    }
+    if (*type == "sysutil.encoding.request") {
+        handleEncodingRequest(client, request, response);
+        reply();
+        return;
+    }
+    if (*type == "sysutil.batch") {
+        dispatchBatch(reactor, clients, fd, client, request, response, tagged);
+        return;
+    }
+    const auto* info = sysutil::find_request_handler(*type);
+    if (info == nullptr) {
+        sysutil::build_error_response(response,
+                                      "Unknown sysutil request: " + *type);
+        reply();
+        return;
+    }
+    applyProjection(request, response);
+    if (info->lane.empty()) {
+        sysutil::run_request_handler(*info, request, response);
+        reply();
+        return;
+    }
+    if (client.inFlight >= kMaxInFlightPerClient) {
+        sysutil::build_error_response(response,
+                                      "Too many pending requests: " + *type);
+        reply();
+        return;
+    }
+    const std::uint64_t seq = client.headSeq + client.responses.size();
+    const std::uint64_t clientId = client.id;
+    // The job owns its copy of the request; the writer (and the recycled
+    // buffer inside it) moves along with it.
+    const bool queued = sysutil::submit_worker_job(
+        info->lane,
+        [info, request = sysutil::ParsedMessage::owning(std::string(line),
+                                                  client.encoding),
+         writer = std::move(response), &reactor, &clients, fd, clientId,
+         seq]() mutable {
+            sysutil::run_request_handler(*info, request, writer);
+            reactor.post([&reactor, &clients, fd, clientId, seq,
+                          payload = writer.take()]() mutable {
+                completeResponse(reactor, clients, fd, clientId, seq,
+                                 std::move(payload));
+            });
+        });
+    if (!queued) {
+        // The rejected job took the writer with it.
+        response.reset();
+        if (requestId) {
+            response.lead_with("id", *requestId);
+        }
+        sysutil::build_error_response(response,
+                                      "Worker queue full: " + *type);
+        reply();
+        return;
+    }
+    client.responses.push_back({false, tagged, false, client.encoding, {}});
+    ++client.inFlight;
+}
+
+void logRequest(const ClientState& client, std::string_view line) {
+    if (client.encoding == sysutil::Encoding::Cbor) {
+        std::cout << "sysutils <= " << line.size() << " bytes of CBOR"
+                  << std::endl;
+    } else {
+        std::cout << "sysutils <= " << line << std::endl;
+    }
+}
+
+void rejectOverlongLine(ClientState& client) {
+    sysutil::JsonWriter response(std::move(client.spare));
+    response.set_encoding(client.encoding);
+    sysutil::build_error_response(
+        response,
+        "Request line exceeds " + std::to_string(kMaxLineLength) + " bytes");
+    client.responses.push_back(
+        {true, false, false, response.encoding(), response.take()});
+}
+
+// Reads one packet per recv(). MSG_TRUNC reports the real packet length, so
+// oversized requests are rejected instead of being cut short.
+bool handleClientPackets(sysutil::Reactor& reactor, ClientMap& clients, int fd,
+                         ClientState& client) {
+    char packet[kMaxLineLength + 1];
     while (true) {
-        ssize_t count = ::read(fd, readBuf, sizeof(readBuf));
+        const ssize_t count = ::recv(fd, packet, sizeof(packet), MSG_TRUNC);
         if (count > 0) {
-            auto& buffer = buffers[fd];
-            buffer.append(readBuf, static_cast<std::size_t>(count));
-            if (buffer.size() > kMaxLineLength * 2) {
-                buffer.erase(0, buffer.size() - kMaxLineLength);
+            auto length = static_cast<std::size_t>(count);
+            if (client.encoding == sysutil::Encoding::Json &&
+                length <= sizeof(packet) && packet[length - 1] == '\n') {
+                --length;
             }
-            std::size_t pos = 0;
-            while ((pos = buffer.find('\n')) != std::string::npos) {
-                std::string line = buffer.substr(0, pos);
-                buffer.erase(0, pos + 1);
-                if (line.size() > kMaxLineLength) {
-                    line = line.substr(0, kMaxLineLength);
-                }
+            if (length > kMaxLineLength) {
+                rejectOverlongLine(client);
+            } else {
+                const std::string_view line(packet, length);
                 if (gDebug) {
-                    std::cout << "sysutils <= " << line << std::endl;
+                    logRequest(client, line);
+                }
+                dispatchLine(reactor, clients, fd, client, line);
+            }
+            if (!flushResponses(fd, client)) {
+                return false;
+            }
+        } else if (count == 0) {
+            return false;
+        } else {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+}
+
+bool handleClientData(sysutil::Reactor& reactor, int fd, ClientMap& clients) {
+    auto& client = clients[fd];
+    if (client.seqpacket) {
+        return handleClientPackets(reactor, clients, fd, client);
+    }
+    char readBuf[kMaxLineLength];
+    while (true) {
+        ssize_t count = ::read(fd, readBuf, sizeof(readBuf));
+        if (count > 0) {
+            client.framer.append(readBuf, static_cast<std::size_t>(count));
+            // Lines are views into the framer and are dispatched before the
+            // next read appends to it.
+            std::string_view line;
+            sysutil::LineFramer::Result result;
+            while ((result = client.framer.next(line)) !=
+                   sysutil::LineFramer::Result::NeedMore) {
+                if (result == sysutil::LineFramer::Result::Overlong) {
+                    rejectOverlongLine(client);
+                    continue;
                 }
-                if (sysutil::is_platform_request(line)) {
-                    const auto response = sysutil::build_platform_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_platform_update_request(line)) {
-                    const auto response = sysutil::handle_platform_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_settings_request(line)) {
-                    const auto response = sysutil::build_settings_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_settings_update(line)) {
-                    const auto response = sysutil::handle_settings_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_camera_setup_request(line)) {
-                    const auto response = sysutil::handle_camera_setup_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_debug_request(line)) {
-                    const auto response = sysutil::build_debug_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_debug_update(line)) {
-                    const auto response = sysutil::handle_debug_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_status_request(line)) {
-                    const auto response = sysutil::build_status_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_wifi_request(line)) {
-                    const auto response = sysutil::build_wifi_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_wifi_update_request(line)) {
-                    const auto response = sysutil::handle_wifi_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_link_control_request(line)) {
-                    const auto response = sysutil::handle_link_control_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_video_request(line)) {
-                    const auto response = sysutil::handle_video_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_update_info_request(line)) {
-                    const auto response = sysutil::handle_update_info_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_update_request(line)) {
-                    const auto response = sysutil::handle_update_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (auto type = sysutil::extract_string_field(line, "type");
-                           type && *type == "sysutil.partitions.request") {
-                    const auto response = sysutil::build_partitions_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (auto type = sysutil::extract_string_field(line, "type");
-                           type && *type == "sysutil.partition.resize.request") {
-                    const auto choice =
-                        sysutil::extract_string_field(line, "choice")
-                            .value_or("no");
-                    const auto response =
-                        sysutil::handle_partition_resize_request(choice);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (auto type = sysutil::extract_string_field(line, "type");
-                           type && type->rfind("sysutil.", 0) == 0) {
-                    std::ostringstream out;
-                    out << "{\"type\":\"sysutil.error\",\"ok\":false,"
-                           "\"message\":\"Unknown sysutil request: "
-                        << *type << "\"}\n";
-                    if (gDebug) {
-                        std::cout << "sysutils => " << out.str();
-                    }
-                    (void)sendAll(fd, out.str());
-                } else {
-                    sysutil::handle_status_message(line);
+                if (gDebug) {
+                    logRequest(client, line);
                 }
+                dispatchLine(reactor, clients, fd, client, line);
+            }
+            if (!flushResponses(fd, client)) {
+                return false;
             }
         } else if (count == 0) {
             return false;
@@ -386,6 +1036,11 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // Config and override writes from here on are coalesced and written
+    // atomically by the persist worker.
+    PersistWorkerGuard persistWorker;
+    // Shared-memory state for readers that poll instead of connecting.
+    StatePageGuard statePage;
     remove_space_image();
     sysutil::init_leds();
     sysutil::set_status("sysutils.started", "Sysutils started",
@@ -394,6 +1049,7 @@ int main(int argc, char* argv[]) {
     sysutil::start_openhd_glide_early_if_needed();
     sysutil::run_firstboot_tasks();
     sysutil::mount_known_partitions();
+    sysutil::load_status_history();
     sysutil::sync_settings_from_files();
     sysutil::init_update_worker();
     sysutil::init_wifi_info();
@@ -411,84 +1067,206 @@ int main(int argc, char* argv[]) {
     } else {
         std::cerr << "[sysutils][wifi] OpenHD-compatible Wi-Fi card detected." << std::endl;
     }
-    auto next_wifi_retry = std::chrono::steady_clock::now() +
-                           std::chrono::seconds(5);
 
-    int serverFd = createAndBindSocket();
+    sysutil::register_platform_handlers();
+    sysutil::register_settings_handlers();
+    sysutil::register_debug_handlers();
+    sysutil::register_status_handlers();
+    sysutil::register_wifi_handlers();
+    sysutil::register_video_handlers();
+    sysutil::register_update_handlers();
+    sysutil::register_part_handlers();
+
+    int serverFd = createAndBindSocket(kSocketPath, SOCK_STREAM);
     if (serverFd < 0) {
         return 1;
     }
 
     SocketGuard socketGuard(kSocketPath);
+    // The packet endpoint is optional; legacy clients only need the stream.
+    int seqServerFd = createAndBindSocket(kSeqSocketPath, SOCK_SEQPACKET);
+    SocketGuard seqSocketGuard(kSeqSocketPath);
+    if (seqServerFd < 0) {
+        seqSocketGuard.disarm();
+        std::cerr << "SOCK_SEQPACKET endpoint unavailable; serving "
+                  << kSocketPath << " only." << std::endl;
+    }
+    sysutil::Reactor reactor;
+    if (!reactor.open()) {
+        ::close(serverFd);
+        if (seqServerFd >= 0) {
+            ::close(seqServerFd);
+        }
+        return 1;
+    }
+    gReactor = &reactor;
     if (!installSignalHandlers()) {
         return 1;
     }
 
-    std::unordered_map<int, std::string> clientBuffers;
-    std::vector<pollfd> pollFds;
+    loadOutboundLimits();
+    ClientMap clients;
+    std::uint64_t nextClientId = 1;
     int exitCode = 0;
+    sysutil::start_worker_pool(kWorkerThreads, kMaxQueuedWorkerJobs);
+    // Events are published from worker, update and reactor threads alike;
+    // fan-out always happens on the reactor thread.
+    sysutil::set_event_sink([&reactor, &clients](sysutil::EventTopic topic,
+                                                 std::string payload) {
+        reactor.post([&reactor, &clients, topic, payload = std::move(payload)]() {
+            deliverEvent(reactor, clients, topic, payload);
+        });
+    });
 
-    while (!gStopRequested) {
-        pollFds.clear();
-        pollFds.push_back({serverFd, POLLIN, 0});
-        for (const auto& entry : clientBuffers) {
-            pollFds.push_back({entry.first, POLLIN | POLLERR | POLLHUP, 0});
+    auto onClientEvent = [&reactor, &clients](int clientFd, std::uint32_t events) {
+        bool keepOpen = true;
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            keepOpen = handleClientData(reactor, clientFd, clients);
         }
-
-        int ready = ::poll(pollFds.data(), pollFds.size(), 500);
-        if (ready < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            std::perror("poll");
-            exitCode = 1;
-            break;
+        if (keepOpen && (events & EPOLLOUT)) {
+            keepOpen = flushOutbound(clientFd, clients[clientFd]);
+        }
+        if (!keepOpen || (events & (EPOLLERR | EPOLLHUP))) {
+            closeClient(reactor, clientFd, clients);
         }
+    };
 
-        for (const auto& pfd : pollFds) {
-            if (pfd.revents == 0) continue;
-            if (pfd.fd == serverFd && (pfd.revents & POLLIN)) {
-                while (true) {
-                    int clientFd = ::accept(serverFd, nullptr, nullptr);
-                    if (clientFd < 0) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-                        std::perror("accept");
-                        break;
-                    }
-                    setNonBlocking(clientFd);
-                    clientBuffers.emplace(clientFd, std::string{});
-                }
-            } else if (pfd.fd != serverFd) {
-                bool keepOpen = true;
-                if (pfd.revents & POLLIN) {
-                    keepOpen = handleClientData(pfd.fd, clientBuffers);
-                }
-                if (!keepOpen || (pfd.revents & (POLLERR | POLLHUP))) {
-                    closeClient(pfd.fd, clientBuffers);
-                }
+    auto acceptClients = [&](int listenFd, bool seqpacket) {
+        while (true) {
+            int clientFd = ::accept(listenFd, nullptr, nullptr);
+            if (clientFd < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+                std::perror("accept");
+                break;
             }
+            setNonBlocking(clientFd);
+            auto& client = clients[clientFd];
+            client.id = nextClientId++;
+            client.seqpacket = seqpacket;
+            // EPOLLOUT stays registered; in edge-triggered mode it only
+            // fires when a full socket buffer drains again.
+            if (!reactor.add(clientFd, EPOLLIN | EPOLLOUT | EPOLLRDHUP,
+                             [clientFd, &onClientEvent](std::uint32_t events) {
+                                 onClientEvent(clientFd, events);
+                             })) {
+                ::close(clientFd);
+                clients.erase(clientFd);
+            }
+        }
+    };
+    const bool serverRegistered = reactor.add(serverFd, EPOLLIN, [&](std::uint32_t) {
+        acceptClients(serverFd, false);
+    });
+    if (!serverRegistered) {
+        ::close(serverFd);
+        if (seqServerFd >= 0) {
+            ::close(seqServerFd);
         }
+        return 1;
+    }
+    if (seqServerFd >= 0 &&
+        !reactor.add(seqServerFd, EPOLLIN, [&](std::uint32_t) {
+            acceptClients(seqServerFd, true);
+        })) {
+        std::cerr << "Failed to watch " << kSeqSocketPath << std::endl;
+        ::close(seqServerFd);
+        seqServerFd = -1;
+        seqSocketGuard.disarm();
+        ::unlink(std::string(kSeqSocketPath).c_str());
+    }
+    gSeqpacketListening = seqServerFd >= 0;
 
-        if (wifi_retry_active) {
-            const auto now = std::chrono::steady_clock::now();
-            if (now >= next_wifi_retry) {
-                ++wifi_retry_attempt;
-                std::cerr << "[sysutils][wifi] Retry attempt #" << wifi_retry_attempt
-                          << " for OpenHD-compatible Wi-Fi card detection." << std::endl;
-                sysutil::refresh_wifi_info();
-                wifi_retry_active = !sysutil::has_openhd_wifibroadcast_cards();
-                if (!wifi_retry_active) {
+    // The retry timer only exists while no compatible card has been found;
+    // once detection succeeds it is disarmed and never wakes the daemon again.
+    // Detection can block for seconds, so it runs on the Wi-Fi worker lane and
+    // at most one attempt is queued at a time.
+    int wifiRetryTimer = -1;
+    bool wifiRetryQueued = false;
+    wifiRetryTimer = reactor.add_timer([&]() {
+        if (wifiRetryQueued) {
+            return;
+        }
+        const std::size_t attempt = ++wifi_retry_attempt;
+        std::cerr << "[sysutils][wifi] Retry attempt #" << attempt
+                  << " for OpenHD-compatible Wi-Fi card detection." << std::endl;
+        wifiRetryQueued = sysutil::submit_worker_job("wifi", [&, attempt]() {
+            sysutil::refresh_wifi_info();
+            const bool found = sysutil::has_openhd_wifibroadcast_cards();
+            reactor.post([&, attempt, found]() {
+                wifiRetryQueued = false;
+                wifi_retry_active = !found;
+                if (found) {
                     std::cerr << "[sysutils][wifi] OpenHD-compatible Wi-Fi card found on retry #"
-                              << wifi_retry_attempt << "." << std::endl;
+                              << attempt << "." << std::endl;
+                    reactor.disarm_timer(wifiRetryTimer);
                 }
-                next_wifi_retry = now + std::chrono::seconds(5);
-            }
+            });
+        });
+    });
+    if (wifi_retry_active && wifiRetryTimer >= 0) {
+        reactor.arm_timer(wifiRetryTimer, kWifiRetryInterval, kWifiRetryInterval);
+    }
+
+    // Status sources that stop reporting expire, and indicator.status floods
+    // are published once per tick. The timer is armed only while something
+    // is waiting; new work posts a rearm.
+    int statusTimer = -1;
+    auto runStatusTimer = [&reactor, &statusTimer]() {
+        const auto delay = sysutil::run_status_timer();
+        if (delay.count() > 0) {
+            reactor.arm_timer(statusTimer, delay);
         }
+    };
+    statusTimer = reactor.add_timer(runStatusTimer);
+    if (statusTimer >= 0) {
+        sysutil::set_status_timer_notifier([&reactor, runStatusTimer]() {
+            reactor.post(runStatusTimer);
+        });
     }
 
-    closeAllClients(clientBuffers);
+    // Config readers share a cached snapshot; the watch drops it when another
+    // process edits config.json. Without the watch readers stat the file.
+    int configWatchFd = sysutil::open_sysutil_config_watch();
+    if (configWatchFd < 0 ||
+        !reactor.add(configWatchFd, EPOLLIN, [](std::uint32_t) {
+            sysutil::handle_sysutil_config_watch();
+        })) {
+        std::cerr << "[sysutils][config] inotify watch unavailable; "
+                  << "checking config.json on every read." << std::endl;
+        sysutil::close_sysutil_config_watch();
+        configWatchFd = -1;
+    }
+
+    while (!gStopRequested) {
+        if (!reactor.run_once()) {
+            exitCode = 1;
+            break;
+        }
+    }
+
+    sysutil::set_event_sink(nullptr);
+    sysutil::set_status_timer_notifier(nullptr);
+    sysutil::stop_worker_pool();
+    closeAllClients(reactor, clients);
+    reactor.remove(serverFd);
+    if (seqServerFd >= 0) {
+        reactor.remove(seqServerFd);
+    }
+    if (configWatchFd >= 0) {
+        reactor.remove(configWatchFd);
+    }
+    sysutil::close_sysutil_config_watch();
+    // Keeps boot diagnostics for the next start.
+    sysutil::save_status_history();
+    gReactor = nullptr;
     ::close(serverFd);
     socketGuard.disarm();
     ::unlink(std::string(kSocketPath).c_str());
+    if (seqServerFd >= 0) {
+        ::close(seqServerFd);
+        seqSocketGuard.disarm();
+        ::unlink(std::string(kSeqSocketPath).c_str());
+    }
     return exitCode;
 }
@@ -314,10 +314,11 @@ bool apply_rock_config(const CameraProfile& profile,
 }  // namespace
 
 bool apply_camera_config_if_needed() {
-  SysutilConfig config;
-  if (load_sysutil_config(config) == ConfigLoadResult::Error) {
+  const auto snapshot = sysutil_config_snapshot();
+  if (snapshot->result == ConfigLoadResult::Error) {
     return false;
   }
+  const SysutilConfig& config = snapshot->config;
   const int platform = platform_info().platform_type;
   bool applied = false;
   if (platform == X_PLATFORM_TYPE_RPI_4 ||
@@ -0,0 +1,301 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#include "sysutil_cbor.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace sysutil {
+namespace {
+
+// Nesting limit for skipped arrays, maps and tags.
+constexpr int kMaxNestingDepth = 32;
+
+std::uint64_t read_big_endian(std::string_view data, std::size_t pos,
+                              std::size_t size) {
+  std::uint64_t value = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    value = (value << 8) | static_cast<unsigned char>(data[pos + i]);
+  }
+  return value;
+}
+
+void append_big_endian(std::string& out, std::uint64_t value,
+                       std::size_t size) {
+  for (std::size_t i = size; i > 0; --i) {
+    out.push_back(static_cast<char>((value >> ((i - 1) * 8)) & 0xFF));
+  }
+}
+
+std::size_t skip_item(std::string_view data, std::size_t pos, int depth) {
+  if (depth > kMaxNestingDepth) {
+    return std::string_view::npos;
+  }
+  CborHead head;
+  if (!read_cbor_head(data, pos, head)) {
+    return std::string_view::npos;
+  }
+  pos += head.size;
+  switch (head.major) {
+    case CborMajor::Unsigned:
+    case CborMajor::Negative:
+      return pos;
+    case CborMajor::Bytes:
+    case CborMajor::Text:
+      if (!head.indefinite()) {
+        if (head.value > data.size() - pos) {
+          return std::string_view::npos;
+        }
+        return pos + static_cast<std::size_t>(head.value);
+      }
+      // Chunks are definite strings of the same major type.
+      while (pos < data.size() && data[pos] != kCborBreak) {
+        CborHead chunk;
+        if (!read_cbor_head(data, pos, chunk) || chunk.major != head.major ||
+            chunk.indefinite()) {
+          return std::string_view::npos;
+        }
+        pos = skip_item(data, pos, depth + 1);
+        if (pos == std::string_view::npos) {
+          return pos;
+        }
+      }
+      return pos < data.size() ? pos + 1 : std::string_view::npos;
+    case CborMajor::Array:
+    case CborMajor::Map: {
+      if (head.indefinite()) {
+        while (pos < data.size() && data[pos] != kCborBreak) {
+          pos = skip_item(data, pos, depth + 1);
+          if (pos == std::string_view::npos) {
+            return pos;
+          }
+        }
+        return pos < data.size() ? pos + 1 : std::string_view::npos;
+      }
+      // Every item takes at least one byte, which bounds hostile counts.
+      const std::uint64_t items =
+          head.major == CborMajor::Map ? head.value * 2 : head.value;
+      if (head.value > data.size() || items > data.size() - pos) {
+        return std::string_view::npos;
+      }
+      for (std::uint64_t i = 0; i < items; ++i) {
+        pos = skip_item(data, pos, depth + 1);
+        if (pos == std::string_view::npos) {
+          return pos;
+        }
+      }
+      return pos;
+    }
+    case CborMajor::Tag:
+      return skip_item(data, pos, depth + 1);
+    case CborMajor::Simple:
+      // A break outside an indefinite item is malformed.
+      return head.indefinite() ? std::string_view::npos : pos;
+  }
+  return std::string_view::npos;
+}
+
+double decode_half(std::uint16_t half) {
+  const int exponent = (half >> 10) & 0x1F;
+  const int mantissa = half & 0x3FF;
+  double value;
+  if (exponent == 0) {
+    value = std::ldexp(mantissa, -24);
+  } else if (exponent != 31) {
+    value = std::ldexp(mantissa + 1024, exponent - 25);
+  } else {
+    value = mantissa == 0 ? INFINITY : NAN;
+  }
+  return (half & 0x8000) ? -value : value;
+}
+
+}  // namespace
+
+bool read_cbor_head(std::string_view data, std::size_t pos, CborHead& head) {
+  if (pos >= data.size()) {
+    return false;
+  }
+  const auto initial = static_cast<unsigned char>(data[pos]);
+  head.major = static_cast<CborMajor>(initial >> 5);
+  head.info = initial & 0x1F;
+  if (head.info < 24) {
+    head.value = head.info;
+    head.size = 1;
+    return true;
+  }
+  if (head.info <= 27) {
+    const std::size_t length = std::size_t{1} << (head.info - 24);
+    if (length > data.size() - pos - 1) {
+      return false;
+    }
+    head.value = read_big_endian(data, pos + 1, length);
+    head.size = 1 + length;
+    return true;
+  }
+  if (head.info == kCborIndefinite &&
+      head.major != CborMajor::Unsigned && head.major != CborMajor::Negative &&
+      head.major != CborMajor::Tag) {
+    head.value = 0;
+    head.size = 1;
+    return true;
+  }
+  return false;
+}
+
+std::size_t skip_cbor_item(std::string_view data, std::size_t pos) {
+  return skip_item(data, pos, 0);
+}
+
+bool read_cbor_text(std::string_view item, std::string& out) {
+  CborHead head;
+  if (!read_cbor_head(item, 0, head) || head.major != CborMajor::Text) {
+    return false;
+  }
+  out.clear();
+  std::size_t pos = head.size;
+  if (!head.indefinite()) {
+    if (head.value > item.size() - pos) {
+      return false;
+    }
+    out.assign(item.substr(pos, static_cast<std::size_t>(head.value)));
+    return true;
+  }
+  while (pos < item.size() && item[pos] != kCborBreak) {
+    CborHead chunk;
+    if (!read_cbor_head(item, pos, chunk) || chunk.major != CborMajor::Text ||
+        chunk.indefinite() || chunk.value > item.size() - pos - chunk.size) {
+      return false;
+    }
+    pos += chunk.size;
+    out.append(item.substr(pos, static_cast<std::size_t>(chunk.value)));
+    pos += static_cast<std::size_t>(chunk.value);
+  }
+  return pos < item.size();
+}
+
+bool read_cbor_number(std::string_view item, double& out) {
+  CborHead head;
+  if (!read_cbor_head(item, 0, head)) {
+    return false;
+  }
+  switch (head.major) {
+    case CborMajor::Unsigned:
+      out = static_cast<double>(head.value);
+      return true;
+    case CborMajor::Negative:
+      out = -1.0 - static_cast<double>(head.value);
+      return true;
+    case CborMajor::Simple:
+      break;
+    default:
+      return false;
+  }
+  if (head.info == 25) {
+    out = decode_half(static_cast<std::uint16_t>(head.value));
+    return true;
+  }
+  if (head.info == 26) {
+    const auto bits = static_cast<std::uint32_t>(head.value);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    out = value;
+    return true;
+  }
+  if (head.info == 27) {
+    std::memcpy(&out, &head.value, sizeof(out));
+    return true;
+  }
+  return false;
+}
+
+void append_cbor_head(std::string& out, CborMajor major, std::uint64_t value) {
+  const auto type = static_cast<unsigned char>(static_cast<unsigned>(major) << 5);
+  if (value < 24) {
+    out.push_back(static_cast<char>(type | value));
+  } else if (value <= 0xFF) {
+    out.push_back(static_cast<char>(type | 24));
+    append_big_endian(out, value, 1);
+  } else if (value <= 0xFFFF) {
+    out.push_back(static_cast<char>(type | 25));
+    append_big_endian(out, value, 2);
+  } else if (value <= 0xFFFFFFFF) {
+    out.push_back(static_cast<char>(type | 26));
+    append_big_endian(out, value, 4);
+  } else {
+    out.push_back(static_cast<char>(type | 27));
+    append_big_endian(out, value, 8);
+  }
+}
+
+void append_cbor_text(std::string& out, std::string_view text) {
+  append_cbor_head(out, CborMajor::Text, text.size());
+  out.append(text);
+}
+
+void append_cbor_int(std::string& out, long long value) {
+  if (value < 0) {
+    // -1 - value cannot overflow, unlike -value.
+    append_cbor_head(out, CborMajor::Negative,
+                     static_cast<std::uint64_t>(-(value + 1)));
+  } else {
+    append_cbor_head(out, CborMajor::Unsigned,
+                     static_cast<std::uint64_t>(value));
+  }
+}
+
+void append_cbor_uint(std::string& out, unsigned long long value) {
+  append_cbor_head(out, CborMajor::Unsigned, value);
+}
+
+void append_cbor_double(std::string& out, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  out.push_back(static_cast<char>(0xFB));
+  append_big_endian(out, bits, 8);
+}
+
+std::size_t begin_cbor_frame(std::string& out) {
+  const std::size_t start = out.size();
+  out.append(kCborFramePrefix, '\0');
+  return start;
+}
+
+void finish_cbor_frame(std::string& out, std::size_t start) {
+  const std::uint64_t length = out.size() - start - kCborFramePrefix;
+  for (std::size_t i = 0; i < kCborFramePrefix; ++i) {
+    out[start + i] = static_cast<char>(
+        (length >> ((kCborFramePrefix - 1 - i) * 8)) & 0xFF);
+  }
+}
+
+bool read_cbor_frame_length(std::string_view data, std::uint32_t& length) {
+  if (data.size() < kCborFramePrefix) {
+    return false;
+  }
+  length = static_cast<std::uint32_t>(read_big_endian(data, 0, kCborFramePrefix));
+  return true;
+}
+
+}  // namespace sysutil
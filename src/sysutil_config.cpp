@@ -23,46 +23,144 @@
 
 #include "sysutil_config.h"
 
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
-#include <fstream>
-#include <sstream>
+#include <mutex>
+#include <random>
 
+#include "sysutil_persist.h"
 #include "sysutil_protocol.h"
+#include "sysutil_state_page.h"
 
 namespace sysutil {
 namespace {
 
 // Sysutils config location on the target system.
+constexpr const char* kConfigDir = "/usr/local/share/OpenHD/SysUtils";
+constexpr const char* kConfigFileName = "config.json";
 constexpr const char* kConfigPath =
     "/usr/local/share/OpenHD/SysUtils/config.json";
 
-// Escapes JSON string content for output.
-std::string json_escape(const std::string& input) {
-  std::string out;
-  out.reserve(input.size());
-  for (char c : input) {
-    switch (c) {
-      case '\\':
-        out += "\\\\";
-        break;
-      case '"':
-        out += "\\\"";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
+// A published snapshot plus the file version it was read from or written as.
+struct CachedConfig : ConfigSnapshot {
+  FileStamp stamp;
+};
+
+// Serializes cache reloads against writes, so a reload never publishes an
+// older config over one that was just written.
+std::mutex g_config_file_mutex;
+// Current snapshot; null means the next reader reloads from disk. Accessed
+// with std::atomic_load/atomic_store so readers never take
+// g_config_file_mutex. libstdc++ implements those with a small pool of
+// hashed mutexes held only for the pointer copy, so they are not lock-free.
+std::shared_ptr<const CachedConfig> g_cached_config;
+// While the inotify watch runs, a cached snapshot is trusted until the watch
+// reports a change. Without it every reader compares the file stamp.
+std::atomic<bool> g_watch_active{false};
+// inotify descriptor; only touched on the reactor thread.
+int g_watch_fd = -1;
+
+// One generation's changes: bit i stands for kConfigFields[i].
+struct JournalEntry {
+  std::uint64_t generation = 0;
+  std::uint64_t changed_fields = 0;
+};
+constexpr std::size_t kJournalCapacity = 64;
+static_assert(sizeof(kConfigFields) / sizeof(kConfigFields[0]) <= 64,
+              "journal entries hold one bit per config field");
+
+// Last snapshot handed out; survives cache invalidation so the next publish
+// can be diffed against it. Guarded by g_config_file_mutex.
+std::shared_ptr<const CachedConfig> g_last_published;
+// Guards the journal ring, which readers query without the file mutex.
+std::mutex g_journal_mutex;
+std::array<JournalEntry, kJournalCapacity> g_journal;
+std::uint64_t g_generation = 0;
+
+FileStamp stat_config_file() { return stat_file_stamp(kConfigPath); }
+
+void parse_config(const std::string& content, SysutilConfig& config) {
+  const ParsedMessage parsed(content);
+  config = SysutilConfig{};
+  for (std::size_t i = 0; i < parsed.size(); ++i) {
+    const ConfigField* field = find_config_field(parsed.key_at(i));
+    if (!field) {
+      continue;
+    }
+    switch (field->type) {
+      case ConfigFieldType::Bool:
+        config.*field->bool_member = parsed.bool_at(i);
         break;
-      case '\t':
-        out += "\\t";
+      case ConfigFieldType::Int:
+        config.*field->int_member = parsed.int_at(i);
         break;
-      default:
-        out += c;
+      case ConfigFieldType::String:
+        config.*field->string_member = parsed.string_at(i);
         break;
     }
   }
-  return out;
+}
+
+// Makes entry the current snapshot. A config that differs from the previous
+// one gets the next generation and a journal entry naming the changed fields.
+// Caller holds g_config_file_mutex.
+std::shared_ptr<const CachedConfig> publish_locked(
+    std::shared_ptr<CachedConfig> entry) {
+  std::uint64_t changed_fields = 0;
+  if (g_last_published) {
+    std::size_t index = 0;
+    for (const ConfigField& field : kConfigFields) {
+      if (!config_field_equal(g_last_published->config, entry->config,
+                              field)) {
+        changed_fields |= std::uint64_t{1} << index;
+      }
+      ++index;
+    }
+  }
+  const bool changed = !g_last_published || changed_fields != 0;
+  {
+    std::lock_guard<std::mutex> lock(g_journal_mutex);
+    if (!g_last_published) {
+      g_generation = 1;
+    } else if (changed_fields != 0) {
+      ++g_generation;
+      g_journal[g_generation % kJournalCapacity] =
+          JournalEntry{g_generation, changed_fields};
+    }
+    entry->generation = g_generation;
+  }
+  std::shared_ptr<const CachedConfig> published = std::move(entry);
+  g_last_published = published;
+  std::atomic_store(&g_cached_config, published);
+  if (changed) {
+    state_page_set_config(published->config.run_mode.value_or(""));
+  }
+  return published;
+}
+
+// Reads the file (or a write still queued for it) and publishes the result.
+// Caller holds g_config_file_mutex. Read errors are returned but not cached,
+// so the next reader retries.
+std::shared_ptr<const CachedConfig> reload_config_locked() {
+  auto entry = std::make_shared<CachedConfig>();
+  entry->stamp = stat_config_file();
+  std::string content;
+  if (read_persisted_file(kConfigPath, content)) {
+    parse_config(content, entry->config);
+    entry->result = ConfigLoadResult::Loaded;
+  } else if (entry->stamp.exists) {
+    entry->result = ConfigLoadResult::Error;
+    std::atomic_store(&g_cached_config, std::shared_ptr<const CachedConfig>());
+    return entry;
+  }
+  return publish_locked(std::move(entry));
 }
 
 }  // namespace
@@ -70,214 +168,242 @@ std::string json_escape(const std::string& input) {
 // Returns the config path for callers that need to log or remove it.
 const char* sysutil_config_path() { return kConfigPath; }
 
-// Loads config fields from disk, if present.
-ConfigLoadResult load_sysutil_config(SysutilConfig& config) {
-  std::error_code ec;
-  if (!std::filesystem::exists(kConfigPath, ec)) {
-    return ConfigLoadResult::NotFound;
+// Reports whether the config holds a value for a generated field.
+bool config_has_field(const SysutilConfig& config, const ConfigField& field) {
+  switch (field.type) {
+    case ConfigFieldType::Bool:
+      return (config.*field.bool_member).has_value();
+    case ConfigFieldType::Int:
+      return (config.*field.int_member).has_value();
+    case ConfigFieldType::String:
+      return (config.*field.string_member).has_value();
   }
-  std::ifstream file(kConfigPath);
-  if (!file) {
-    return ConfigLoadResult::Error;
+  return false;
+}
+
+// Reports whether two configs agree on a generated field.
+bool config_field_equal(const SysutilConfig& a, const SysutilConfig& b,
+                        const ConfigField& field) {
+  switch (field.type) {
+    case ConfigFieldType::Bool:
+      return a.*field.bool_member == b.*field.bool_member;
+    case ConfigFieldType::Int:
+      return a.*field.int_member == b.*field.int_member;
+    case ConfigFieldType::String:
+      return a.*field.string_member == b.*field.string_member;
   }
+  return true;
+}
 
-  std::ostringstream buffer;
-  buffer << file.rdbuf();
-  const std::string content = buffer.str();
-  config.platform_type = extract_int_field(content, "platform_type");
-  config.platform_name = extract_string_field(content, "platform_name");
-  config.debug_enabled = extract_bool_field(content, "debug");
-  config.set_hostname = extract_bool_field(content, "set_hostname");
-  config.reset_requested = extract_bool_field(content, "reset_requested");
-  config.camera_type = extract_int_field(content, "camera_type");
-  config.camera2_type = extract_int_field(content, "camera2_type");
-  config.camera_resolution_fps =
-      extract_string_field(content, "camera_resolution_fps");
-  config.camera2_resolution_fps =
-      extract_string_field(content, "camera2_resolution_fps");
-  config.camera_port = extract_string_field(content, "camera_port");
-  config.camera2_port = extract_string_field(content, "camera2_port");
-  config.ip_camera_address = extract_string_field(content, "ip_camera_address");
-  config.ip_camera_pipeline =
-      extract_string_field(content, "ip_camera_pipeline");
-  config.camera2_ip_camera_address =
-      extract_string_field(content, "camera2_ip_camera_address");
-  config.camera2_ip_camera_pipeline =
-      extract_string_field(content, "camera2_ip_camera_pipeline");
-  config.ip_camera_bitrate_mbits =
-      extract_int_field(content, "ip_camera_bitrate_mbits");
-  config.run_mode = extract_string_field(content, "run_mode");
-  config.firstboot = extract_bool_field(content, "firstboot");
-  config.init_system = extract_string_field(content, "init_system");
-  config.shell = extract_string_field(content, "shell");
-  config.wifi_enable_autodetect =
-      extract_bool_field(content, "wifi_enable_autodetect");
-  config.wifi_wb_link_cards =
-      extract_string_field(content, "wifi_wb_link_cards");
-  config.wifi_hotspot_card = extract_string_field(content, "wifi_hotspot_card");
-  config.wifi_monitor_card_emulate =
-      extract_bool_field(content, "wifi_monitor_card_emulate");
-  config.wifi_force_no_link_but_hotspot =
-      extract_bool_field(content, "wifi_force_no_link_but_hotspot");
-  config.wifi_local_network_enable =
-      extract_bool_field(content, "wifi_local_network_enable");
-  config.wifi_local_network_ssid =
-      extract_string_field(content, "wifi_local_network_ssid");
-  config.wifi_local_network_password =
-      extract_string_field(content, "wifi_local_network_password");
-  config.nw_ethernet_card = extract_string_field(content, "nw_ethernet_card");
-  config.nw_manual_forwarding_ips =
-      extract_string_field(content, "nw_manual_forwarding_ips");
-  config.nw_forward_to_localhost_58xx =
-      extract_bool_field(content, "nw_forward_to_localhost_58xx");
-  config.ground_unit_ip = extract_string_field(content, "ground_unit_ip");
-  config.air_unit_ip = extract_string_field(content, "air_unit_ip");
-  config.video_port = extract_int_field(content, "video_port");
-  config.telemetry_port = extract_int_field(content, "telemetry_port");
-  config.disable_microhard_detection =
-      extract_bool_field(content, "disable_microhard_detection");
-  config.force_microhard = extract_bool_field(content, "force_microhard");
-  config.microhard_username =
-      extract_string_field(content, "microhard_username");
-  config.microhard_password =
-      extract_string_field(content, "microhard_password");
-  config.microhard_ip_air = extract_string_field(content, "microhard_ip_air");
-  config.microhard_ip_ground =
-      extract_string_field(content, "microhard_ip_ground");
-  config.microhard_ip_range =
-      extract_string_field(content, "microhard_ip_range");
-  config.microhard_video_port =
-      extract_int_field(content, "microhard_video_port");
-  config.microhard_telemetry_port =
-      extract_int_field(content, "microhard_telemetry_port");
-  config.gen_enable_last_known_position =
-      extract_bool_field(content, "gen_enable_last_known_position");
-  config.gen_rf_metrics_level =
-      extract_int_field(content, "gen_rf_metrics_level");
-  config.disable_openhd_service =
-      extract_bool_field(content, "disable_openhd_service");
-  return ConfigLoadResult::Loaded;
+std::uint64_t config_epoch() {
+  static const std::uint64_t epoch = [] {
+    std::random_device random;
+    const std::uint64_t value =
+        (std::uint64_t{random()} << 32 | random()) &
+        ((std::uint64_t{1} << 53) - 1);
+    return value != 0 ? value : 1;
+  }();
+  return epoch;
 }
 
-// Writes the config only when no file exists yet.
-bool write_sysutil_config_if_missing(const SysutilConfig& config) {
-  std::error_code ec;
-  if (std::filesystem::exists(kConfigPath, ec)) {
-    return true;
+// Collects the journal entries in (since, until]. Fails when since is unknown
+// or the ring no longer covers the range.
+std::optional<std::uint64_t> config_changes_between(std::uint64_t since,
+                                                    std::uint64_t until) {
+  if (since == 0 || since > until) {
+    return std::nullopt;
   }
-  return write_sysutil_config(config);
+  if (until - since > kJournalCapacity) {
+    return std::nullopt;
+  }
+  std::lock_guard<std::mutex> lock(g_journal_mutex);
+  std::uint64_t changed_fields = 0;
+  for (std::uint64_t generation = since + 1; generation <= until;
+       ++generation) {
+    const JournalEntry& entry = g_journal[generation % kJournalCapacity];
+    if (entry.generation != generation) {
+      return std::nullopt;
+    }
+    changed_fields |= entry.changed_fields;
+  }
+  return changed_fields;
 }
 
-// Writes the config file, replacing any existing file.
-bool write_sysutil_config(const SysutilConfig& config) {
-  std::error_code ec;
-  std::filesystem::create_directories(
-      std::filesystem::path(kConfigPath).parent_path(), ec);
-  if (ec) {
-    return false;
+// Returns the cached snapshot, reloading it when it is missing or stale.
+std::shared_ptr<const ConfigSnapshot> sysutil_config_snapshot() {
+  auto cached = std::atomic_load(&g_cached_config);
+  if (cached && (g_watch_active.load(std::memory_order_acquire) ||
+                 cached->stamp == stat_config_file())) {
+    return cached;
   }
+  std::lock_guard<std::mutex> lock(g_config_file_mutex);
+  // Another thread may have reloaded while this one waited for the lock.
+  cached = std::atomic_load(&g_cached_config);
+  if (cached && cached->stamp == stat_config_file()) {
+    return cached;
+  }
+  return reload_config_locked();
+}
 
-  std::ofstream file(kConfigPath);
-  if (!file) {
-    return false;
+// Copies config fields from the cached snapshot, if the file is present.
+ConfigLoadResult load_sysutil_config(SysutilConfig& config) {
+  const auto snapshot = sysutil_config_snapshot();
+  if (snapshot->result == ConfigLoadResult::Loaded) {
+    config = snapshot->config;
+  }
+  return snapshot->result;
+}
+
+// Writes the config only when no file exists yet (or is queued).
+bool write_sysutil_config_if_missing(const SysutilConfig& config) {
+  if (sysutil_config_snapshot()->result != ConfigLoadResult::NotFound) {
+    return true;
   }
+  return write_sysutil_config(config);
+}
 
-  file << "{\n";
+// Replaces the config file. The write goes through the persistence layer, so
+// it is atomic and coalesced with other writes in the same burst; readers see
+// the new config immediately.
+bool write_sysutil_config(const SysutilConfig& config) {
+  std::string content = "{\n";
   bool wrote_field = false;
-  auto write_bool = [&](const char* key, const std::optional<bool>& value) {
-    if (!value) {
-      return;
-    }
-    if (wrote_field) {
-      file << ",\n";
-    }
-    file << "  \"" << key << "\": " << (*value ? "true" : "false");
-    wrote_field = true;
-  };
-  auto write_int = [&](const char* key, const std::optional<int>& value) {
-    if (!value) {
-      return;
+  for (const ConfigField& field : kConfigFields) {
+    if (!config_has_field(config, field)) {
+      continue;
     }
     if (wrote_field) {
-      file << ",\n";
+      content += ",\n";
     }
-    file << "  \"" << key << "\": " << *value;
-    wrote_field = true;
-  };
-  auto write_string = [&](const char* key,
-                          const std::optional<std::string>& value) {
-    if (!value) {
-      return;
-    }
-    if (wrote_field) {
-      file << ",\n";
+    content += "  \"";
+    content += field.key;
+    content += "\": ";
+    switch (field.type) {
+      case ConfigFieldType::Bool:
+        content += *(config.*field.bool_member) ? "true" : "false";
+        break;
+      case ConfigFieldType::Int:
+        content += std::to_string(*(config.*field.int_member));
+        break;
+      case ConfigFieldType::String:
+        content += '"';
+        append_json_escaped(content, *(config.*field.string_member));
+        content += '"';
+        break;
     }
-    file << "  \"" << key << "\": \"" << json_escape(*value) << "\"";
     wrote_field = true;
-  };
-
-  write_int("platform_type", config.platform_type);
-  write_string("platform_name", config.platform_name);
-  write_bool("debug", config.debug_enabled);
-  write_bool("set_hostname", config.set_hostname);
-  write_bool("reset_requested", config.reset_requested);
-  write_int("camera_type", config.camera_type);
-  write_int("camera2_type", config.camera2_type);
-  write_string("camera_resolution_fps", config.camera_resolution_fps);
-  write_string("camera2_resolution_fps", config.camera2_resolution_fps);
-  write_string("camera_port", config.camera_port);
-  write_string("camera2_port", config.camera2_port);
-  write_string("ip_camera_address", config.ip_camera_address);
-  write_string("ip_camera_pipeline", config.ip_camera_pipeline);
-  write_string("camera2_ip_camera_address", config.camera2_ip_camera_address);
-  write_string("camera2_ip_camera_pipeline", config.camera2_ip_camera_pipeline);
-  write_int("ip_camera_bitrate_mbits", config.ip_camera_bitrate_mbits);
-  write_string("run_mode", config.run_mode);
-  write_bool("firstboot", config.firstboot);
-  write_string("init_system", config.init_system);
-  write_string("shell", config.shell);
-  write_bool("wifi_enable_autodetect", config.wifi_enable_autodetect);
-  write_string("wifi_wb_link_cards", config.wifi_wb_link_cards);
-  write_string("wifi_hotspot_card", config.wifi_hotspot_card);
-  write_bool("wifi_monitor_card_emulate", config.wifi_monitor_card_emulate);
-  write_bool("wifi_force_no_link_but_hotspot",
-             config.wifi_force_no_link_but_hotspot);
-  write_bool("wifi_local_network_enable", config.wifi_local_network_enable);
-  write_string("wifi_local_network_ssid", config.wifi_local_network_ssid);
-  write_string("wifi_local_network_password", config.wifi_local_network_password);
-  write_string("nw_ethernet_card", config.nw_ethernet_card);
-  write_string("nw_manual_forwarding_ips", config.nw_manual_forwarding_ips);
-  write_bool("nw_forward_to_localhost_58xx",
-             config.nw_forward_to_localhost_58xx);
-  write_string("ground_unit_ip", config.ground_unit_ip);
-  write_string("air_unit_ip", config.air_unit_ip);
-  write_int("video_port", config.video_port);
-  write_int("telemetry_port", config.telemetry_port);
-  write_bool("disable_microhard_detection", config.disable_microhard_detection);
-  write_bool("force_microhard", config.force_microhard);
-  write_string("microhard_username", config.microhard_username);
-  write_string("microhard_password", config.microhard_password);
-  write_string("microhard_ip_air", config.microhard_ip_air);
-  write_string("microhard_ip_ground", config.microhard_ip_ground);
-  write_string("microhard_ip_range", config.microhard_ip_range);
-  write_int("microhard_video_port", config.microhard_video_port);
-  write_int("microhard_telemetry_port", config.microhard_telemetry_port);
-  write_bool("gen_enable_last_known_position",
-             config.gen_enable_last_known_position);
-  write_int("gen_rf_metrics_level", config.gen_rf_metrics_level);
-  write_bool("disable_openhd_service", config.disable_openhd_service);
+  }
+  content += "\n}\n";
 
-  file << "\n}\n";
-  return static_cast<bool>(file);
+  std::lock_guard<std::mutex> lock(g_config_file_mutex);
+  if (!schedule_file_write(kConfigPath, std::move(content))) {
+    std::atomic_store(&g_cached_config, std::shared_ptr<const CachedConfig>());
+    return false;
+  }
+  auto entry = std::make_shared<CachedConfig>();
+  entry->result = ConfigLoadResult::Loaded;
+  entry->config = config;
+  entry->stamp = stat_config_file();
+  (void)publish_locked(std::move(entry));
+  return true;
 }
 
 // Removes the config file, if it exists.
 bool remove_sysutil_config() {
+  std::lock_guard<std::mutex> lock(g_config_file_mutex);
   std::error_code ec;
   if (!std::filesystem::exists(kConfigPath, ec)) {
     return true;
   }
+  discard_file_write(kConfigPath);
+  std::atomic_store(&g_cached_config, std::shared_ptr<const CachedConfig>());
   return std::filesystem::remove(kConfigPath, ec);
 }
 
+// Watches the config directory; the file itself is replaced or recreated by
+// external tools, which would drop a watch placed on the file.
+int open_sysutil_config_watch() {
+  if (g_watch_fd >= 0) {
+    return g_watch_fd;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(kConfigDir, ec);
+  const int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  constexpr std::uint32_t kMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                  IN_CREATE | IN_DELETE | IN_DELETE_SELF |
+                                  IN_MOVE_SELF;
+  if (::inotify_add_watch(fd, kConfigDir, kMask) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  g_watch_fd = fd;
+  // Changes made before the watch existed would go unnoticed otherwise.
+  std::atomic_store(&g_cached_config, std::shared_ptr<const CachedConfig>());
+  g_watch_active.store(true, std::memory_order_release);
+  return fd;
+}
+
+// Drains pending inotify events and drops the snapshot when the file changed
+// behind our back. Events caused by our own writes leave the file in the
+// state the persistence layer recorded and are ignored.
+void handle_sysutil_config_watch() {
+  if (g_watch_fd < 0) {
+    return;
+  }
+  alignas(struct inotify_event) char buffer[4096];
+  bool touched = false;
+  bool watch_lost = false;
+  while (true) {
+    const ssize_t count = ::read(g_watch_fd, buffer, sizeof(buffer));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    for (ssize_t offset = 0; offset < count;) {
+      const auto* event =
+          reinterpret_cast<const struct inotify_event*>(buffer + offset);
+      if (event->mask & IN_Q_OVERFLOW) {
+        touched = true;
+      }
+      if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+        watch_lost = true;
+      }
+      if (event->len > 0 && std::strcmp(event->name, kConfigFileName) == 0) {
+        touched = true;
+      }
+      offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+    }
+  }
+
+  if (watch_lost) {
+    // The directory went away; fall back to stamp checks on every read.
+    g_watch_active.store(false, std::memory_order_release);
+    touched = true;
+  }
+  if (!touched) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(g_config_file_mutex);
+  const auto cached = std::atomic_load(&g_cached_config);
+  if (persisted_file_is_current(kConfigPath) ||
+      (cached && cached->stamp == stat_config_file())) {
+    return;
+  }
+  std::atomic_store(&g_cached_config, std::shared_ptr<const CachedConfig>());
+}
+
+// Stops the watch; readers fall back to stamp checks.
+void close_sysutil_config_watch() {
+  g_watch_active.store(false, std::memory_order_release);
+  if (g_watch_fd >= 0) {
+    ::close(g_watch_fd);
+    g_watch_fd = -1;
+  }
+}
+
 }  // namespace sysutil
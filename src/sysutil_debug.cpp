@@ -23,13 +23,16 @@
 
 #include "sysutil_debug.h"
 
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <optional>
-#include <sstream>
 #include <cstdlib>
 
 #include "sysutil_config.h"
+#include "sysutil_dispatch.h"
+#include "sysutil_events.h"
+#include "sysutil_persist.h"
 #include "sysutil_protocol.h"
 
 namespace sysutil {
@@ -43,8 +46,27 @@ constexpr const char* kDebugFilePaths[] = {
 // Persistent OpenHD debug marker for log verbosity.
 constexpr const char* kOpenhdDebugMarker = "/usr/local/share/openhd/debug.txt";
 
-// Cached debug state for this process.
-std::optional<bool> g_debug_enabled;
+// Cached debug state for this process. Atomic because debug updates run on
+// worker threads while debug requests are answered on the socket thread.
+std::atomic<bool> g_debug_initialized{false};
+std::atomic<bool> g_debug_enabled{false};
+
+// Updates the cached debug state and notifies subscribers on a change.
+void store_debug_state(bool enabled) {
+  g_debug_initialized = true;
+  if (g_debug_enabled.exchange(enabled) == enabled) {
+    return;
+  }
+  publish_event(EventTopic::Debug, [enabled] {
+    JsonWriter out;
+    out.begin_object()
+        .field("type", "sysutil.debug.event")
+        .field("debug", enabled)
+        .end_object()
+        .end_line();
+    return out.take();
+  });
+}
 
 // Checks for the presence of a file.
 bool file_exists(const std::string& path) {
@@ -98,17 +120,18 @@ void restart_openhd_services_if_needed() {
 
 // Initializes debug state from config and debug.txt triggers.
 void init_debug_info() {
-  if (g_debug_enabled.has_value()) {
+  if (g_debug_initialized) {
     return;
   }
 
-  SysutilConfig config;
-  const auto load_result = load_sysutil_config(config);
-  if (load_result == ConfigLoadResult::Loaded && config.debug_enabled) {
-    g_debug_enabled = *config.debug_enabled;
+  const auto snapshot = sysutil_config_snapshot();
+  const auto& debug_enabled = snapshot->config.debug_enabled;
+  if (snapshot->result == ConfigLoadResult::Loaded && debug_enabled) {
+    g_debug_enabled = *debug_enabled;
   } else {
     g_debug_enabled = false;
   }
+  g_debug_initialized = true;
 
   bool debug_marker_seen = false;
   for (const auto* path : kDebugFilePaths) {
@@ -138,61 +161,56 @@ void init_debug_info() {
 
 // Returns the cached debug state (initializing if needed).
 bool debug_enabled() {
-  if (!g_debug_enabled.has_value()) {
+  if (!g_debug_initialized) {
     init_debug_info();
   }
-  return g_debug_enabled.value_or(false);
-}
-
-// Checks whether the message is a debug request.
-bool is_debug_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.debug.request";
-}
-
-// Builds a JSON response that reports debug state.
-std::string build_debug_response() {
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.debug.response\",\"debug\":"
-      << (debug_enabled() ? "true" : "false") << "}\n";
-  return out.str();
+  return g_debug_enabled;
 }
 
-// Checks whether the message updates debug state.
-bool is_debug_update(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.debug.update";
+// Builds a JSON response that reports debug state and SD-card write counters.
+void build_debug_response(JsonWriter& out) {
+  const PersistStats persist = persist_stats();
+  out.begin_object()
+      .field("type", "sysutil.debug.response")
+      .field("debug", debug_enabled())
+      .begin_object("persist")
+      .field("bytes_written", persist.bytes_written)
+      .field("files_written", persist.files_written)
+      .field("writes_skipped", persist.writes_skipped)
+      .field("writes_coalesced", persist.writes_coalesced)
+      .end_object()
+      .end_object()
+      .end_line();
 }
 
-// Applies a debug update and returns a response payload.
-std::string handle_debug_update(const std::string& line) {
-  auto requested = extract_bool_field(line, "debug");
+// Applies a debug update and writes the response payload.
+void handle_debug_update(const ParsedMessage& request, JsonWriter& out) {
+  out.begin_object().field("type", "sysutil.debug.update.response");
+  auto requested = request.get_bool("debug");
   if (!requested.has_value()) {
-    requested = extract_bool_field(line, "debug_enabled");
+    requested = request.get_bool("debug_enabled");
   }
   if (!requested.has_value()) {
-    return "{\"type\":\"sysutil.debug.update.response\",\"ok\":false}\n";
+    out.field("ok", false).end_object().end_line();
+    return;
   }
 
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
   if (load_result == ConfigLoadResult::Error) {
-    return "{\"type\":\"sysutil.debug.update.response\",\"ok\":false}\n";
+    out.field("ok", false).end_object().end_line();
+    return;
   }
 
   config.debug_enabled = *requested;
   const bool ok = write_sysutil_config(config);
   if (ok) {
-    g_debug_enabled = *requested;
+    store_debug_state(*requested);
     (void)apply_openhd_debug_marker(requested,
                                     !config.disable_openhd_service.value_or(false));
   }
 
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.debug.update.response\",\"ok\":"
-      << (ok ? "true" : "false")
-      << ",\"debug\":" << (*requested ? "true" : "false") << "}\n";
-  return out.str();
+  out.field("ok", ok).field("debug", *requested).end_object().end_line();
 }
 
 bool apply_openhd_debug_marker(const std::optional<bool>& enabled,
@@ -207,11 +225,29 @@ bool apply_openhd_debug_marker(const std::optional<bool>& enabled,
   } else {
     ok = remove_file(kOpenhdDebugMarker);
   }
-  g_debug_enabled = want_debug;
+  store_debug_state(want_debug);
   if (restart_services) {
     restart_openhd_services_if_needed();
   }
   return ok;
 }
 
+// Registers the debug request handlers with the dispatcher.
+void register_debug_handlers() {
+  // The counters only grow, so their sum changes whenever any of them does.
+  register_cached_request_handler(
+      "sysutil.debug.request",
+      [](const ParsedMessage&, JsonWriter& out) {
+        build_debug_response(out);
+      },
+      [] {
+        const PersistStats persist = persist_stats();
+        const std::uint64_t writes = persist.files_written +
+                                     persist.writes_skipped +
+                                     persist.writes_coalesced;
+        return writes * 2 + (debug_enabled() ? 1 : 0);
+      });
+  register_request_handler("sysutil.debug.update", handle_debug_update, "config");
+}
+
 }  // namespace sysutil
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#include "sysutil_dispatch.h"
+
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace sysutil {
+namespace {
+
+// Handler storage. A deque keeps element addresses stable, so the index can
+// key on views into the stored type strings.
+std::deque<RequestHandlerInfo> g_handlers;
+std::unordered_map<std::string_view, const RequestHandlerInfo*> g_handler_index;
+
+// Last response line of a cached handler, without the request id.
+struct CachedLine {
+  bool valid = false;
+  std::uint64_t generation = 0;
+  std::string line;
+};
+
+// One cached line per wire encoding.
+struct CachedResponse {
+  std::mutex mutex;
+  CachedLine json;
+  CachedLine cbor;
+
+  CachedLine& line_for(Encoding encoding) {
+    return encoding == Encoding::Cbor ? cbor : json;
+  }
+};
+
+// True when the request carries nothing that could change the response.
+bool is_plain_request(const ParsedMessage& request) {
+  for (std::size_t i = 0; i < request.size(); ++i) {
+    const auto key = request.key_at(i);
+    if (key != "type" && key != "id") {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool register_request_handler(const std::string& type, RequestHandler handler,
+                              const std::string& lane) {
+  if (type.empty() || !handler) {
+    return false;
+  }
+  if (g_handler_index.count(type) != 0) {
+    std::cerr << "[sysutils] duplicate request handler for " << type
+              << std::endl;
+    return false;
+  }
+  g_handlers.push_back(RequestHandlerInfo{type, std::move(handler), lane});
+  const auto& info = g_handlers.back();
+  g_handler_index.emplace(info.type, &info);
+  return true;
+}
+
+bool register_cached_request_handler(const std::string& type,
+                                     RequestHandler handler,
+                                     ResponseGeneration generation,
+                                     const std::string& lane) {
+  if (!handler || !generation) {
+    return false;
+  }
+  auto cache = std::make_shared<CachedResponse>();
+  RequestHandler cached = [handler = std::move(handler),
+                           generation = std::move(generation),
+                           cache](const ParsedMessage& request,
+                                  JsonWriter& response) {
+    if (!is_plain_request(request)) {
+      handler(request, response);
+      return;
+    }
+    // Sampled before building, so a change made meanwhile still misses next
+    // time.
+    const std::uint64_t current = generation();
+    {
+      std::lock_guard<std::mutex> lock(cache->mutex);
+      const CachedLine& entry = cache->line_for(response.encoding());
+      if (entry.valid && entry.generation == current) {
+        response.line_raw(entry.line);
+        return;
+      }
+    }
+    JsonWriter fresh;
+    fresh.set_encoding(response.encoding());
+    handler(request, fresh);
+    std::string line = fresh.take();
+    response.line_raw(line);
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    CachedLine& entry = cache->line_for(response.encoding());
+    entry.valid = true;
+    entry.generation = current;
+    entry.line = std::move(line);
+  };
+  return register_request_handler(type, std::move(cached), lane);
+}
+
+void run_request_handler(const RequestHandlerInfo& info,
+                         const ParsedMessage& request, JsonWriter& response) {
+  std::string failure;
+  try {
+    info.handler(request, response);
+    return;
+  } catch (const std::exception& ex) {
+    failure = ex.what();
+  } catch (...) {
+    failure = "unknown exception";
+  }
+  std::cerr << "[sysutils] " << info.type << " handler failed: " << failure
+            << std::endl;
+  response.reset();
+  if (const auto id = request.get_raw_scalar("id")) {
+    response.lead_with("id", *id);
+  }
+  build_error_response(response, info.type + " failed: " + failure);
+}
+
+void build_error_response(JsonWriter& out, std::string_view message) {
+  out.begin_object()
+      .field("type", "sysutil.error")
+      .field("ok", false)
+      .field("message", message)
+      .end_object()
+      .end_line();
+}
+
+const RequestHandlerInfo* find_request_handler(std::string_view type) {
+  auto it = g_handler_index.find(type);
+  if (it == g_handler_index.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+const std::deque<RequestHandlerInfo>& request_handlers() {
+  return g_handlers;
+}
+
+}  // namespace sysutil
@@ -0,0 +1,85 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#include "sysutil_events.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace sysutil {
+namespace {
+
+constexpr std::array<const char*, kEventTopicCount> kTopicNames = {
+    "status", "wifi", "update", "partitions", "debug",
+};
+
+std::array<std::atomic<int>, kEventTopicCount> g_subscribers{};
+std::mutex g_sink_mutex;
+EventSink g_sink;
+
+std::size_t topic_index(EventTopic topic) {
+  return static_cast<std::size_t>(topic);
+}
+
+}  // namespace
+
+const char* event_topic_name(EventTopic topic) {
+  return kTopicNames[topic_index(topic)];
+}
+
+std::optional<EventTopic> parse_event_topic(std::string_view name) {
+  for (std::size_t i = 0; i < kTopicNames.size(); ++i) {
+    if (name == kTopicNames[i]) {
+      return static_cast<EventTopic>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+void set_event_sink(EventSink sink) {
+  std::lock_guard<std::mutex> lock(g_sink_mutex);
+  g_sink = std::move(sink);
+}
+
+void add_event_subscriber(EventTopic topic) {
+  ++g_subscribers[topic_index(topic)];
+}
+
+void remove_event_subscriber(EventTopic topic) {
+  --g_subscribers[topic_index(topic)];
+}
+
+bool has_event_subscribers(EventTopic topic) {
+  return g_subscribers[topic_index(topic)].load(std::memory_order_relaxed) > 0;
+}
+
+void deliver_event(EventTopic topic, std::string payload) {
+  std::lock_guard<std::mutex> lock(g_sink_mutex);
+  if (g_sink) {
+    g_sink(topic, std::move(payload));
+  }
+}
+
+}  // namespace sysutil
@@ -29,6 +29,7 @@
 #include "sysutil_camera.h"
 #include "sysutil_config.h"
 #include "sysutil_part.h"
+#include "sysutil_persist.h"
 #include "sysutil_platform.h"
 #include "sysutil_settings.h"
 #include "sysutil_status.h"
@@ -123,6 +124,7 @@ void run_firstboot_tasks() {
   if (needs_reboot) {
     set_status("reboot", "Reboot initiated",
                "Rebooting after first boot tasks.");
+    (void)flush_persisted_files();
     std::system("reboot");
   }
 }
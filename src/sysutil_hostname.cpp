@@ -81,11 +81,11 @@ void persist_hostname(const std::string& hostname) {
 }  // namespace
 
 void apply_hostname_if_enabled() {
-  SysutilConfig config;
-  const auto load_result = load_sysutil_config(config);
-  if (load_result == ConfigLoadResult::Error) {
+  const auto snapshot = sysutil_config_snapshot();
+  if (snapshot->result == ConfigLoadResult::Error) {
     return;
   }
+  const SysutilConfig& config = snapshot->config;
   if (!config.set_hostname.value_or(false)) {
     return;
   }
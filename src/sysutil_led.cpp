@@ -32,6 +32,7 @@
 #include <fstream>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -67,6 +68,12 @@ struct LedPattern {
   int on_ms = 100;
   int off_ms = 100;
   int repeat_count = -1;
+
+  bool operator==(const LedPattern& other) const {
+    return type == other.type && target == other.target &&
+           on_ms == other.on_ms && off_ms == other.off_ms &&
+           repeat_count == other.repeat_count;
+  }
 };
 
 struct LedDevice {
@@ -87,6 +94,8 @@ std::thread g_worker;
 std::mutex g_pattern_mutex;
 LedPattern g_current_pattern{};
 int g_pattern_id = 0;
+// Id of the last finite pattern the worker played to the end.
+int g_finished_pattern_id = -1;
 
 std::string to_lower(std::string value) {
   std::transform(value.begin(), value.end(), value.begin(),
@@ -94,16 +103,6 @@ std::string to_lower(std::string value) {
   return value;
 }
 
-bool contains_any_token(const std::string& haystack_lower,
-                        const std::vector<std::string>& needles_lower) {
-  for (const auto& needle : needles_lower) {
-    if (!needle.empty() && haystack_lower.find(needle) != std::string::npos) {
-      return true;
-    }
-  }
-  return false;
-}
-
 int find_led_by_name(const LedLayout& layout,
                      const std::vector<std::string>& preferred_names) {
   for (const auto& preferred : preferred_names) {
@@ -129,18 +128,13 @@ int find_led_by_token(const LedLayout& layout,
   return -1;
 }
 
-std::string build_status_text_lower(const StatusSnapshot& status) {
-  std::string combined;
-  combined.reserve(status.state.size() + status.description.size() +
-                   status.message.size() + status.type.size() + 8);
-  combined += status.state;
-  combined.push_back(' ');
-  combined += status.description;
-  combined.push_back(' ');
-  combined += status.message;
-  combined.push_back(' ');
-  combined += status.type;
-  return to_lower(combined);
+// Case-insensitive substring search without a lowercase copy; needle must
+// be lowercase.
+bool contains_lower(std::string_view haystack, std::string_view needle) {
+  return std::search(haystack.begin(), haystack.end(), needle.begin(),
+                     needle.end(), [](char a, char b) {
+                       return std::tolower(static_cast<unsigned char>(a)) == b;
+                     }) != haystack.end();
 }
 
 enum class ErrorKind {
@@ -149,26 +143,41 @@ enum class ErrorKind {
   Other
 };
 
+constexpr std::string_view kWifiCardMissingTokens[] = {
+    "no openhd wifibroadcast card found",
+    "no openhd-compatible card found",
+    "no wifi cards detected",
+    "no wi-fi cards detected",
+    "openhd-compatible card not found"};
+
+constexpr std::string_view kCameraMissingTokens[] = {
+    "no physical camera detected",
+    "no camera detected",
+    "camera not found",
+    "camera setup failed",
+    "dummy camera configuration",
+    "unable to apply camera configuration"};
+
+template <std::size_t N>
+bool status_mentions_any(const StatusSnapshot& status,
+                         const std::string_view (&tokens)[N]) {
+  for (const std::string_view text :
+       {std::string_view(status.state), std::string_view(status.description),
+        std::string_view(status.message), std::string_view(status.type)}) {
+    for (const auto token : tokens) {
+      if (contains_lower(text, token)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 ErrorKind classify_error_kind(const StatusSnapshot& status) {
-  const auto text = build_status_text_lower(status);
-  const std::vector<std::string> wifi_card_missing_tokens = {
-      "no openhd wifibroadcast card found",
-      "no openhd-compatible card found",
-      "no wifi cards detected",
-      "no wi-fi cards detected",
-      "openhd-compatible card not found"};
-  if (contains_any_token(text, wifi_card_missing_tokens)) {
+  if (status_mentions_any(status, kWifiCardMissingTokens)) {
     return ErrorKind::WifiCardMissing;
   }
-
-  const std::vector<std::string> camera_missing_tokens = {
-      "no physical camera detected",
-      "no camera detected",
-      "camera not found",
-      "camera setup failed",
-      "dummy camera configuration",
-      "unable to apply camera configuration"};
-  if (contains_any_token(text, camera_missing_tokens)) {
+  if (status_mentions_any(status, kCameraMissingTokens)) {
     return ErrorKind::CameraMissing;
   }
   return ErrorKind::Other;
@@ -320,71 +329,81 @@ LedLayout discover_leds() {
   return layout;
 }
 
-LedPattern select_pattern_from_status(const StatusSnapshot& status) {
-  // Distinct error frequencies:
-  // - Wi-Fi card missing: fast
-  // - Camera missing: medium
-  // - Other errors: slow
-  LedPattern wifi_missing_error_pattern{LedPatternType::Blink, LedTarget::Both,
-                                        120, 120, -1};
-  LedPattern camera_missing_error_pattern{LedPatternType::Blink, LedTarget::Both,
-                                          300, 300, -1};
-  LedPattern other_error_pattern{LedPatternType::Blink, LedTarget::Both, 700, 700,
-                                 -1};
-  LedPattern warn_pattern{LedPatternType::Blink, LedTarget::Secondary, 200, 200, -1};
-  LedPattern starting_pattern{LedPatternType::Blink, LedTarget::Primary, 200, 200, -1};
-  LedPattern ready_pattern{LedPatternType::Rainbow, LedTarget::Primary, 200, 200, -1};
-  LedPattern stopped_pattern{LedPatternType::Off, LedTarget::Both, 200, 200, -1};
-  LedPattern partition_pattern{LedPatternType::Blink, LedTarget::Both, 120, 120, -1};
-  LedPattern sysutils_started{LedPatternType::Blink, LedTarget::Both, 120, 120, 3};
-  LedPattern camera_setup{LedPatternType::Blink, LedTarget::Both, 120, 120, 4};
-  LedPattern reboot_initiated{LedPatternType::Blink, LedTarget::Both, 2000, 200, 1};
-  LedPattern updating_pattern{LedPatternType::Alternate, LedTarget::Both, 120, 120, -1};
+// Distinct error frequencies:
+// - Wi-Fi card missing: fast
+// - Camera missing: medium
+// - Other errors: slow
+constexpr LedPattern kWifiMissingErrorPattern{LedPatternType::Blink,
+                                              LedTarget::Both, 120, 120, -1};
+constexpr LedPattern kCameraMissingErrorPattern{LedPatternType::Blink,
+                                                LedTarget::Both, 300, 300, -1};
+constexpr LedPattern kOtherErrorPattern{LedPatternType::Blink, LedTarget::Both,
+                                        700, 700, -1};
+constexpr LedPattern kWarnPattern{LedPatternType::Blink, LedTarget::Secondary,
+                                  200, 200, -1};
+constexpr LedPattern kStartingPattern{LedPatternType::Blink, LedTarget::Primary,
+                                      200, 200, -1};
+constexpr LedPattern kReadyPattern{LedPatternType::Rainbow, LedTarget::Primary,
+                                   200, 200, -1};
+constexpr LedPattern kStoppedPattern{LedPatternType::Off, LedTarget::Both, 200,
+                                     200, -1};
+constexpr LedPattern kPartitionPattern{LedPatternType::Blink, LedTarget::Both,
+                                       120, 120, -1};
+constexpr LedPattern kSysutilsStartedPattern{LedPatternType::Blink,
+                                             LedTarget::Both, 120, 120, 3};
+constexpr LedPattern kCameraSetupPattern{LedPatternType::Blink, LedTarget::Both,
+                                         120, 120, 4};
+constexpr LedPattern kRebootPattern{LedPatternType::Blink, LedTarget::Both, 2000,
+                                    200, 1};
+constexpr LedPattern kUpdatingPattern{LedPatternType::Alternate,
+                                      LedTarget::Both, 120, 120, -1};
+
+struct StateRule {
+  std::string_view key;
+  LedPattern pattern;
+};
+
+// The first rule whose key occurs in the (case-insensitive) state wins.
+constexpr StateRule kStateRules[] = {
+    {"partition", kPartitionPattern},
+    {"update", kUpdatingPattern},
+    {"sysutils.started", kSysutilsStartedPattern},
+    {"camera_setup", kCameraSetupPattern},
+    {"reboot", kRebootPattern},
+    {"starting", kStartingPattern},
+    {"boot", kStartingPattern},
+    {"ready", kReadyPattern},
+    {"link_lost", kWarnPattern},
+    {"error", kOtherErrorPattern},
+    {"stopped", kStoppedPattern},
+};
 
+LedPattern select_pattern_from_status(const StatusSnapshot& status) {
   if (!status.has_data) {
-    return stopped_pattern;
+    return kStoppedPattern;
   }
   if (status.has_error || status.severity >= 2) {
     switch (classify_error_kind(status)) {
       case ErrorKind::WifiCardMissing:
-        return wifi_missing_error_pattern;
+        return kWifiMissingErrorPattern;
       case ErrorKind::CameraMissing:
-        return camera_missing_error_pattern;
+        return kCameraMissingErrorPattern;
       case ErrorKind::Other:
       default:
-        return other_error_pattern;
+        return kOtherErrorPattern;
     }
   }
   if (status.severity == 1) {
-    return warn_pattern;
+    return kWarnPattern;
   }
 
-  const auto state = to_lower(status.state);
-  struct Rule {
-    const char* key;
-    LedPattern pattern;
-  };
-  const std::vector<Rule> rules = {
-      {"partition", partition_pattern},
-      {"update", updating_pattern},
-      {"sysutils.started", sysutils_started},
-      {"camera_setup", camera_setup},
-      {"reboot", reboot_initiated},
-      {"starting", starting_pattern},
-      {"boot", starting_pattern},
-      {"ready", ready_pattern},
-      {"link_lost", warn_pattern},
-      {"error", other_error_pattern},
-      {"stopped", stopped_pattern},
-  };
-
-  for (const auto& rule : rules) {
-    if (state.find(rule.key) != std::string::npos) {
+  for (const auto& rule : kStateRules) {
+    if (contains_lower(status.state, rule.key)) {
       return rule.pattern;
     }
   }
 
-  return ready_pattern;
+  return kReadyPattern;
 }
 
 #ifdef OPENHD_HAVE_X21_LED
@@ -511,6 +530,10 @@ void worker_loop() {
     }
     if (pattern.repeat_count > 0 && remaining > 0) {
       --remaining;
+      if (remaining == 0) {
+        std::lock_guard<std::mutex> lock(g_pattern_mutex);
+        g_finished_pattern_id = pattern_id;
+      }
     }
   }
 }
@@ -540,18 +563,33 @@ void init_leds() {
 
 void update_leds_from_status(const StatusSnapshot& status) {
 #ifdef OPENHD_HAVE_X21_LED
-  if (g_x21_fd >= 0) {
-    apply_x21_pattern(select_pattern_from_status(status));
-    return;
-  }
+  const bool x21 = g_x21_fd >= 0;
+#else
+  const bool x21 = false;
 #endif
-  if (g_layout.leds.empty()) {
+  if (!x21 && g_layout.leds.empty()) {
     return;
   }
   const auto next_pattern = select_pattern_from_status(status);
-  std::lock_guard<std::mutex> lock(g_pattern_mutex);
-  g_current_pattern = next_pattern;
-  ++g_pattern_id;
+  {
+    // A status that maps to the running pattern must not restart it. A
+    // finite pattern is replayed once it has finished; on X21 the helper
+    // plays it, so it is never known to be still running.
+    std::lock_guard<std::mutex> lock(g_pattern_mutex);
+    const bool running =
+        next_pattern.repeat_count <= 0 ||
+        (!x21 && g_finished_pattern_id != g_pattern_id);
+    if (g_pattern_id != 0 && g_current_pattern == next_pattern && running) {
+      return;
+    }
+    g_current_pattern = next_pattern;
+    ++g_pattern_id;
+  }
+#ifdef OPENHD_HAVE_X21_LED
+  if (x21) {
+    apply_x21_pattern(next_pattern);
+  }
+#endif
 }
 
 }  // namespace sysutil
@@ -23,8 +23,12 @@
 
 #include "sysutil_part.h"
 
-#include "sysutil_status.h"
 #include "sysutil_config.h"
+#include "sysutil_dispatch.h"
+#include "sysutil_events.h"
+#include "sysutil_persist.h"
+#include "sysutil_protocol.h"
+#include "sysutil_status.h"
 
 #include <algorithm>
 #include <cerrno>
@@ -87,34 +91,6 @@ std::string blkid_value(const std::string& device, const std::string& key) {
   return trim(*output);
 }
 
-std::string json_escape(const std::string& input) {
-  std::string out;
-  out.reserve(input.size());
-  for (char c : input) {
-    switch (c) {
-      case '\\':
-        out += "\\\\";
-        break;
-      case '"':
-        out += "\\\"";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
-        break;
-      case '\t':
-        out += "\\t";
-        break;
-      default:
-        out += c;
-        break;
-    }
-  }
-  return out;
-}
-
 long long parse_ll(const std::string& value) {
   if (value.empty()) {
     return 0;
@@ -822,30 +798,47 @@ bool resize_fat32_partition(const ResizeCandidate& candidate, bool reboot) {
 
   set_status("partitioning", "Complete", "Partition resize complete.");
   if (reboot) {
+    (void)flush_persisted_files();
     (void)run_shell_command("reboot");
   }
   return true;
 }
 
-std::string build_partitions_response() {
+// Writes the optional device details shared by segments and partitions.
+void append_part_details(JsonWriter& out, const LsblkRow& part) {
+  if (!part.mountpoint.empty()) {
+    out.field("mountpoint", part.mountpoint);
+  }
+  if (!part.fstype.empty()) {
+    out.field("fstype", part.fstype);
+  }
+  if (!part.label.empty()) {
+    out.field("label", part.label);
+  }
+}
+
+void append_free_segment(JsonWriter& out, long long start, long long size) {
+  out.begin_object()
+      .field("kind", "free")
+      .field("startBytes", start)
+      .field("sizeBytes", size)
+      .end_object();
+}
+
+// Formats the current partition map with the given message type.
+void format_partitions(JsonWriter& out, const char* type) {
   const auto result = read_lsblk_rows();
   const auto& rows = result.rows;
   const auto candidate = find_resize_candidate(result);
   long long recordings_free_bytes = 0;
   bool recordings_found = false;
   std::vector<std::string> recordings_files;
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.partitions.response\",\"disks\":[";
+  out.begin_object().field("type", type).begin_array("disks");
 
-  bool first_disk = true;
   for (const auto& disk : rows) {
     if (disk.type != "disk") {
       continue;
     }
-    if (!first_disk) {
-      out << ",";
-    }
-    first_disk = false;
 
     std::vector<LsblkRow> parts;
     for (const auto& row : rows) {
@@ -882,57 +875,35 @@ std::string build_partitions_response() {
 
     const long long disk_size =
         disk.size_bytes > 0 ? disk.size_bytes : 0;
-    out << "{\"name\":\"/dev/" << json_escape(disk.name) << "\""
-        << ",\"sizeBytes\":" << disk_size << ",\"segments\":[";
+    const std::string disk_device = "/dev/" + disk.name;
+    out.begin_object()
+        .field("name", disk_device)
+        .field("sizeBytes", disk_size)
+        .begin_array("segments");
 
     long long cursor = 0;
-    bool first_segment = true;
     for (const auto& part : parts) {
       if (part.start_bytes > cursor) {
-        if (!first_segment) {
-          out << ",";
-        }
-        first_segment = false;
-        out << "{\"kind\":\"free\",\"startBytes\":" << cursor
-            << ",\"sizeBytes\":" << (part.start_bytes - cursor) << "}";
-      }
-
-      if (!first_segment) {
-        out << ",";
-      }
-      first_segment = false;
-      out << "{\"kind\":\"partition\",\"device\":\"/dev/"
-          << json_escape(part.name) << "\"";
-      if (!part.mountpoint.empty()) {
-        out << ",\"mountpoint\":\"" << json_escape(part.mountpoint) << "\"";
-      }
-      if (!part.fstype.empty()) {
-        out << ",\"fstype\":\"" << json_escape(part.fstype) << "\"";
+        append_free_segment(out, cursor, part.start_bytes - cursor);
       }
-      if (!part.label.empty()) {
-        out << ",\"label\":\"" << json_escape(part.label) << "\"";
-      }
-      out << ",\"startBytes\":" << part.start_bytes
-          << ",\"sizeBytes\":" << part.size_bytes << "}";
+      const std::string part_device = "/dev/" + part.name;
+      out.begin_object()
+          .field("kind", "partition")
+          .field("device", part_device);
+      append_part_details(out, part);
+      out.field("startBytes", part.start_bytes)
+          .field("sizeBytes", part.size_bytes)
+          .end_object();
 
       cursor = part.start_bytes + part.size_bytes;
     }
 
     if (disk_size > cursor) {
-      if (!first_segment) {
-        out << ",";
-      }
-      out << "{\"kind\":\"free\",\"startBytes\":" << cursor
-          << ",\"sizeBytes\":" << (disk_size - cursor) << "}";
+      append_free_segment(out, cursor, disk_size - cursor);
     }
 
-    out << "],\"partitions\":[";
-    bool first_part = true;
+    out.end_array().begin_array("partitions");
     for (const auto& part : parts) {
-      if (!first_part) {
-        out << ",";
-      }
-      first_part = false;
       const std::string part_device = "/dev/" + part.name;
       long long free_bytes = 0;
       if (is_label(part.label, "recordings") ||
@@ -946,24 +917,18 @@ std::string build_partitions_response() {
         recordings_found = true;
       }
 
-      out << "{\"device\":\"/dev/" << json_escape(part.name) << "\"";
-      if (!part.mountpoint.empty()) {
-        out << ",\"mountpoint\":\"" << json_escape(part.mountpoint) << "\"";
-      }
-      if (!part.fstype.empty()) {
-        out << ",\"fstype\":\"" << json_escape(part.fstype) << "\"";
-      }
-      if (!part.label.empty()) {
-        out << ",\"label\":\"" << json_escape(part.label) << "\"";
-      }
+      out.begin_object().field("device", part_device);
+      append_part_details(out, part);
       if (free_bytes > 0) {
-        out << ",\"freeBytes\":" << free_bytes;
+        out.field("freeBytes", free_bytes);
       }
-      out << ",\"startBytes\":" << part.start_bytes
-          << ",\"sizeBytes\":" << part.size_bytes << "}";
+      out.field("startBytes", part.start_bytes)
+          .field("sizeBytes", part.size_bytes)
+          .end_object();
     }
-    out << "]}";
+    out.end_array().end_object();
   }
+  out.end_array();
 
   if (!recordings_found && is_mountpoint("/Video")) {
     recordings_free_bytes = filesystem_free_bytes("/Video");
@@ -971,57 +936,78 @@ std::string build_partitions_response() {
     recordings_found = true;
   }
 
-  out << "],\"recordings\":";
   if (recordings_found) {
-    out << "{\"freeBytes\":" << recordings_free_bytes << ",\"files\":[";
-    for (std::size_t i = 0; i < recordings_files.size(); ++i) {
-      if (i > 0) {
-        out << ",";
-      }
-      out << "\"" << json_escape(recordings_files[i]) << "\"";
+    out.begin_object("recordings")
+        .field("freeBytes", recordings_free_bytes)
+        .begin_array("files");
+    for (const auto& file : recordings_files) {
+      out.value(file);
     }
-    out << "]}";
+    out.end_array().end_object();
   } else {
-    out << "null";
+    out.field_null("recordings");
   }
-  out << ",\"resizable\":";
   if (candidate) {
-    out << "{\"device\":\"" << json_escape(candidate->device) << "\"";
+    out.begin_object("resizable").field("device", candidate->device);
     if (!candidate->label.empty()) {
-      out << ",\"label\":\"" << json_escape(candidate->label) << "\"";
+      out.field("label", candidate->label);
     }
     if (!candidate->fstype.empty()) {
-      out << ",\"fstype\":\"" << json_escape(candidate->fstype) << "\"";
+      out.field("fstype", candidate->fstype);
     }
-    out << ",\"freeBytes\":" << candidate->free_after << "}";
+    out.field("freeBytes", candidate->free_after).end_object();
   } else {
-    out << "null";
+    out.field_null("resizable");
   }
-  out << "}\n";
-  return out.str();
+  out.end_object().end_line();
+}
+
+void build_partitions_response(JsonWriter& out) {
+  format_partitions(out, "sysutil.partitions.response");
+}
+
+// Pushes the partition map to subscribers after it may have changed.
+void publish_partitions_event() {
+  publish_event(EventTopic::Partitions, [] {
+    JsonWriter out;
+    format_partitions(out, "sysutil.partitions.event");
+    return out.take();
+  });
 }
 
-std::string handle_partition_resize_request(const std::string& choice) {
+void handle_partition_resize_request(const std::string& choice,
+                                     JsonWriter& out) {
   const bool wants_resize = (choice == "yes" || choice == "true" ||
                              choice == "1");
-  SysutilConfig config;
-  if (load_sysutil_config(config) == ConfigLoadResult::Loaded &&
+  auto respond = [&out](bool accepted) {
+    out.begin_object()
+        .field("type", "sysutil.partition.resize.response")
+        .field("accepted", accepted)
+        .end_object()
+        .end_line();
+  };
+  const auto snapshot = sysutil_config_snapshot();
+  const SysutilConfig& config = snapshot->config;
+  if (snapshot->result == ConfigLoadResult::Loaded &&
       config.firstboot.has_value() && !config.firstboot.value()) {
     set_status("partitioning", "Resize skipped",
                "Partitioning is only available on first boot.");
-    return "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":false}\n";
+    respond(false);
+    return;
   }
   const auto candidate = find_resize_candidate(read_lsblk_rows());
   if (!candidate) {
     set_status("partitioning", "Not resizable",
                "No FAT32 partition with free space.");
-    return "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":false}\n";
+    respond(false);
+    return;
   }
 
   if (!wants_resize) {
     set_status("partitioning", "Resize skipped",
                "Partitioning was not requested.");
-    return "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":true}\n";
+    respond(true);
+    return;
   }
 
   set_status("partitioning", "Resize requested",
@@ -1029,10 +1015,31 @@ std::string handle_partition_resize_request(const std::string& choice) {
   if (!resize_fat32_partition(*candidate, true)) {
     set_status("partitioning", "Resize failed",
                "Partition resize did not complete.");
-    return "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":false}\n";
+    publish_partitions_event();
+    respond(false);
+    return;
   }
 
-  return "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":true}\n";
+  publish_partitions_event();
+  respond(true);
+}
+
+// Registers the partition request handlers with the dispatcher.
+void register_part_handlers() {
+  // lsblk, blkid and mount calls can take seconds, so both run on a worker.
+  register_request_handler(
+      "sysutil.partitions.request",
+      [](const ParsedMessage&, JsonWriter& out) {
+        build_partitions_response(out);
+      },
+      "storage");
+  register_request_handler(
+      "sysutil.partition.resize.request",
+      [](const ParsedMessage& request, JsonWriter& out) {
+        const auto choice = request.get_string("choice").value_or("no");
+        handle_partition_resize_request(choice, out);
+      },
+      "storage");
 }
 
 }  // namespace sysutil
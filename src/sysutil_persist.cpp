@@ -0,0 +1,323 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_persist.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace sysutil {
+namespace {
+
+// Settings updates tend to arrive in bursts; one rewrite per burst is enough.
+constexpr std::chrono::milliseconds kCoalesceWindow{250};
+
+// Last version of a file written (or verified) by this layer.
+struct WrittenFile {
+  FileStamp stamp;
+  std::string content;
+};
+
+// Guards the queue, the in-flight batch and g_written. Never held during
+// disk I/O.
+std::mutex g_persist_mutex;
+std::condition_variable g_persist_cv;
+std::unordered_map<std::string, std::string> g_pending;
+// Batch currently being written; still visible to read_persisted_file().
+std::unordered_map<std::string, std::string> g_in_flight;
+std::unordered_map<std::string, WrittenFile> g_written;
+std::chrono::steady_clock::time_point g_flush_deadline;
+std::thread g_persist_thread;
+bool g_persist_running = false;
+
+// Serializes disk writes so batches land in the order they were taken.
+std::mutex g_io_mutex;
+
+std::atomic<std::uint64_t> g_bytes_written{0};
+std::atomic<std::uint64_t> g_files_written{0};
+std::atomic<std::uint64_t> g_writes_skipped{0};
+std::atomic<std::uint64_t> g_writes_coalesced{0};
+
+bool read_file(const std::string& path, std::string& content) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  content = buffer.str();
+  return true;
+}
+
+bool write_all(int fd, std::string_view content) {
+  while (!content.empty()) {
+    const ssize_t count = ::write(fd, content.data(), content.size());
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    content.remove_prefix(static_cast<std::size_t>(count));
+  }
+  return true;
+}
+
+void fsync_directory(const std::filesystem::path& directory) {
+  const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  (void)::fsync(fd);
+  ::close(fd);
+}
+
+// True when path already holds content, so the write can be skipped. Trusts
+// the remembered content while the file is unchanged since our last write and
+// compares against the disk otherwise.
+bool file_matches(const std::string& path, std::string_view content,
+                  const FileStamp& current) {
+  {
+    std::lock_guard<std::mutex> lock(g_persist_mutex);
+    auto it = g_written.find(path);
+    if (it != g_written.end() && it->second.stamp == current) {
+      return it->second.content == content;
+    }
+  }
+  if (!current.exists || current.size != static_cast<off_t>(content.size())) {
+    return false;
+  }
+  std::string on_disk;
+  if (!read_file(path, on_disk) || on_disk != content) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(g_persist_mutex);
+  g_written[path] = WrittenFile{current, std::move(on_disk)};
+  return true;
+}
+
+// Caller holds g_io_mutex.
+bool write_file_locked(const std::string& path, std::string_view content) {
+  if (file_matches(path, content, stat_file_stamp(path))) {
+    ++g_writes_skipped;
+    return true;
+  }
+
+  const std::filesystem::path target(path);
+  std::error_code ec;
+  std::filesystem::create_directories(target.parent_path(), ec);
+  if (ec) {
+    std::cerr << "[sysutils][persist] cannot create " << target.parent_path()
+              << ": " << ec.message() << std::endl;
+    return false;
+  }
+
+  const std::string temp_path = path + ".tmp";
+  const int fd = ::open(temp_path.c_str(),
+                        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "[sysutils][persist] cannot open " << temp_path << ": "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+  bool ok = write_all(fd, content) && ::fsync(fd) == 0;
+  ok = ::close(fd) == 0 && ok;
+  if (ok && ::rename(temp_path.c_str(), path.c_str()) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    std::cerr << "[sysutils][persist] failed to write " << path << ": "
+              << std::strerror(errno) << std::endl;
+    (void)::unlink(temp_path.c_str());
+    return false;
+  }
+  fsync_directory(target.parent_path());
+
+  g_bytes_written += content.size();
+  ++g_files_written;
+  std::lock_guard<std::mutex> lock(g_persist_mutex);
+  g_written[path] = WrittenFile{stat_file_stamp(path), std::string(content)};
+  return true;
+}
+
+// Takes the queued batch and writes it. The batch is taken under g_io_mutex,
+// so a newer batch can never be overtaken by an older one.
+bool write_pending_files() {
+  std::lock_guard<std::mutex> io_lock(g_io_mutex);
+  {
+    std::lock_guard<std::mutex> lock(g_persist_mutex);
+    if (g_pending.empty()) {
+      return true;
+    }
+    g_in_flight = std::move(g_pending);
+    g_pending.clear();
+  }
+  bool ok = true;
+  for (const auto& entry : g_in_flight) {
+    ok = write_file_locked(entry.first, entry.second) && ok;
+  }
+  std::lock_guard<std::mutex> lock(g_persist_mutex);
+  g_in_flight.clear();
+  return ok;
+}
+
+void persist_loop() {
+  std::unique_lock<std::mutex> lock(g_persist_mutex);
+  while (true) {
+    if (g_pending.empty()) {
+      if (!g_persist_running) {
+        return;
+      }
+      g_persist_cv.wait(lock);
+      continue;
+    }
+    if (g_persist_running &&
+        std::chrono::steady_clock::now() < g_flush_deadline) {
+      g_persist_cv.wait_until(lock, g_flush_deadline);
+      continue;
+    }
+    lock.unlock();
+    (void)write_pending_files();
+    lock.lock();
+  }
+}
+
+}  // namespace
+
+FileStamp stat_file_stamp(const std::string& path) {
+  FileStamp stamp;
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0) {
+    return stamp;
+  }
+  stamp.exists = true;
+  stamp.device = st.st_dev;
+  stamp.inode = st.st_ino;
+  stamp.size = st.st_size;
+  stamp.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                   st.st_mtim.tv_nsec;
+  return stamp;
+}
+
+bool write_file_atomic(const std::string& path, std::string_view content) {
+  std::lock_guard<std::mutex> io_lock(g_io_mutex);
+  return write_file_locked(path, content);
+}
+
+bool schedule_file_write(const std::string& path, std::string content) {
+  {
+    std::lock_guard<std::mutex> lock(g_persist_mutex);
+    if (g_persist_running) {
+      if (g_pending.empty()) {
+        g_flush_deadline = std::chrono::steady_clock::now() + kCoalesceWindow;
+      }
+      if (!g_pending.insert_or_assign(path, std::move(content)).second) {
+        ++g_writes_coalesced;
+      }
+      g_persist_cv.notify_one();
+      return true;
+    }
+  }
+  return write_file_atomic(path, content);
+}
+
+void discard_file_write(const std::string& path) {
+  // Holding the I/O lock waits out a batch that may contain path.
+  std::lock_guard<std::mutex> io_lock(g_io_mutex);
+  std::lock_guard<std::mutex> lock(g_persist_mutex);
+  g_pending.erase(path);
+  g_written.erase(path);
+}
+
+bool read_persisted_file(const std::string& path, std::string& content) {
+  {
+    std::lock_guard<std::mutex> lock(g_persist_mutex);
+    auto it = g_pending.find(path);
+    if (it != g_pending.end()) {
+      content = it->second;
+      return true;
+    }
+    it = g_in_flight.find(path);
+    if (it != g_in_flight.end()) {
+      content = it->second;
+      return true;
+    }
+  }
+  return read_file(path, content);
+}
+
+bool persisted_file_is_current(const std::string& path) {
+  const FileStamp current = stat_file_stamp(path);
+  std::lock_guard<std::mutex> lock(g_persist_mutex);
+  auto it = g_written.find(path);
+  return it != g_written.end() && it->second.stamp == current;
+}
+
+bool flush_persisted_files() { return write_pending_files(); }
+
+void start_persist_worker() {
+  std::lock_guard<std::mutex> lock(g_persist_mutex);
+  if (g_persist_running) {
+    return;
+  }
+  g_persist_running = true;
+  g_persist_thread = std::thread(persist_loop);
+}
+
+void stop_persist_worker() {
+  {
+    std::lock_guard<std::mutex> lock(g_persist_mutex);
+    if (!g_persist_running) {
+      return;
+    }
+    g_persist_running = false;
+  }
+  g_persist_cv.notify_all();
+  g_persist_thread.join();
+  (void)write_pending_files();
+}
+
+PersistStats persist_stats() {
+  PersistStats stats;
+  stats.bytes_written = g_bytes_written.load();
+  stats.files_written = g_files_written.load();
+  stats.writes_skipped = g_writes_skipped.load();
+  stats.writes_coalesced = g_writes_coalesced.load();
+  return stats;
+}
+
+}  // namespace sysutil
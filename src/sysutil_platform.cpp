@@ -24,26 +24,35 @@
 #include "sysutil_platform.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstdint>
 #include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <optional>
 #include <regex>
 #include <sstream>
 #include <unordered_map>
 
 #include "sysutil_config.h"
+#include "sysutil_dispatch.h"
 #include "sysutil_protocol.h"
+#include "sysutil_state_page.h"
 #include "platforms_generated.h"
 
 namespace sysutil {
 namespace {
 
-// Cached platform information for this process.
+// Cached platform information for this process. Guarded by the mutex because
+// worker threads read it while platform.update may replace it.
+std::mutex g_platform_mutex;
 PlatformInfo g_platform_info{};
 bool g_platform_initialized = false;
+// Bumped whenever g_platform_info is replaced.
+std::atomic<std::uint64_t> g_platform_generation{0};
 
 void log_platform(const std::string& message) {
   std::cerr << "[sysutils][platform] " << message << std::endl;
@@ -229,35 +238,6 @@ void write_platform_manifest(const PlatformInfo& info) {
   file << "OHDPlatform:[" << info.platform_name << "]";
 }
 
-// Escapes JSON payload content.
-std::string json_escape(const std::string& input) {
-  std::string out;
-  out.reserve(input.size());
-  for (char c : input) {
-    switch (c) {
-      case '\\':
-        out += "\\\\";
-        break;
-      case '"':
-        out += "\\\"";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
-        break;
-      case '\t':
-        out += "\\t";
-        break;
-      default:
-        out += c;
-        break;
-    }
-  }
-  return out;
-}
-
 }  // namespace
 
 // Returns a freshly detected platform info snapshot.
@@ -270,27 +250,32 @@ PlatformInfo discover_platform_info() {
 
 // Initializes cached platform info from config or discovery.
 void init_platform_info() {
-  if (g_platform_initialized) {
-    return;
+  {
+    std::lock_guard<std::mutex> lock(g_platform_mutex);
+    if (g_platform_initialized) {
+      return;
+    }
   }
+  PlatformInfo info;
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
 
 #ifdef OPENHD_X20_PACKAGE_BUILD
-  g_platform_info.platform_type = X_PLATFORM_TYPE_ALWINNER_X20;
-  g_platform_info.platform_name =
-      platform_type_to_string(g_platform_info.platform_type);
+  info.platform_type = X_PLATFORM_TYPE_ALWINNER_X20;
+  info.platform_name = platform_type_to_string(info.platform_type);
   if (load_result != ConfigLoadResult::Error) {
-    config.platform_type = g_platform_info.platform_type;
-    config.platform_name = g_platform_info.platform_name;
+    config.platform_type = info.platform_type;
+    config.platform_name = info.platform_name;
     (void)write_sysutil_config(config);
   }
-  write_platform_manifest(g_platform_info);
-  log_platform("Active platform: type=" +
-               std::to_string(g_platform_info.platform_type) +
-               " name=" + g_platform_info.platform_name +
-               " source=x20-package");
+  write_platform_manifest(info);
+  log_platform("Active platform: type=" + std::to_string(info.platform_type) +
+               " name=" + info.platform_name + " source=x20-package");
+  std::lock_guard<std::mutex> lock(g_platform_mutex);
+  g_platform_info = info;
   g_platform_initialized = true;
+  ++g_platform_generation;
+  state_page_set_platform(info.platform_type);
   return;
 #endif
 
@@ -310,81 +295,84 @@ void init_platform_info() {
 
   if (load_result == ConfigLoadResult::Loaded && config.platform_type &&
       !cached_unknown_platform && !legacy_pi5_cache) {
-    g_platform_info.platform_type = *config.platform_type;
+    info.platform_type = *config.platform_type;
   } else {
-    g_platform_info.platform_type = discover_platform_type();
+    info.platform_type = discover_platform_type();
   }
 
   if (load_result == ConfigLoadResult::Loaded && config.platform_name &&
       !cached_unknown_platform && !legacy_pi5_cache) {
-    g_platform_info.platform_name = *config.platform_name;
+    info.platform_name = *config.platform_name;
   } else {
-    g_platform_info.platform_name =
-        platform_type_to_string(g_platform_info.platform_type);
+    info.platform_name =
+        platform_type_to_string(info.platform_type);
   }
 
   if ((!has_cached_platform || cached_unknown_platform || legacy_pi5_cache) &&
       load_result != ConfigLoadResult::Error) {
     SysutilConfig updated_config = config;
-    updated_config.platform_type = g_platform_info.platform_type;
-    updated_config.platform_name = g_platform_info.platform_name;
+    updated_config.platform_type = info.platform_type;
+    updated_config.platform_name = info.platform_name;
     (void)write_sysutil_config(updated_config);
   }
-  write_platform_manifest(g_platform_info);
-  log_platform("Active platform: type=" + std::to_string(g_platform_info.platform_type) +
-               " name=" + g_platform_info.platform_name +
+  write_platform_manifest(info);
+  log_platform("Active platform: type=" + std::to_string(info.platform_type) +
+               " name=" + info.platform_name +
                " source=" + (use_cached_platform ? std::string("config-cache")
                                                  : std::string("detected")));
+  std::lock_guard<std::mutex> lock(g_platform_mutex);
+  g_platform_info = info;
   g_platform_initialized = true;
+  ++g_platform_generation;
+  state_page_set_platform(info.platform_type);
 }
 
 // Returns cached platform info, initializing on first access.
-const PlatformInfo& platform_info() {
-  if (!g_platform_initialized) {
-    init_platform_info();
+PlatformInfo platform_info() {
+  {
+    std::lock_guard<std::mutex> lock(g_platform_mutex);
+    if (g_platform_initialized) {
+      return g_platform_info;
+    }
   }
+  init_platform_info();
+  std::lock_guard<std::mutex> lock(g_platform_mutex);
   return g_platform_info;
 }
 
-// Checks whether a request asks for platform info.
-bool is_platform_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.platform.request";
-}
-
 // Builds JSON response for platform requests.
-std::string build_platform_response() {
-  const auto& info = platform_info();
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.platform.response\",\"platform_type\":"
-      << info.platform_type << ",\"platform_name\":\""
-      << json_escape(info.platform_name) << "\"}\n";
-  return out.str();
-}
-
-// Checks whether a request asks to update or refresh platform info.
-bool is_platform_update_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.platform.update";
+void build_platform_response(JsonWriter& out) {
+  const auto info = platform_info();
+  out.begin_object()
+      .field("type", "sysutil.platform.response")
+      .field("platform_type", info.platform_type)
+      .field("platform_name", info.platform_name)
+      .end_object()
+      .end_line();
 }
 
 // Handles platform update requests (refresh detection or override).
-std::string handle_platform_update(const std::string& line) {
-  auto action = extract_string_field(line, "action").value_or("refresh");
+void handle_platform_update(const ParsedMessage& request, JsonWriter& out) {
+  auto action = request.get_string("action").value_or("refresh");
   log_platform("platform.update request action=" + action);
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
   if (load_result == ConfigLoadResult::Error) {
     log_platform("platform.update failed: cannot read sysutil config.");
-    return "{\"type\":\"sysutil.platform.update.response\",\"ok\":false}\n";
+    out.begin_object()
+        .field("type", "sysutil.platform.update.response")
+        .field("ok", false)
+        .end_object()
+        .end_line();
+    return;
   }
 
   bool ok = true;
   PlatformInfo info = platform_info();
 
   if (action == "set") {
-    auto platform_type = extract_int_field(line, "platform_type");
-    auto platform_name = extract_string_field(line, "platform_name");
+    auto platform_type = request.get_int("platform_type");
+    auto platform_name = request.get_string("platform_name");
     if (!platform_type.has_value()) {
       ok = false;
     } else {
@@ -420,24 +408,42 @@ std::string handle_platform_update(const std::string& line) {
 #endif
 
   if (ok) {
-    g_platform_info = info;
-    g_platform_initialized = true;
-    write_platform_manifest(g_platform_info);
+    {
+      std::lock_guard<std::mutex> lock(g_platform_mutex);
+      g_platform_info = info;
+      g_platform_initialized = true;
+      ++g_platform_generation;
+      state_page_set_platform(info.platform_type);
+    }
+    write_platform_manifest(info);
     log_platform("platform.update result: type=" +
-                 std::to_string(g_platform_info.platform_type) +
-                 " name=" + g_platform_info.platform_name +
+                 std::to_string(info.platform_type) +
+                 " name=" + info.platform_name +
                  " action=" + action);
   } else {
     log_platform("platform.update failed for action=" + action);
   }
 
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.platform.update.response\",\"ok\":"
-      << (ok ? "true" : "false")
-      << ",\"platform_type\":" << info.platform_type
-      << ",\"platform_name\":\"" << json_escape(info.platform_name)
-      << "\",\"action\":\"" << json_escape(action) << "\"}\n";
-  return out.str();
+  out.begin_object()
+      .field("type", "sysutil.platform.update.response")
+      .field("ok", ok)
+      .field("platform_type", info.platform_type)
+      .field("platform_name", info.platform_name)
+      .field("action", action)
+      .end_object()
+      .end_line();
+}
+
+// Registers the platform request handlers with the dispatcher.
+void register_platform_handlers() {
+  register_cached_request_handler(
+      "sysutil.platform.request",
+      [](const ParsedMessage&, JsonWriter& out) {
+        build_platform_response(out);
+      },
+      [] { return g_platform_generation.load(); });
+  register_request_handler("sysutil.platform.update", handle_platform_update,
+                           "config");
 }
 
 }  // namespace sysutil
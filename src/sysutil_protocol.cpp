@@ -21,147 +21,1301 @@
  * © OpenHD, All Rights Reserved.
  ******************************************************************************/
 
+
 #include "sysutil_protocol.h"
 
+#include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "sysutil_cbor.h"
 
 namespace sysutil {
 namespace {
 
-// Finds the JSON key position for a field name.
-std::size_t find_field_key(const std::string& line, const std::string& field) {
-  const std::string needle = "\"" + field + "\"";
-  return line.find(needle);
+// Nesting limit for skipped object/array values.
+constexpr int kMaxNestingDepth = 32;
+
+bool is_ws(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
 }
 
 // Skips whitespace from a given position.
-std::size_t skip_ws(const std::string& line, std::size_t pos) {
-  while (pos < line.size() &&
-         std::isspace(static_cast<unsigned char>(line[pos]))) {
+std::size_t skip_ws(std::string_view text, std::size_t pos) {
+  while (pos < text.size() && is_ws(text[pos])) {
     ++pos;
   }
   return pos;
 }
 
-}  // namespace
+// Scans a quoted string starting at pos (the opening quote). Returns the
+// position after the closing quote, or npos when it is unterminated.
+std::size_t scan_string(std::string_view text, std::size_t pos) {
+  for (++pos; pos < text.size(); ++pos) {
+    if (text[pos] == '\\') {
+      ++pos;
+    } else if (text[pos] == '"') {
+      return pos + 1;
+    }
+  }
+  return std::string_view::npos;
+}
 
-// Extracts a quoted string field.
-std::optional<std::string> extract_string_field(const std::string& line,
-                                                const std::string& field) {
-  std::size_t key_pos = find_field_key(line, field);
-  if (key_pos == std::string::npos) {
+bool is_number_char(char ch) {
+  return std::isdigit(static_cast<unsigned char>(ch)) || ch == '-' ||
+         ch == '+' || ch == '.' || ch == 'e' || ch == 'E';
+}
+
+// Scans one value starting at pos and reports its kind. Returns the position
+// after the value, or npos on malformed input.
+std::size_t scan_value(std::string_view text, std::size_t pos,
+                       ParsedMessage::ValueKind& kind) {
+  if (pos >= text.size()) {
+    return std::string_view::npos;
+  }
+  const char ch = text[pos];
+  if (ch == '"') {
+    kind = ParsedMessage::ValueKind::String;
+    return scan_string(text, pos);
+  }
+  if (ch == '{' || ch == '[') {
+    kind = ch == '{' ? ParsedMessage::ValueKind::Object
+                     : ParsedMessage::ValueKind::Array;
+    int depth = 0;
+    while (pos < text.size()) {
+      const char c = text[pos];
+      if (c == '"') {
+        pos = scan_string(text, pos);
+        if (pos == std::string_view::npos) {
+          return pos;
+        }
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        if (++depth > kMaxNestingDepth) {
+          return std::string_view::npos;
+        }
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0) {
+          return pos + 1;
+        }
+      }
+      ++pos;
+    }
+    return std::string_view::npos;
+  }
+  if (text.compare(pos, 4, "true") == 0 || text.compare(pos, 4, "null") == 0) {
+    kind = ch == 'n' ? ParsedMessage::ValueKind::Null
+                     : ParsedMessage::ValueKind::Bool;
+    return pos + 4;
+  }
+  if (text.compare(pos, 5, "false") == 0) {
+    kind = ParsedMessage::ValueKind::Bool;
+    return pos + 5;
+  }
+  if (ch == '-' || std::isdigit(static_cast<unsigned char>(ch))) {
+    kind = ParsedMessage::ValueKind::Number;
+    while (pos < text.size() && is_number_char(text[pos])) {
+      ++pos;
+    }
+    return pos;
+  }
+  return std::string_view::npos;
+}
+
+void append_utf8(std::string& out, unsigned code) {
+  if (code < 0x80) {
+    out.push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  }
+}
+
+// Decodes the contents of a quoted string (quotes included in raw).
+std::string decode_string(std::string_view raw) {
+  std::string value;
+  value.reserve(raw.size());
+  for (std::size_t i = 1; i + 1 < raw.size(); ++i) {
+    const char ch = raw[i];
+    if (ch != '\\' || i + 2 >= raw.size()) {
+      value.push_back(ch);
+      continue;
+    }
+    const char esc = raw[++i];
+    switch (esc) {
+      case 'n':
+        value.push_back('\n');
+        break;
+      case 'r':
+        value.push_back('\r');
+        break;
+      case 't':
+        value.push_back('\t');
+        break;
+      case 'b':
+        value.push_back('\b');
+        break;
+      case 'f':
+        value.push_back('\f');
+        break;
+      case 'u': {
+        unsigned code = 0;
+        std::size_t digits = 0;
+        for (; digits < 4 && i + 1 + digits + 1 < raw.size(); ++digits) {
+          const char hex = raw[i + 1 + digits];
+          if (!std::isxdigit(static_cast<unsigned char>(hex))) {
+            break;
+          }
+          code = code * 16 +
+                 static_cast<unsigned>(std::isdigit(static_cast<unsigned char>(hex))
+                                           ? hex - '0'
+                                           : (std::tolower(hex) - 'a' + 10));
+        }
+        if (digits == 4) {
+          append_utf8(value, code);
+          i += 4;
+        } else {
+          value.push_back(esc);
+        }
+        break;
+      }
+      default:
+        value.push_back(esc);
+        break;
+    }
+  }
+  return value;
+}
+
+// Skips tag heads in front of a CBOR item; tags carry no meaning here.
+std::string_view strip_cbor_tags(std::string_view item) {
+  CborHead head;
+  while (read_cbor_head(item, 0, head) && head.major == CborMajor::Tag) {
+    item.remove_prefix(head.size);
+  }
+  return item;
+}
+
+ParsedMessage::ValueKind cbor_kind(std::string_view item) {
+  CborHead head;
+  if (!read_cbor_head(strip_cbor_tags(item), 0, head)) {
+    return ParsedMessage::ValueKind::Null;
+  }
+  switch (head.major) {
+    case CborMajor::Unsigned:
+    case CborMajor::Negative:
+      return ParsedMessage::ValueKind::Number;
+    case CborMajor::Text:
+      return ParsedMessage::ValueKind::String;
+    case CborMajor::Array:
+      return ParsedMessage::ValueKind::Array;
+    case CborMajor::Map:
+      return ParsedMessage::ValueKind::Object;
+    case CborMajor::Simple:
+      if (head.info == 20 || head.info == 21) {
+        return ParsedMessage::ValueKind::Bool;
+      }
+      if (head.info >= 25 && head.info <= 27) {
+        return ParsedMessage::ValueKind::Number;
+      }
+      return ParsedMessage::ValueKind::Null;
+    default:
+      // Byte strings have no JSON counterpart and read as null.
+      return ParsedMessage::ValueKind::Null;
+  }
+}
+
+bool cbor_is_integer(std::string_view item) {
+  CborHead head;
+  return read_cbor_head(strip_cbor_tags(item), 0, head) &&
+         (head.major == CborMajor::Unsigned ||
+          head.major == CborMajor::Negative);
+}
+
+std::optional<int> cbor_int(std::string_view item) {
+  item = strip_cbor_tags(item);
+  CborHead head;
+  if (!read_cbor_head(item, 0, head)) {
     return std::nullopt;
   }
-  std::size_t pos = line.find(':', key_pos);
-  if (pos == std::string::npos) {
+  constexpr auto kMax = static_cast<std::uint64_t>(std::numeric_limits<int>::max());
+  if (head.major == CborMajor::Unsigned) {
+    return head.value <= kMax ? std::optional<int>(static_cast<int>(head.value))
+                              : std::nullopt;
+  }
+  if (head.major == CborMajor::Negative) {
+    return head.value <= kMax
+               ? std::optional<int>(-1 - static_cast<int>(head.value))
+               : std::nullopt;
+  }
+  double value = 0;
+  if (!read_cbor_number(item, value) || !std::isfinite(value)) {
     return std::nullopt;
   }
-  pos = skip_ws(line, pos + 1);
-  if (pos >= line.size() || line[pos] != '"') {
+  value = std::trunc(value);
+  if (value < std::numeric_limits<int>::min() ||
+      value > std::numeric_limits<int>::max()) {
     return std::nullopt;
   }
-  ++pos;
-  std::string value;
-  value.reserve(16);
-  bool escape = false;
-  for (; pos < line.size(); ++pos) {
-    char ch = line[pos];
-    if (escape) {
-      switch (ch) {
-        case 'n':
-          value.push_back('\n');
-          break;
-        case 'r':
-          value.push_back('\r');
-          break;
-        case 't':
-          value.push_back('\t');
-          break;
-        case '\\':
-        case '"':
-        default:
-          value.push_back(ch);
-          break;
-      }
-      escape = false;
-      continue;
+  return static_cast<int>(value);
+}
+
+bool json_value_to_cbor(std::string& out, std::string_view text,
+                        std::size_t& pos, int depth) {
+  if (depth > kMaxNestingDepth) {
+    return false;
+  }
+  pos = skip_ws(text, pos);
+  if (pos >= text.size()) {
+    return false;
+  }
+  const char ch = text[pos];
+  if (ch == '{' || ch == '[') {
+    const bool object = ch == '{';
+    const char close = object ? '}' : ']';
+    out.push_back(static_cast<char>(object ? 0xBF : 0x9F));
+    pos = skip_ws(text, pos + 1);
+    if (pos < text.size() && text[pos] == close) {
+      out.push_back(kCborBreak);
+      ++pos;
+      return true;
     }
-    if (ch == '\\') {
-      escape = true;
-      continue;
+    while (pos < text.size()) {
+      if (object) {
+        if (text[pos] != '"') {
+          return false;
+        }
+        const std::size_t key_end = scan_string(text, pos);
+        if (key_end == std::string_view::npos) {
+          return false;
+        }
+        append_cbor_text(out, decode_string(text.substr(pos, key_end - pos)));
+        pos = skip_ws(text, key_end);
+        if (pos >= text.size() || text[pos] != ':') {
+          return false;
+        }
+        ++pos;
+      }
+      if (!json_value_to_cbor(out, text, pos, depth + 1)) {
+        return false;
+      }
+      pos = skip_ws(text, pos);
+      if (pos < text.size() && text[pos] == close) {
+        out.push_back(kCborBreak);
+        ++pos;
+        return true;
+      }
+      if (pos >= text.size() || text[pos] != ',') {
+        return false;
+      }
+      pos = skip_ws(text, pos + 1);
     }
-    if (ch == '"') {
-      return value;
+    return false;
+  }
+  ParsedMessage::ValueKind kind;
+  const std::size_t end = scan_value(text, pos, kind);
+  if (end == std::string_view::npos) {
+    return false;
+  }
+  const std::string_view raw = text.substr(pos, end - pos);
+  pos = end;
+  switch (kind) {
+    case ParsedMessage::ValueKind::String:
+      append_cbor_text(out, decode_string(raw));
+      return true;
+    case ParsedMessage::ValueKind::Bool:
+      out.push_back(raw == "true" ? kCborTrue : kCborFalse);
+      return true;
+    case ParsedMessage::ValueKind::Null:
+      out.push_back(kCborNull);
+      return true;
+    case ParsedMessage::ValueKind::Number: {
+      long long integer = 0;
+      const auto result =
+          std::from_chars(raw.data(), raw.data() + raw.size(), integer);
+      if (result.ec == std::errc() && result.ptr == raw.data() + raw.size()) {
+        append_cbor_int(out, integer);
+        return true;
+      }
+      const std::string number(raw);
+      char* number_end = nullptr;
+      const double value = std::strtod(number.c_str(), &number_end);
+      if (number_end != number.c_str() + number.size()) {
+        return false;
+      }
+      append_cbor_double(out, value);
+      return true;
     }
-    value.push_back(ch);
+    default:
+      return false;
+  }
+}
+
+// Reads an array of text strings, or a single text string, as a list.
+std::optional<std::vector<std::string>> cbor_string_list(std::string_view item) {
+  item = strip_cbor_tags(item);
+  std::vector<std::string> values;
+  std::string value;
+  if (read_cbor_text(item, value)) {
+    values.push_back(std::move(value));
+    return values;
+  }
+  CborHead head;
+  if (!read_cbor_head(item, 0, head) || head.major != CborMajor::Array) {
+    return std::nullopt;
+  }
+  std::size_t pos = head.size;
+  for (std::uint64_t i = 0; head.indefinite() || i < head.value; ++i) {
+    if (head.indefinite() && pos < item.size() && item[pos] == kCborBreak) {
+      break;
+    }
+    const std::size_t end = skip_cbor_item(item, pos);
+    if (end == std::string_view::npos ||
+        !read_cbor_text(strip_cbor_tags(item.substr(pos, end - pos)), value)) {
+      return std::nullopt;
+    }
+    values.push_back(std::move(value));
+    pos = end;
+  }
+  return values;
+}
+
+}  // namespace
+
+const char* encoding_name(Encoding encoding) {
+  return encoding == Encoding::Cbor ? "cbor" : "json";
+}
+
+std::optional<Encoding> parse_encoding(std::string_view name) {
+  if (name == "json") {
+    return Encoding::Json;
+  }
+  if (name == "cbor") {
+    return Encoding::Cbor;
   }
   return std::nullopt;
 }
 
-// Extracts an integer field.
-std::optional<int> extract_int_field(const std::string& line,
-                                     const std::string& field) {
-  std::size_t key_pos = find_field_key(line, field);
-  if (key_pos == std::string::npos) {
+ParsedMessage::ParsedMessage(std::string_view text, Encoding encoding)
+    : view_(text), encoding_(encoding) {
+  index();
+}
+
+ParsedMessage ParsedMessage::owning(std::string text, Encoding encoding) {
+  ParsedMessage message;
+  message.storage_ = std::move(text);
+  message.owning_ = true;
+  message.encoding_ = encoding;
+  message.index();
+  return message;
+}
+
+std::string_view ParsedMessage::text() const {
+  return owning_ ? std::string_view(storage_) : view_;
+}
+
+void ParsedMessage::index() {
+  if (encoding_ == Encoding::Cbor) {
+    index_cbor();
+    return;
+  }
+  const std::string_view input = text();
+  members_.clear();
+  valid_ = false;
+  if (input.size() > std::numeric_limits<std::uint32_t>::max()) {
+    return;
+  }
+  members_.reserve(16);
+  std::size_t pos = skip_ws(input, 0);
+  if (pos >= input.size() || input[pos] != '{') {
+    return;
+  }
+  pos = skip_ws(input, pos + 1);
+  if (pos < input.size() && input[pos] == '}') {
+    valid_ = skip_ws(input, pos + 1) == input.size();
+    return;
+  }
+  while (pos < input.size()) {
+    if (input[pos] != '"') {
+      return;
+    }
+    const std::size_t key_end = scan_string(input, pos);
+    if (key_end == std::string_view::npos) {
+      return;
+    }
+    Member member;
+    member.key_begin = static_cast<std::uint32_t>(pos + 1);
+    member.key_end = static_cast<std::uint32_t>(key_end - 1);
+    pos = skip_ws(input, key_end);
+    if (pos >= input.size() || input[pos] != ':') {
+      return;
+    }
+    pos = skip_ws(input, pos + 1);
+    const std::size_t value_end = scan_value(input, pos, member.kind);
+    if (value_end == std::string_view::npos) {
+      return;
+    }
+    member.value_begin = static_cast<std::uint32_t>(pos);
+    member.value_end = static_cast<std::uint32_t>(value_end);
+    members_.push_back(member);
+    pos = skip_ws(input, value_end);
+    if (pos >= input.size()) {
+      return;
+    }
+    if (input[pos] == '}') {
+      valid_ = skip_ws(input, pos + 1) == input.size();
+      return;
+    }
+    if (input[pos] != ',') {
+      return;
+    }
+    pos = skip_ws(input, pos + 1);
+  }
+}
+
+void ParsedMessage::index_cbor() {
+  const std::string_view input = text();
+  members_.clear();
+  valid_ = false;
+  if (input.size() > std::numeric_limits<std::uint32_t>::max()) {
+    return;
+  }
+  CborHead head;
+  if (!read_cbor_head(input, 0, head) || head.major != CborMajor::Map) {
+    return;
+  }
+  members_.reserve(16);
+  std::size_t pos = head.size;
+  std::uint64_t remaining = head.value;
+  while (true) {
+    if (head.indefinite()) {
+      if (pos >= input.size()) {
+        return;
+      }
+      if (input[pos] == kCborBreak) {
+        valid_ = pos + 1 == input.size();
+        return;
+      }
+    } else if (remaining-- == 0) {
+      valid_ = pos == input.size();
+      return;
+    }
+    // Only text keys can be looked up; anything else ends the index.
+    CborHead key;
+    if (!read_cbor_head(input, pos, key) || key.major != CborMajor::Text ||
+        key.indefinite() || key.value > input.size() - pos - key.size) {
+      return;
+    }
+    Member member;
+    member.key_begin = static_cast<std::uint32_t>(pos + key.size);
+    member.key_end = static_cast<std::uint32_t>(member.key_begin + key.value);
+    pos = member.key_end;
+    const std::size_t value_end = skip_cbor_item(input, pos);
+    if (value_end == std::string_view::npos) {
+      return;
+    }
+    member.value_begin = static_cast<std::uint32_t>(pos);
+    member.value_end = static_cast<std::uint32_t>(value_end);
+    member.kind = cbor_kind(input.substr(pos, value_end - pos));
+    members_.push_back(member);
+    pos = value_end;
+  }
+}
+
+const ParsedMessage::Member* ParsedMessage::find(std::string_view key) const {
+  const std::string_view input = text();
+  for (const auto& member : members_) {
+    if (member.key_end - member.key_begin == key.size() &&
+        input.compare(member.key_begin, key.size(), key) == 0) {
+      return &member;
+    }
+  }
+  return nullptr;
+}
+
+std::string_view ParsedMessage::value_text(const Member& member) const {
+  return text().substr(member.value_begin,
+                       member.value_end - member.value_begin);
+}
+
+bool ParsedMessage::has(std::string_view key) const {
+  return find(key) != nullptr;
+}
+
+std::optional<std::string> ParsedMessage::string_of(
+    const Member* member) const {
+  if (member == nullptr || member->kind != ValueKind::String) {
     return std::nullopt;
   }
-  std::size_t pos = line.find(':', key_pos);
-  if (pos == std::string::npos) {
+  if (encoding_ == Encoding::Cbor) {
+    std::string value;
+    if (!read_cbor_text(strip_cbor_tags(value_text(*member)), value)) {
+      return std::nullopt;
+    }
+    return value;
+  }
+  return decode_string(value_text(*member));
+}
+
+std::optional<int> ParsedMessage::int_of(const Member* member) const {
+  if (member == nullptr || member->kind != ValueKind::Number) {
+    return std::nullopt;
+  }
+  if (encoding_ == Encoding::Cbor) {
+    return cbor_int(value_text(*member));
+  }
+  const std::string_view raw = value_text(*member);
+  std::size_t pos = 0;
+  const bool neg = raw[pos] == '-';
+  if (neg) {
+    ++pos;
+  }
+  if (pos >= raw.size() ||
+      !std::isdigit(static_cast<unsigned char>(raw[pos]))) {
     return std::nullopt;
   }
-  pos = skip_ws(line, pos + 1);
-  if (pos >= line.size()) {
+  long long value = 0;
+  for (; pos < raw.size() && std::isdigit(static_cast<unsigned char>(raw[pos]));
+       ++pos) {
+    value = value * 10 + (raw[pos] - '0');
+    if (value > static_cast<long long>(std::numeric_limits<int>::max()) + 1) {
+      return std::nullopt;
+    }
+  }
+  value = neg ? -value : value;
+  if (value > std::numeric_limits<int>::max()) {
     return std::nullopt;
   }
+  return static_cast<int>(value);
+}
 
-  bool neg = false;
-  if (line[pos] == '-') {
-    neg = true;
-    ++pos;
+std::optional<bool> ParsedMessage::bool_of(const Member* member) const {
+  if (member == nullptr) {
+    return std::nullopt;
   }
-  if (pos >= line.size() || !std::isdigit(static_cast<unsigned char>(line[pos]))) {
+  const std::string_view raw = value_text(*member);
+  if (encoding_ == Encoding::Cbor) {
+    if (member->kind == ValueKind::Bool) {
+      return strip_cbor_tags(raw).front() == kCborTrue;
+    }
+    if (member->kind == ValueKind::Number && cbor_is_integer(raw)) {
+      const auto value = cbor_int(raw);
+      if (value == 0 || value == 1) {
+        return *value == 1;
+      }
+    }
     return std::nullopt;
   }
+  if (member->kind == ValueKind::Bool) {
+    return raw == "true";
+  }
+  // Exactly 0 or 1; 10, 0.5 or 1e3 are not booleans.
+  if (member->kind == ValueKind::Number && (raw == "0" || raw == "1")) {
+    return raw == "1";
+  }
+  return std::nullopt;
+}
 
-  int value = 0;
-  for (; pos < line.size(); ++pos) {
-    char ch = line[pos];
-    if (!std::isdigit(static_cast<unsigned char>(ch))) {
-      break;
+std::optional<std::string> ParsedMessage::get_string(
+    std::string_view key) const {
+  return string_of(find(key));
+}
+
+std::optional<int> ParsedMessage::get_int(std::string_view key) const {
+  return int_of(find(key));
+}
+
+std::optional<std::uint64_t> ParsedMessage::get_uint64(
+    std::string_view key) const {
+  const Member* member = find(key);
+  if (member == nullptr || member->kind != ValueKind::Number) {
+    return std::nullopt;
+  }
+  const std::string_view raw = value_text(*member);
+  if (encoding_ == Encoding::Cbor) {
+    CborHead head;
+    if (!read_cbor_head(strip_cbor_tags(raw), 0, head) ||
+        head.major != CborMajor::Unsigned) {
+      return std::nullopt;
     }
-    value = value * 10 + (ch - '0');
+    return head.value;
+  }
+  std::uint64_t value = 0;
+  const char* end = raw.data() + raw.size();
+  const auto result = std::from_chars(raw.data(), end, value);
+  if (result.ec != std::errc() || result.ptr != end) {
+    return std::nullopt;
   }
-  return neg ? -value : value;
+  return value;
 }
 
-// Extracts a boolean field, accepting true/false or 0/1.
-std::optional<bool> extract_bool_field(const std::string& line,
-                                       const std::string& field) {
-  std::size_t key_pos = find_field_key(line, field);
-  if (key_pos == std::string::npos) {
+std::optional<bool> ParsedMessage::get_bool(std::string_view key) const {
+  return bool_of(find(key));
+}
+
+std::string_view ParsedMessage::key_at(std::size_t index) const {
+  const Member& member = members_[index];
+  return text().substr(member.key_begin, member.key_end - member.key_begin);
+}
+
+std::optional<std::string> ParsedMessage::string_at(std::size_t index) const {
+  return string_of(&members_[index]);
+}
+
+std::optional<int> ParsedMessage::int_at(std::size_t index) const {
+  return int_of(&members_[index]);
+}
+
+std::optional<bool> ParsedMessage::bool_at(std::size_t index) const {
+  return bool_of(&members_[index]);
+}
+
+std::optional<std::vector<std::string>> ParsedMessage::get_string_list(
+    std::string_view key) const {
+  const Member* member = find(key);
+  if (member == nullptr) {
     return std::nullopt;
   }
-  std::size_t pos = line.find(':', key_pos);
-  if (pos == std::string::npos) {
+  const std::string_view raw = value_text(*member);
+  std::vector<std::string> values;
+  if (encoding_ == Encoding::Cbor) {
+    return cbor_string_list(raw);
+  }
+  if (member->kind == ValueKind::String) {
+    values.push_back(decode_string(raw));
+    return values;
+  }
+  if (member->kind != ValueKind::Array) {
     return std::nullopt;
   }
-  pos = skip_ws(line, pos + 1);
-  if (pos >= line.size()) {
+  std::size_t pos = skip_ws(raw, 1);
+  if (pos < raw.size() && raw[pos] == ']') {
+    return values;
+  }
+  while (pos < raw.size()) {
+    if (raw[pos] != '"') {
+      return std::nullopt;
+    }
+    const std::size_t end = scan_string(raw, pos);
+    if (end == std::string_view::npos) {
+      return std::nullopt;
+    }
+    values.push_back(decode_string(raw.substr(pos, end - pos)));
+    pos = skip_ws(raw, end);
+    if (pos < raw.size() && raw[pos] == ']') {
+      return values;
+    }
+    if (pos >= raw.size() || raw[pos] != ',') {
+      return std::nullopt;
+    }
+    pos = skip_ws(raw, pos + 1);
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string_view> ParsedMessage::get_raw_scalar(
+    std::string_view key) const {
+  const Member* member = find(key);
+  if (member == nullptr) {
     return std::nullopt;
   }
-  if (line.compare(pos, 4, "true") == 0) {
-    return true;
+  const std::string_view raw = value_text(*member);
+  if (member->kind == ValueKind::String) {
+    return raw;
   }
-  if (line.compare(pos, 5, "false") == 0) {
-    return false;
+  if (member->kind != ValueKind::Number) {
+    return std::nullopt;
+  }
+  if (encoding_ == Encoding::Cbor) {
+    return cbor_is_integer(raw) ? std::optional<std::string_view>(raw)
+                                : std::nullopt;
+  }
+  // Integers only, in JSON's form: at least one digit after an optional '-'
+  // and no leading zeros. A fractional, exponent or malformed id is not
+  // echoed.
+  const std::size_t first = !raw.empty() && raw[0] == '-' ? 1 : 0;
+  if (first == raw.size() || (raw[first] == '0' && raw.size() > first + 1)) {
+    return std::nullopt;
+  }
+  for (std::size_t i = first; i < raw.size(); ++i) {
+    if (!std::isdigit(static_cast<unsigned char>(raw[i]))) {
+      return std::nullopt;
+    }
+  }
+  return raw;
+}
+
+std::optional<std::string_view> ParsedMessage::get_raw(
+    std::string_view key) const {
+  const Member* member = find(key);
+  if (member == nullptr) {
+    return std::nullopt;
   }
-  if (line[pos] == '0') {
+  return value_text(*member);
+}
+
+std::optional<std::vector<std::string_view>> ParsedMessage::get_raw_list(
+    std::string_view key) const {
+  const Member* member = find(key);
+  if (member == nullptr || member->kind != ValueKind::Array) {
+    return std::nullopt;
+  }
+  const std::string_view raw = value_text(*member);
+  std::vector<std::string_view> values;
+  if (encoding_ == Encoding::Cbor) {
+    const std::string_view array = strip_cbor_tags(raw);
+    CborHead head;
+    if (!read_cbor_head(array, 0, head)) {
+      return std::nullopt;
+    }
+    std::size_t pos = head.size;
+    for (std::uint64_t i = 0; head.indefinite() || i < head.value; ++i) {
+      if (head.indefinite() && pos < array.size() && array[pos] == kCborBreak) {
+        break;
+      }
+      const std::size_t end = skip_cbor_item(array, pos);
+      if (end == std::string_view::npos) {
+        return std::nullopt;
+      }
+      values.push_back(array.substr(pos, end - pos));
+      pos = end;
+    }
+    return values;
+  }
+  std::size_t pos = skip_ws(raw, 1);
+  if (pos < raw.size() && raw[pos] == ']') {
+    return values;
+  }
+  while (pos < raw.size()) {
+    ValueKind kind;
+    const std::size_t end = scan_value(raw, pos, kind);
+    if (end == std::string_view::npos) {
+      return std::nullopt;
+    }
+    values.push_back(raw.substr(pos, end - pos));
+    pos = skip_ws(raw, end);
+    if (pos < raw.size() && raw[pos] == ']') {
+      return values;
+    }
+    if (pos >= raw.size() || raw[pos] != ',') {
+      return std::nullopt;
+    }
+    pos = skip_ws(raw, pos + 1);
+  }
+  return std::nullopt;
+}
+
+// Extracts a quoted string field.
+std::optional<std::string> extract_string_field(const std::string& line,
+                                                const std::string& field) {
+  return ParsedMessage(line).get_string(field);
+}
+
+// Extracts an array of strings; a single string value yields one element.
+std::optional<std::vector<std::string>> extract_string_list_field(
+    const std::string& line, const std::string& field) {
+  return ParsedMessage(line).get_string_list(field);
+}
+
+// Extracts the raw JSON text of a string or integer field.
+std::optional<std::string> extract_raw_scalar_field(const std::string& line,
+                                                    const std::string& field) {
+  const auto raw = ParsedMessage(line).get_raw_scalar(field);
+  if (!raw) {
+    return std::nullopt;
+  }
+  return std::string(*raw);
+}
+
+// Extracts an integer field.
+std::optional<int> extract_int_field(const std::string& line,
+                                     const std::string& field) {
+  return ParsedMessage(line).get_int(field);
+}
+
+// Extracts a boolean field, accepting true/false or 0/1.
+std::optional<bool> extract_bool_field(const std::string& line,
+                                       const std::string& field) {
+  return ParsedMessage(line).get_bool(field);
+}
+
+bool append_json_as_cbor(std::string& out, std::string_view json) {
+  const std::size_t start = out.size();
+  std::size_t pos = 0;
+  if (!json_value_to_cbor(out, json, pos, 0) ||
+      skip_ws(json, pos) != json.size()) {
+    out.resize(start);
     return false;
   }
-  if (line[pos] == '1') {
+  return true;
+}
+
+std::string json_line_to_cbor(std::string_view line) {
+  std::string out;
+  const std::size_t start = begin_cbor_frame(out);
+  if (!append_json_as_cbor(out, line)) {
+    return {};
+  }
+  finish_cbor_frame(out, start);
+  return out;
+}
+
+void append_json_escaped(std::string& out, std::string_view text) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  std::size_t run = 0;
+  for (std::size_t pos = 0; pos < text.size(); ++pos) {
+    const auto ch = static_cast<unsigned char>(text[pos]);
+    if (ch >= 0x20 && ch != '"' && ch != '\\') {
+      continue;
+    }
+    out.append(text, run, pos - run);
+    run = pos + 1;
+    switch (ch) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      case '\b':
+        out += "\\b";
+        break;
+      case '\f':
+        out += "\\f";
+        break;
+      default: {
+        const char escaped[] = {'\\', 'u', '0', '0', kHex[ch >> 4],
+                                kHex[ch & 0xF]};
+        out.append(escaped, sizeof(escaped));
+        break;
+      }
+    }
+  }
+  out.append(text, run, std::string_view::npos);
+}
+
+std::string json_escape(std::string_view text) {
+  std::string out;
+  out.reserve(text.size());
+  append_json_escaped(out, text);
+  return out;
+}
+
+void LineFramer::append(const char* data, std::size_t size) {
+  if (start_ > 0) {
+    buffer_.erase(0, start_);
+    start_ = 0;
+  }
+  buffer_.append(data, size);
+}
+
+void LineFramer::set_length_prefixed(bool enabled) {
+  length_prefixed_ = enabled;
+  scanned_ = 0;
+  discarding_ = false;
+  skip_ = 0;
+}
+
+LineFramer::Result LineFramer::next(std::string_view& line) {
+  if (length_prefixed_) {
+    if (skip_ > 0) {
+      const std::size_t dropped = std::min(skip_, buffer_.size() - start_);
+      start_ += dropped;
+      skip_ -= dropped;
+      if (skip_ > 0) {
+        return Result::NeedMore;
+      }
+    }
+    const std::string_view available =
+        std::string_view(buffer_).substr(start_);
+    std::uint32_t length = 0;
+    if (!read_cbor_frame_length(available, length)) {
+      return Result::NeedMore;
+    }
+    if (length > max_line_) {
+      start_ += kCborFramePrefix;
+      skip_ = length;
+      return Result::Overlong;
+    }
+    if (available.size() - kCborFramePrefix < length) {
+      return Result::NeedMore;
+    }
+    line = available.substr(kCborFramePrefix, length);
+    start_ += kCborFramePrefix + length;
+    return Result::Line;
+  }
+  while (true) {
+    const char* begin = buffer_.data() + start_;
+    const std::size_t available = buffer_.size() - start_;
+    const void* newline =
+        std::memchr(begin + scanned_, '\n', available - scanned_);
+    if (newline == nullptr) {
+      scanned_ = available;
+      if (discarding_ || available > max_line_) {
+        // Nothing buffered can become a valid line; keep memory bounded.
+        start_ = buffer_.size();
+        scanned_ = 0;
+        if (!discarding_) {
+          discarding_ = true;
+          return Result::Overlong;
+        }
+      }
+      return Result::NeedMore;
+    }
+    const auto length =
+        static_cast<std::size_t>(static_cast<const char*>(newline) - begin);
+    start_ += length + 1;
+    scanned_ = 0;
+    if (discarding_) {
+      // Tail of a line that was already reported.
+      discarding_ = false;
+      continue;
+    }
+    if (length > max_line_) {
+      return Result::Overlong;
+    }
+    line = std::string_view(begin, length);
+    return Result::Line;
+  }
+}
+
+JsonWriter::JsonWriter(std::string buffer) : buffer_(std::move(buffer)) {
+  buffer_.clear();
+}
+
+void JsonWriter::separate() {
+  if (cbor()) {
+    return;
+  }
+  const std::uint64_t bit = std::uint64_t{1} << depth_;
+  if (depth_ > 0 && (has_items_ & bit)) {
+    buffer_ += ',';
+  }
+  has_items_ |= bit;
+}
+
+void JsonWriter::write_key(std::string_view key) {
+  if (cbor()) {
+    append_cbor_text(buffer_, key);
+    return;
+  }
+  separate();
+  buffer_ += '"';
+  append_json_escaped(buffer_, key);
+  buffer_ += "\":";
+}
+
+void JsonWriter::open(char bracket) {
+  if (cbor()) {
+    if (depth_ == 0) {
+      frame_start_ = begin_cbor_frame(buffer_);
+    }
+    buffer_ += static_cast<char>(bracket == '{' ? 0xBF : 0x9F);
+  } else {
+    buffer_ += bracket;
+  }
+  if (depth_ < 63) {
+    ++depth_;
+  }
+  has_items_ &= ~(std::uint64_t{1} << depth_);
+}
+
+void JsonWriter::close(char bracket) {
+  buffer_ += cbor() ? kCborBreak : bracket;
+  if (pass_depth_ == depth_) {
+    pass_depth_ = 0;
+  }
+  if (depth_ > 0) {
+    --depth_;
+  }
+}
+
+JsonWriter& JsonWriter::begin_object() {
+  separate();
+  open('{');
+  if (depth_ == 1 && !lead_.empty()) {
+    buffer_ += lead_;
+    has_items_ |= std::uint64_t{1} << depth_;
+    lead_.clear();
+  }
+  return *this;
+}
+
+// Containers are written even when not requested, so that projected
+// members nested inside them remain reachable.
+void JsonWriter::open_member(std::string_view key, char bracket) {
+  const bool pass = !projection_.empty() && pass_depth_ == 0 &&
+                    projected(key);
+  write_key(key);
+  open(bracket);
+  if (pass) {
+    pass_depth_ = depth_;
+  }
+}
+
+JsonWriter& JsonWriter::begin_object(std::string_view key) {
+  open_member(key, '{');
+  return *this;
+}
+
+JsonWriter& JsonWriter::end_object() {
+  close('}');
+  return *this;
+}
+
+JsonWriter& JsonWriter::begin_array() {
+  separate();
+  open('[');
+  return *this;
+}
+
+JsonWriter& JsonWriter::begin_array(std::string_view key) {
+  open_member(key, '[');
+  return *this;
+}
+
+JsonWriter& JsonWriter::end_array() {
+  close(']');
+  return *this;
+}
+
+void JsonWriter::set_projection(std::vector<std::string> fields) {
+  projection_ = std::move(fields);
+  pass_depth_ = 0;
+}
+
+bool JsonWriter::projected(std::string_view key) const {
+  if (depth_ == 1 && (key == "type" || key == "ok" || key == "message")) {
     return true;
   }
-  return std::nullopt;
+  std::string_view name = key;
+  if (name.rfind("has_", 0) == 0) {
+    name.remove_prefix(4);
+  }
+  for (const auto& field : projection_) {
+    if (field == key || field == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+JsonWriter& JsonWriter::field(std::string_view key, std::string_view value) {
+  if (!wanted(key)) {
+    return *this;
+  }
+  write_key(key);
+  if (cbor()) {
+    append_cbor_text(buffer_, value);
+    return *this;
+  }
+  buffer_ += '"';
+  append_json_escaped(buffer_, value);
+  buffer_ += '"';
+  return *this;
+}
+
+JsonWriter& JsonWriter::field(std::string_view key, const char* value) {
+  return field(key, std::string_view(value ? value : ""));
+}
+
+JsonWriter& JsonWriter::field(std::string_view key, bool value) {
+  if (!wanted(key)) {
+    return *this;
+  }
+  write_key(key);
+  if (cbor()) {
+    buffer_ += value ? kCborTrue : kCborFalse;
+    return *this;
+  }
+  buffer_ += value ? "true" : "false";
+  return *this;
+}
+
+JsonWriter& JsonWriter::field_null(std::string_view key) {
+  if (!wanted(key)) {
+    return *this;
+  }
+  write_key(key);
+  if (cbor()) {
+    buffer_ += kCborNull;
+    return *this;
+  }
+  buffer_ += "null";
+  return *this;
+}
+
+JsonWriter& JsonWriter::field_raw(std::string_view key, std::string_view json) {
+  if (!wanted(key)) {
+    return *this;
+  }
+  write_key(key);
+  if (cbor()) {
+    if (!append_json_as_cbor(buffer_, json)) {
+      buffer_ += kCborNull;
+    }
+    return *this;
+  }
+  buffer_ += json;
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view value) {
+  separate();
+  if (cbor()) {
+    append_cbor_text(buffer_, value);
+    return *this;
+  }
+  buffer_ += '"';
+  append_json_escaped(buffer_, value);
+  buffer_ += '"';
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* value) {
+  return this->value(std::string_view(value ? value : ""));
+}
+
+JsonWriter& JsonWriter::value(bool value) {
+  separate();
+  if (cbor()) {
+    buffer_ += value ? kCborTrue : kCborFalse;
+    return *this;
+  }
+  buffer_ += value ? "true" : "false";
+  return *this;
+}
+
+JsonWriter& JsonWriter::value_raw(std::string_view json) {
+  separate();
+  if (cbor()) {
+    if (!append_json_as_cbor(buffer_, json)) {
+      buffer_ += kCborNull;
+    }
+    return *this;
+  }
+  buffer_ += json;
+  return *this;
+}
+
+JsonWriter& JsonWriter::value_message(std::string_view message) {
+  separate();
+  if (cbor()) {
+    message.remove_prefix(std::min(message.size(), kCborFramePrefix));
+  } else if (!message.empty() && message.back() == '\n') {
+    message.remove_suffix(1);
+  }
+  buffer_ += message;
+  return *this;
+}
+
+void JsonWriter::lead_with(std::string_view key, std::string_view raw) {
+  lead_.clear();
+  if (cbor()) {
+    append_cbor_text(lead_, key);
+    lead_ += raw;
+    return;
+  }
+  lead_ += '"';
+  append_json_escaped(lead_, key);
+  lead_ += "\":";
+  lead_ += raw;
+}
+
+JsonWriter& JsonWriter::line_raw(std::string_view line) {
+  if (cbor()) {
+    // The lead goes right after the map's initial byte; the length prefix
+    // grows to match.
+    if (!lead_.empty() && line.size() > kCborFramePrefix &&
+        line[kCborFramePrefix] == static_cast<char>(0xBF)) {
+      const std::size_t start = begin_cbor_frame(buffer_);
+      buffer_ += line[kCborFramePrefix];
+      buffer_ += lead_;
+      buffer_ += line.substr(kCborFramePrefix + 1);
+      finish_cbor_frame(buffer_, start);
+      lead_.clear();
+    } else {
+      buffer_ += line;
+    }
+    return *this;
+  }
+  if (!lead_.empty() && !line.empty() && line.front() == '{') {
+    buffer_ += '{';
+    buffer_ += lead_;
+    line.remove_prefix(1);
+    if (!line.empty() && line.front() != '}') {
+      buffer_ += ',';
+    }
+    lead_.clear();
+  }
+  buffer_ += line;
+  return *this;
+}
+
+JsonWriter& JsonWriter::end_line() {
+  if (cbor()) {
+    finish_cbor_frame(buffer_, frame_start_);
+  } else {
+    buffer_ += '\n';
+  }
+  depth_ = 0;
+  has_items_ = 0;
+  return *this;
+}
+
+void JsonWriter::reset() {
+  buffer_.clear();
+  lead_.clear();
+  depth_ = 0;
+  has_items_ = 0;
+  frame_start_ = 0;
+  projection_.clear();
+  pass_depth_ = 0;
+}
+
+std::string JsonWriter::take() {
+  std::string out = std::move(buffer_);
+  reset();
+  return out;
+}
+
+void JsonWriter::write_signed(long long value) {
+  if (cbor()) {
+    append_cbor_int(buffer_, value);
+    return;
+  }
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  buffer_.append(digits, result.ptr);
+}
+
+void JsonWriter::write_unsigned(unsigned long long value) {
+  if (cbor()) {
+    append_cbor_uint(buffer_, value);
+    return;
+  }
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  buffer_.append(digits, result.ptr);
 }
 
 }  // namespace sysutil
@@ -0,0 +1,214 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#include "sysutil_reactor.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace sysutil {
+namespace {
+
+constexpr int kMaxEventsPerWait = 32;
+
+// Reads and discards a counter from an eventfd or timerfd.
+void drain_counter(int fd) {
+  std::uint64_t value = 0;
+  while (::read(fd, &value, sizeof(value)) == sizeof(value)) {
+  }
+}
+
+}  // namespace
+
+Reactor::~Reactor() {
+  close_timers();
+  if (wakeup_fd_ >= 0) {
+    ::close(wakeup_fd_);
+  }
+  if (epoll_fd_ >= 0) {
+    ::close(epoll_fd_);
+  }
+}
+
+bool Reactor::open() {
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    std::perror("epoll_create1");
+    return false;
+  }
+  wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    std::perror("eventfd");
+    return false;
+  }
+  return register_fd(wakeup_fd_, EPOLLIN, [this](std::uint32_t) {
+           drain_counter(wakeup_fd_);
+           run_posted();
+         }) != 0;
+}
+
+std::uint64_t Reactor::register_fd(int fd, std::uint32_t events,
+                                   FdCallback callback) {
+  const std::uint64_t token = next_token_++;
+  epoll_event ev{};
+  ev.events = events | EPOLLET;
+  ev.data.u64 = token;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    std::perror("epoll_ctl add");
+    return 0;
+  }
+  auto registration = std::make_shared<Registration>();
+  registration->fd = fd;
+  registration->callback = std::move(callback);
+  by_token_[token] = std::move(registration);
+  token_by_fd_[fd] = token;
+  return token;
+}
+
+bool Reactor::add(int fd, std::uint32_t events, FdCallback callback) {
+  return register_fd(fd, events, std::move(callback)) != 0;
+}
+
+void Reactor::remove(int fd) {
+  auto it = token_by_fd_.find(fd);
+  if (it == token_by_fd_.end()) {
+    return;
+  }
+  (void)::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  by_token_.erase(it->second);
+  token_by_fd_.erase(it);
+}
+
+int Reactor::add_timer(TimerCallback callback) {
+  const int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0) {
+    std::perror("timerfd_create");
+    return -1;
+  }
+  auto on_expire = [fd, callback = std::move(callback)](std::uint32_t) {
+    std::uint64_t expirations = 0;
+    if (::read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+      return;
+    }
+    callback();
+  };
+  if (register_fd(fd, EPOLLIN, std::move(on_expire)) == 0) {
+    ::close(fd);
+    return -1;
+  }
+  timers_.insert(fd);
+  return fd;
+}
+
+bool Reactor::arm_timer(int timer, std::chrono::milliseconds delay,
+                        std::chrono::milliseconds interval) {
+  if (timers_.count(timer) == 0) {
+    return false;
+  }
+  // A zero it_value would disarm the timer, so clamp to the shortest delay.
+  if (delay.count() <= 0) {
+    delay = std::chrono::milliseconds(1);
+  }
+  itimerspec spec{};
+  spec.it_value.tv_sec = static_cast<time_t>(delay.count() / 1000);
+  spec.it_value.tv_nsec = static_cast<long>((delay.count() % 1000) * 1000000);
+  spec.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000);
+  spec.it_interval.tv_nsec =
+      static_cast<long>((interval.count() % 1000) * 1000000);
+  return ::timerfd_settime(timer, 0, &spec, nullptr) == 0;
+}
+
+bool Reactor::disarm_timer(int timer) {
+  if (timers_.count(timer) == 0) {
+    return false;
+  }
+  itimerspec spec{};
+  return ::timerfd_settime(timer, 0, &spec, nullptr) == 0;
+}
+
+void Reactor::wakeup() {
+  if (wakeup_fd_ < 0) {
+    return;
+  }
+  const std::uint64_t one = 1;
+  (void)!::write(wakeup_fd_, &one, sizeof(one));
+}
+
+void Reactor::post(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(posted_mutex_);
+    posted_.push_back(std::move(task));
+  }
+  wakeup();
+}
+
+void Reactor::run_posted() {
+  std::vector<Task> tasks;
+  {
+    std::lock_guard<std::mutex> lock(posted_mutex_);
+    tasks.swap(posted_);
+  }
+  for (auto& task : tasks) {
+    task();
+  }
+}
+
+bool Reactor::run_once() {
+  epoll_event events[kMaxEventsPerWait];
+  const int ready = ::epoll_wait(epoll_fd_, events, kMaxEventsPerWait, -1);
+  if (ready < 0) {
+    if (errno == EINTR) {
+      return true;
+    }
+    std::perror("epoll_wait");
+    return false;
+  }
+  for (int i = 0; i < ready; ++i) {
+    // Look the registration up per event: an earlier callback in this batch
+    // may have removed it, and the fd number may already be reused.
+    auto it = by_token_.find(events[i].data.u64);
+    if (it == by_token_.end()) {
+      continue;
+    }
+    const auto registration = it->second;
+    registration->callback(events[i].events);
+  }
+  return true;
+}
+
+void Reactor::close_timers() {
+  for (const int fd : timers_) {
+    remove(fd);
+    ::close(fd);
+  }
+  timers_.clear();
+}
+
+}  // namespace sysutil
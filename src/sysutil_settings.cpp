@@ -26,19 +26,24 @@
 #include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <thread>
+#include <utility>
 
 #include "sysutil_camera.h"
 #include "sysutil_config.h"
 #include "sysutil_debug.h"
+#include "sysutil_dispatch.h"
 #include "sysutil_hostname.h"
+#include "sysutil_persist.h"
 #include "sysutil_platform.h"
 #include "sysutil_protocol.h"
 #include "sysutil_status.h"
+#include "sysutil_video.h"
 #include "platforms_generated.h"
 
 namespace sysutil {
@@ -50,21 +55,13 @@ constexpr const char* kGroundFile = "/Config/openhd/ground.txt";
 constexpr const char* kRecordFile = "/Config/openhd/record.txt";
 constexpr const char* kSettingsJson = "/Config/settings.json";
 constexpr const char* kSettingsJsonSub = "/Config/openhd/settings.json";
-constexpr bool kDefaultWifiEnableAutodetect = true;
-constexpr const char* kDefaultNwEthernetCard = "RPI_ETHERNET_ONLY";
-constexpr int kDefaultVideoPort = 5000;
-constexpr int kDefaultTelemetryPort = 5600;
-constexpr const char* kDefaultMicrohardUsername = "admin";
+constexpr bool kRecordModeEnabled = false;
+constexpr int kLegacyUsbCameraType = 1;
+constexpr int kUsbGenericCameraType = 10;
 
 bool is_x20_platform() {
   return platform_info().platform_type == X_PLATFORM_TYPE_ALWINNER_X20;
 }
-constexpr const char* kDefaultMicrohardPassword = "qwertz1";
-constexpr int kDefaultMicrohardVideoPort = 5910;
-constexpr int kDefaultMicrohardTelemetryPort = 5920;
-constexpr bool kRecordModeEnabled = false;
-constexpr int kLegacyUsbCameraType = 1;
-constexpr int kUsbGenericCameraType = 10;
 
 bool file_exists(const char* path) {
   std::error_code ec;
@@ -90,34 +87,6 @@ std::string normalize_run_mode(std::string mode) {
   return "";
 }
 
-std::string json_escape(const std::string& input) {
-  std::string out;
-  out.reserve(input.size());
-  for (char c : input) {
-    switch (c) {
-      case '\\':
-        out += "\\\\";
-        break;
-      case '"':
-        out += "\\\"";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
-        break;
-      case '\t':
-        out += "\\t";
-        break;
-      default:
-        out += c;
-        break;
-    }
-  }
-  return out;
-}
-
 std::optional<int> read_int_file(const char* path) {
   std::ifstream file(path);
   if (!file) {
@@ -139,8 +108,172 @@ int normalize_camera_type(int value) {
   return value;
 }
 
+// Writes a field's configured value, or its schema default when unset.
+void append_setting_value(JsonWriter& out, const SysutilConfig& config,
+                          const ConfigField& field) {
+  switch (field.type) {
+    case ConfigFieldType::Bool:
+      out.field(field.key,
+                (config.*field.bool_member).value_or(field.default_bool));
+      break;
+    case ConfigFieldType::Int:
+      out.field(field.key,
+                (config.*field.int_member).value_or(field.default_int));
+      break;
+    case ConfigFieldType::String: {
+      const auto& value = config.*field.string_member;
+      out.field(field.key, value ? std::string_view(*value)
+                                 : std::string_view(field.default_string));
+      break;
+    }
+  }
+}
+
+// Stores an int after the schema's range check and camera normalization.
+bool store_int_setting(const ConfigField& field, int value,
+                       SysutilConfig& config) {
+  if (field.has_range && (value < field.min_value || value > field.max_value)) {
+    return false;
+  }
+  config.*field.int_member = field.update == SettingUpdate::CameraType
+                                 ? normalize_camera_type(value)
+                                 : value;
+  return true;
+}
+
+// Stores a string after the schema's length check.
+bool store_string_setting(const ConfigField& field, std::string value,
+                          SysutilConfig& config) {
+  if (value.size() < field.min_length ||
+      (field.max_length != 0 && value.size() > field.max_length)) {
+    return false;
+  }
+  config.*field.string_member = std::move(value);
+  return true;
+}
+
+// Applies a table-driven field from a settings update. Returns true when the
+// request carried an acceptable value for it.
+bool apply_setting_update(const ParsedMessage& request,
+                          const ConfigField& field, SysutilConfig& config) {
+  switch (field.type) {
+    case ConfigFieldType::Bool: {
+      auto value = request.get_bool(field.key);
+      if (!value && field.update_alias) {
+        value = request.get_bool(field.update_alias);
+      }
+      if (!value) {
+        return false;
+      }
+      config.*field.bool_member = *value;
+      return true;
+    }
+    case ConfigFieldType::Int: {
+      auto value = request.get_int(field.key);
+      if (!value && field.update_alias) {
+        value = request.get_int(field.update_alias);
+      }
+      return value && store_int_setting(field, *value, config);
+    }
+    case ConfigFieldType::String: {
+      auto value = request.get_string(field.key);
+      if (!value && field.update_alias) {
+        value = request.get_string(field.update_alias);
+      }
+      return value && store_string_setting(field, std::move(*value), config);
+    }
+  }
+  return false;
+}
+
+// Looks a settings key up by its config key or its update alias.
+const ConfigField* find_setting_field(std::string_view key) {
+  if (const ConfigField* field = find_config_field(key)) {
+    return field;
+  }
+  for (const ConfigField& field : kConfigFields) {
+    if (field.update_alias && key == field.update_alias) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+// Reads since_generation; absent or malformed values, or a generation from
+// another daemon run (since_epoch missing or different), ask for everything.
+std::uint64_t requested_generation(const ParsedMessage& request) {
+  if (request.get_uint64("since_epoch") != config_epoch()) {
+    return 0;
+  }
+  return request.get_uint64("since_generation").value_or(0);
+}
+
+// Validates and applies one transaction change. Returns an error message, or
+// nullptr when the change was applied.
+const char* apply_transaction_change(const ParsedMessage& changes,
+                                     std::size_t index,
+                                     SysutilConfig& config) {
+  const ConfigField* field = find_setting_field(changes.key_at(index));
+  if (!field || field->update == SettingUpdate::ReadOnly) {
+    return "unknown or read-only setting";
+  }
+  if (field->update == SettingUpdate::Custom) {
+    // run_mode is the only custom update.
+    const auto value = changes.string_at(index);
+    if (!value) {
+      return "expected a string";
+    }
+    const auto normalized = normalize_run_mode(*value);
+    if (!normalized.empty()) {
+      config.run_mode = normalized;
+    } else if (*value == "unset" || *value == "unknown") {
+      config.run_mode = std::nullopt;
+    } else {
+      return "invalid run_mode";
+    }
+    return nullptr;
+  }
+  switch (field->type) {
+    case ConfigFieldType::Bool: {
+      const auto value = changes.bool_at(index);
+      if (!value) {
+        return "expected a bool";
+      }
+      config.*field->bool_member = *value;
+      return nullptr;
+    }
+    case ConfigFieldType::Int: {
+      const auto value = changes.int_at(index);
+      if (!value) {
+        return "expected an integer";
+      }
+      return store_int_setting(*field, *value, config) ? nullptr
+                                                        : "out of range";
+    }
+    case ConfigFieldType::String: {
+      auto value = changes.string_at(index);
+      if (!value) {
+        return "expected a string";
+      }
+      return store_string_setting(*field, std::move(*value), config)
+                 ? nullptr
+                 : "invalid length";
+    }
+  }
+  return "unsupported setting";
+}
+
 }  // namespace
 
+std::string effective_run_mode(std::string_view configured_mode,
+                               int platform_type) {
+  if (platform_type == X_PLATFORM_TYPE_ALWINNER_X20) {
+    return "air";
+  }
+  const auto mode = normalize_run_mode(std::string(configured_mode));
+  return mode.empty() ? "ground" : mode;
+}
+
 void sync_settings_from_files() {
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
@@ -164,15 +297,16 @@ void sync_settings_from_files() {
       std::ostringstream buffer;
       buffer << file.rdbuf();
       const std::string content = buffer.str();
+      const ParsedMessage parsed(content);
 
       // Parse camera fields (supports int or string)
       auto parse_camera_field = [&](const char* key, std::optional<int>& out) {
-        if (auto cam_int = extract_int_field(content, key); cam_int) {
+        if (auto cam_int = parsed.get_int(key); cam_int) {
           out = normalize_camera_type(*cam_int);
           changed = true;
           return;
         }
-        if (auto cam_str = extract_string_field(content, key); cam_str) {
+        if (auto cam_str = parsed.get_string(key); cam_str) {
           try {
             out = normalize_camera_type(std::stoi(*cam_str));
             changed = true;
@@ -186,7 +320,7 @@ void sync_settings_from_files() {
 
       auto parse_camera_port = [&](const char* key,
                                    std::optional<std::string>& out) {
-        if (auto port = extract_string_field(content, key);
+        if (auto port = parsed.get_string(key);
             port.has_value() && (*port == "cam0" || *port == "cam1")) {
           out = *port;
           changed = true;
@@ -196,13 +330,13 @@ void sync_settings_from_files() {
       parse_camera_port("camera2_port", config.camera2_port);
 
       if (auto camera_resolution_fps =
-              extract_string_field(content, "camera_resolution_fps");
+              parsed.get_string("camera_resolution_fps");
           camera_resolution_fps.has_value()) {
         config.camera_resolution_fps = *camera_resolution_fps;
         changed = true;
       }
       if (auto camera2_resolution_fps =
-              extract_string_field(content, "camera2_resolution_fps");
+              parsed.get_string("camera2_resolution_fps");
           camera2_resolution_fps.has_value()) {
         config.camera2_resolution_fps = *camera2_resolution_fps;
         changed = true;
@@ -211,7 +345,7 @@ void sync_settings_from_files() {
       auto parse_ip_camera_string = [&](const char* key,
                                         std::optional<std::string>& out,
                                         std::size_t maximum_length) {
-        if (auto value = extract_string_field(content, key);
+        if (auto value = parsed.get_string(key);
             value.has_value() && !value->empty() &&
             value->size() <= maximum_length) {
           out = *value;
@@ -225,14 +359,14 @@ void sync_settings_from_files() {
                              config.camera2_ip_camera_address, 15);
       parse_ip_camera_string("camera2_ip_camera_pipeline",
                              config.camera2_ip_camera_pipeline, 127);
-      if (auto bitrate = extract_int_field(content, "ip_camera_bitrate_mbits");
+      if (auto bitrate = parsed.get_int("ip_camera_bitrate_mbits");
           bitrate.has_value() && *bitrate >= 1 && *bitrate <= 20) {
         config.ip_camera_bitrate_mbits = *bitrate;
         changed = true;
       }
 
       // Parse role
-      auto role = extract_string_field(content, "role");
+      auto role = parsed.get_string("role");
       if (role) {
         const auto mode = normalize_run_mode(*role);
         if (!mode.empty()) {
@@ -242,17 +376,17 @@ void sync_settings_from_files() {
       }
 
       if (auto disable_openhd =
-              extract_bool_field(content, "disable_openhd_service");
+              parsed.get_bool("disable_openhd_service");
           disable_openhd.has_value()) {
         config.disable_openhd_service = *disable_openhd;
         changed = true;
       }
-      if (auto debug = extract_bool_field(content, "debug");
+      if (auto debug = parsed.get_bool("debug");
           debug.has_value()) {
         config.debug_enabled = *debug;
         changed = true;
       } else if (auto debug_enabled =
-                     extract_bool_field(content, "debug_enabled");
+                     parsed.get_bool("debug_enabled");
                  debug_enabled.has_value()) {
         config.debug_enabled = *debug_enabled;
         changed = true;
@@ -294,476 +428,249 @@ void sync_settings_from_files() {
   }
 }
 
-bool is_settings_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.settings.request";
-}
-
-bool is_settings_update(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.settings.update";
-}
-
-bool is_camera_setup_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.camera.setup.request";
-}
+void build_settings_response(const ParsedMessage& request, JsonWriter& out) {
+  const auto snapshot = sysutil_config_snapshot();
+  out.begin_object().field("type", "sysutil.settings.response");
+  if (snapshot->result == ConfigLoadResult::Error) {
+    out.field("ok", false).end_object().end_line();
+    return;
+  }
+  const SysutilConfig& config = snapshot->config;
 
-std::string build_settings_response() {
-  SysutilConfig config;
-  const auto load_result = load_sysutil_config(config);
-  if (load_result == ConfigLoadResult::Error) {
-    return "{\"type\":\"sysutil.settings.response\",\"ok\":false}\n";
+  // A client that already holds a generation gets only what changed since.
+  const std::uint64_t since = requested_generation(request);
+  out.field("ok", true)
+      .field("epoch", config_epoch())
+      .field("generation", snapshot->generation);
+  if (since != 0 && since == snapshot->generation) {
+    out.field("not_modified", true).end_object().end_line();
+    return;
+  }
+  const auto changed_fields =
+      config_changes_between(since, snapshot->generation);
+  if (changed_fields) {
+    out.field("partial", true);
   }
 
-  const bool has_reset = config.reset_requested.has_value();
-  const bool reset_requested = config.reset_requested.value_or(false);
-  std::string run_mode = "ground";
-  bool has_run_mode = true;
-  if (config.run_mode.has_value()) {
-    const auto configured_mode = normalize_run_mode(*config.run_mode);
-    if (!configured_mode.empty()) {
-      run_mode = configured_mode;
+  const std::string run_mode = effective_run_mode(
+      config.run_mode.value_or(""), platform_info().platform_type);
+
+  std::size_t index = 0;
+  for (const ConfigField& field : kConfigFields) {
+    const bool send =
+        !changed_fields || (*changed_fields >> index & 1) != 0;
+    ++index;
+    if (!send) {
+      continue;
+    }
+    switch (field.response) {
+      case SettingResponse::Hidden:
+        break;
+      case SettingResponse::Custom:
+        // run_mode is always reported, normalized and forced on X20.
+        out.field("has_run_mode", true).field(field.key, run_mode);
+        break;
+      case SettingResponse::HasFlag:
+        out.field(field.has_key, config_has_field(config, field));
+        append_setting_value(out, config, field);
+        break;
+      case SettingResponse::Value:
+        append_setting_value(out, config, field);
+        break;
     }
   }
-  if (is_x20_platform()) {
-    run_mode = "air";
-  }
-  const bool has_camera_type = config.camera_type.has_value();
-  const bool has_camera2_type = config.camera2_type.has_value();
-  const bool has_camera_resolution_fps =
-      config.camera_resolution_fps.has_value();
-  const bool has_camera2_resolution_fps =
-      config.camera2_resolution_fps.has_value();
-  const bool has_ip_camera_address = config.ip_camera_address.has_value();
-  const bool has_ip_camera_pipeline = config.ip_camera_pipeline.has_value();
-  const bool has_camera2_ip_camera_address =
-      config.camera2_ip_camera_address.has_value();
-  const bool has_camera2_ip_camera_pipeline =
-      config.camera2_ip_camera_pipeline.has_value();
-  const bool has_ip_camera_bitrate_mbits =
-      config.ip_camera_bitrate_mbits.has_value();
-  const bool wifi_enable_autodetect =
-      config.wifi_enable_autodetect.value_or(kDefaultWifiEnableAutodetect);
-  const std::string wifi_wb_link_cards = config.wifi_wb_link_cards.value_or("");
-  const std::string wifi_hotspot_card = config.wifi_hotspot_card.value_or("");
-  const bool wifi_monitor_card_emulate =
-      config.wifi_monitor_card_emulate.value_or(false);
-  const bool wifi_force_no_link_but_hotspot =
-      config.wifi_force_no_link_but_hotspot.value_or(false);
-  const bool wifi_local_network_enable =
-      config.wifi_local_network_enable.value_or(false);
-  const std::string wifi_local_network_ssid =
-      config.wifi_local_network_ssid.value_or("");
-  const std::string wifi_local_network_password =
-      config.wifi_local_network_password.value_or("");
-  const std::string nw_ethernet_card =
-      config.nw_ethernet_card.value_or(kDefaultNwEthernetCard);
-  const std::string nw_manual_forwarding_ips =
-      config.nw_manual_forwarding_ips.value_or("");
-  const bool nw_forward_to_localhost_58xx =
-      config.nw_forward_to_localhost_58xx.value_or(false);
-  const std::string ground_unit_ip = config.ground_unit_ip.value_or("");
-  const std::string air_unit_ip = config.air_unit_ip.value_or("");
-  const int video_port = config.video_port.value_or(kDefaultVideoPort);
-  const int telemetry_port = config.telemetry_port.value_or(kDefaultTelemetryPort);
-  const bool disable_microhard_detection =
-      config.disable_microhard_detection.value_or(false);
-  const bool force_microhard = config.force_microhard.value_or(false);
-  const std::string microhard_username =
-      config.microhard_username.value_or(kDefaultMicrohardUsername);
-  const std::string microhard_password =
-      config.microhard_password.value_or(kDefaultMicrohardPassword);
-  const std::string microhard_ip_air = config.microhard_ip_air.value_or("");
-  const std::string microhard_ip_ground =
-      config.microhard_ip_ground.value_or("");
-  const std::string microhard_ip_range =
-      config.microhard_ip_range.value_or("");
-  const int microhard_video_port =
-      config.microhard_video_port.value_or(kDefaultMicrohardVideoPort);
-  const int microhard_telemetry_port =
-      config.microhard_telemetry_port.value_or(kDefaultMicrohardTelemetryPort);
-  const bool gen_enable_last_known_position =
-      config.gen_enable_last_known_position.value_or(false);
-  const int gen_rf_metrics_level = config.gen_rf_metrics_level.value_or(0);
-  const bool disable_openhd_service =
-      config.disable_openhd_service.value_or(false);
-
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.settings.response\",\"ok\":true"
-      << ",\"has_reset\":" << (has_reset ? "true" : "false")
-      << ",\"reset_requested\":" << (reset_requested ? "true" : "false")
-      << ",\"has_camera_type\":" << (has_camera_type ? "true" : "false")
-      << ",\"camera_type\":" << (has_camera_type ? *config.camera_type : 0)
-      << ",\"has_camera2_type\":" << (has_camera2_type ? "true" : "false")
-      << ",\"camera2_type\":" << (has_camera2_type ? *config.camera2_type : 0)
-      << ",\"has_camera_resolution_fps\":"
-      << (has_camera_resolution_fps ? "true" : "false")
-      << ",\"camera_resolution_fps\":\""
-      << json_escape(has_camera_resolution_fps ? *config.camera_resolution_fps
-                                               : "")
-      << "\""
-      << ",\"has_camera2_resolution_fps\":"
-      << (has_camera2_resolution_fps ? "true" : "false")
-      << ",\"camera2_resolution_fps\":\""
-      << json_escape(has_camera2_resolution_fps ? *config.camera2_resolution_fps
-                                                : "")
-      << "\""
-      << ",\"has_ip_camera_address\":"
-      << (has_ip_camera_address ? "true" : "false")
-      << ",\"ip_camera_address\":\""
-      << json_escape(has_ip_camera_address ? *config.ip_camera_address : "")
-      << "\""
-      << ",\"has_ip_camera_pipeline\":"
-      << (has_ip_camera_pipeline ? "true" : "false")
-      << ",\"ip_camera_pipeline\":\""
-      << json_escape(has_ip_camera_pipeline ? *config.ip_camera_pipeline : "")
-      << "\""
-      << ",\"has_camera2_ip_camera_address\":"
-      << (has_camera2_ip_camera_address ? "true" : "false")
-      << ",\"camera2_ip_camera_address\":\""
-      << json_escape(has_camera2_ip_camera_address
-                         ? *config.camera2_ip_camera_address
-                         : "")
-      << "\""
-      << ",\"has_camera2_ip_camera_pipeline\":"
-      << (has_camera2_ip_camera_pipeline ? "true" : "false")
-      << ",\"camera2_ip_camera_pipeline\":\""
-      << json_escape(has_camera2_ip_camera_pipeline
-                         ? *config.camera2_ip_camera_pipeline
-                         : "")
-      << "\""
-      << ",\"has_ip_camera_bitrate_mbits\":"
-      << (has_ip_camera_bitrate_mbits ? "true" : "false")
-      << ",\"ip_camera_bitrate_mbits\":"
-      << (has_ip_camera_bitrate_mbits ? *config.ip_camera_bitrate_mbits : 2)
-      << ",\"has_run_mode\":" << (has_run_mode ? "true" : "false")
-      << ",\"run_mode\":\"" << json_escape(has_run_mode ? run_mode : "ground")
-      << "\""
-      << ",\"wifi_enable_autodetect\":"
-      << (wifi_enable_autodetect ? "true" : "false")
-      << ",\"wifi_wb_link_cards\":\"" << json_escape(wifi_wb_link_cards) << "\""
-      << ",\"wifi_hotspot_card\":\"" << json_escape(wifi_hotspot_card) << "\""
-      << ",\"wifi_monitor_card_emulate\":"
-      << (wifi_monitor_card_emulate ? "true" : "false")
-      << ",\"wifi_force_no_link_but_hotspot\":"
-      << (wifi_force_no_link_but_hotspot ? "true" : "false")
-      << ",\"wifi_local_network_enable\":"
-      << (wifi_local_network_enable ? "true" : "false")
-      << ",\"wifi_local_network_ssid\":\""
-      << json_escape(wifi_local_network_ssid) << "\""
-      << ",\"wifi_local_network_password\":\""
-      << json_escape(wifi_local_network_password) << "\""
-      << ",\"nw_ethernet_card\":\"" << json_escape(nw_ethernet_card) << "\""
-      << ",\"nw_manual_forwarding_ips\":\""
-      << json_escape(nw_manual_forwarding_ips) << "\""
-      << ",\"nw_forward_to_localhost_58xx\":"
-      << (nw_forward_to_localhost_58xx ? "true" : "false")
-      << ",\"ground_unit_ip\":\"" << json_escape(ground_unit_ip) << "\""
-      << ",\"air_unit_ip\":\"" << json_escape(air_unit_ip) << "\""
-      << ",\"video_port\":" << video_port
-      << ",\"telemetry_port\":" << telemetry_port
-      << ",\"disable_microhard_detection\":"
-      << (disable_microhard_detection ? "true" : "false")
-      << ",\"force_microhard\":" << (force_microhard ? "true" : "false")
-      << ",\"microhard_username\":\"" << json_escape(microhard_username) << "\""
-      << ",\"microhard_password\":\"" << json_escape(microhard_password) << "\""
-      << ",\"microhard_ip_air\":\"" << json_escape(microhard_ip_air) << "\""
-      << ",\"microhard_ip_ground\":\"" << json_escape(microhard_ip_ground)
-      << "\""
-      << ",\"microhard_ip_range\":\"" << json_escape(microhard_ip_range) << "\""
-      << ",\"microhard_video_port\":" << microhard_video_port
-      << ",\"microhard_telemetry_port\":" << microhard_telemetry_port
-      << ",\"gen_enable_last_known_position\":"
-      << (gen_enable_last_known_position ? "true" : "false")
-      << ",\"gen_rf_metrics_level\":" << gen_rf_metrics_level
-      << ",\"disable_openhd_service\":"
-      << (disable_openhd_service ? "true" : "false") << "}\n";
-  return out.str();
+  out.end_object().end_line();
 }
 
-std::string handle_settings_update(const std::string& line) {
+void handle_settings_update(const ParsedMessage& request, JsonWriter& out) {
+  out.begin_object().field("type", "sysutil.settings.update.response");
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
   if (load_result == ConfigLoadResult::Error) {
-    return "{\"type\":\"sysutil.settings.update.response\",\"ok\":false}\n";
+    out.field("ok", false).end_object().end_line();
+    return;
   }
 
   bool changed = false;
-  bool hostname_related_change = false;
-  bool debug_changed = false;
-  if (auto reset_requested = extract_bool_field(line, "reset_requested");
-      reset_requested.has_value()) {
-    config.reset_requested = *reset_requested;
-    changed = true;
-  }
-
-  if (auto camera_type = extract_int_field(line, "camera_type");
-      camera_type.has_value()) {
-    config.camera_type = normalize_camera_type(*camera_type);
-    changed = true;
-  }
-
-  if (auto camera2_type = extract_int_field(line, "camera2_type");
-      camera2_type.has_value()) {
-    config.camera2_type = normalize_camera_type(*camera2_type);
-    changed = true;
-  }
-
-  if (auto camera_resolution_fps =
-          extract_string_field(line, "camera_resolution_fps");
-      camera_resolution_fps.has_value()) {
-    config.camera_resolution_fps = *camera_resolution_fps;
-    changed = true;
-  }
-
-  if (auto camera2_resolution_fps =
-          extract_string_field(line, "camera2_resolution_fps");
-      camera2_resolution_fps.has_value()) {
-    config.camera2_resolution_fps = *camera2_resolution_fps;
-    changed = true;
-  }
-
-  auto update_ip_camera_string = [&](const char* key,
-                                     std::optional<std::string>& out,
-                                     std::size_t maximum_length) {
-    if (auto value = extract_string_field(line, key);
-        value.has_value() && !value->empty() &&
-        value->size() <= maximum_length) {
-      out = *value;
+  unsigned effects = kSettingEffectNone;
+  for (const ConfigField& field : kConfigFields) {
+    if (field.update != SettingUpdate::Assign &&
+        field.update != SettingUpdate::CameraType) {
+      continue;
+    }
+    if (apply_setting_update(request, field, config)) {
       changed = true;
+      effects |= field.effects;
     }
-  };
-  update_ip_camera_string("ip_camera_address", config.ip_camera_address, 15);
-  update_ip_camera_string("ip_camera_pipeline", config.ip_camera_pipeline, 127);
-  update_ip_camera_string("camera2_ip_camera_address",
-                          config.camera2_ip_camera_address, 15);
-  update_ip_camera_string("camera2_ip_camera_pipeline",
-                          config.camera2_ip_camera_pipeline, 127);
-  if (auto bitrate = extract_int_field(line, "ip_camera_bitrate_mbits");
-      bitrate.has_value() && *bitrate >= 1 && *bitrate <= 20) {
-    config.ip_camera_bitrate_mbits = *bitrate;
-    changed = true;
   }
 
-  if (auto run_mode_field = extract_string_field(line, "run_mode");
+  if (auto run_mode_field = request.get_string("run_mode");
       run_mode_field.has_value()) {
     const auto normalized = normalize_run_mode(*run_mode_field);
     if (!normalized.empty()) {
       config.run_mode = normalized;
       changed = true;
-      hostname_related_change = true;
+      effects |= kSettingEffectHostname;
     } else if (*run_mode_field == "unset" || *run_mode_field == "unknown") {
       config.run_mode = std::nullopt;
       changed = true;
-      hostname_related_change = true;
+      effects |= kSettingEffectHostname;
     }
   }
 
-  if (auto wifi_enable_autodetect =
-          extract_bool_field(line, "wifi_enable_autodetect");
-      wifi_enable_autodetect.has_value()) {
-    config.wifi_enable_autodetect = *wifi_enable_autodetect;
-    changed = true;
-  }
-  if (auto wifi_wb_link_cards =
-          extract_string_field(line, "wifi_wb_link_cards");
-      wifi_wb_link_cards.has_value()) {
-    config.wifi_wb_link_cards = *wifi_wb_link_cards;
-    changed = true;
-  }
-  if (auto wifi_hotspot_card = extract_string_field(line, "wifi_hotspot_card");
-      wifi_hotspot_card.has_value()) {
-    config.wifi_hotspot_card = *wifi_hotspot_card;
-    changed = true;
-  }
-  if (auto wifi_monitor_card_emulate =
-          extract_bool_field(line, "wifi_monitor_card_emulate");
-      wifi_monitor_card_emulate.has_value()) {
-    config.wifi_monitor_card_emulate = *wifi_monitor_card_emulate;
-    changed = true;
-  }
-  if (auto wifi_force_no_link_but_hotspot =
-          extract_bool_field(line, "wifi_force_no_link_but_hotspot");
-      wifi_force_no_link_but_hotspot.has_value()) {
-    config.wifi_force_no_link_but_hotspot = *wifi_force_no_link_but_hotspot;
-    changed = true;
-  }
-  if (auto wifi_local_network_enable =
-          extract_bool_field(line, "wifi_local_network_enable");
-      wifi_local_network_enable.has_value()) {
-    config.wifi_local_network_enable = *wifi_local_network_enable;
-    changed = true;
-  }
-  if (auto wifi_local_network_ssid =
-          extract_string_field(line, "wifi_local_network_ssid");
-      wifi_local_network_ssid.has_value()) {
-    config.wifi_local_network_ssid = *wifi_local_network_ssid;
-    changed = true;
-  }
-  if (auto wifi_local_network_password =
-          extract_string_field(line, "wifi_local_network_password");
-      wifi_local_network_password.has_value()) {
-    config.wifi_local_network_password = *wifi_local_network_password;
-    changed = true;
-  }
-  if (auto nw_ethernet_card = extract_string_field(line, "nw_ethernet_card");
-      nw_ethernet_card.has_value()) {
-    config.nw_ethernet_card = *nw_ethernet_card;
-    changed = true;
-  }
-  if (auto nw_manual_forwarding_ips =
-          extract_string_field(line, "nw_manual_forwarding_ips");
-      nw_manual_forwarding_ips.has_value()) {
-    config.nw_manual_forwarding_ips = *nw_manual_forwarding_ips;
-    changed = true;
-  }
-  if (auto nw_forward_to_localhost_58xx =
-          extract_bool_field(line, "nw_forward_to_localhost_58xx");
-      nw_forward_to_localhost_58xx.has_value()) {
-    config.nw_forward_to_localhost_58xx = *nw_forward_to_localhost_58xx;
-    changed = true;
-  }
-  if (auto ground_unit_ip = extract_string_field(line, "ground_unit_ip");
-      ground_unit_ip.has_value()) {
-    config.ground_unit_ip = *ground_unit_ip;
-    changed = true;
-  }
-  if (auto air_unit_ip = extract_string_field(line, "air_unit_ip");
-      air_unit_ip.has_value()) {
-    config.air_unit_ip = *air_unit_ip;
-    changed = true;
-  }
-  if (auto video_port = extract_int_field(line, "video_port");
-      video_port.has_value()) {
-    config.video_port = *video_port;
-    changed = true;
-  }
-  if (auto telemetry_port = extract_int_field(line, "telemetry_port");
-      telemetry_port.has_value()) {
-    config.telemetry_port = *telemetry_port;
-    changed = true;
-  }
-  if (auto disable_microhard_detection =
-          extract_bool_field(line, "disable_microhard_detection");
-      disable_microhard_detection.has_value()) {
-    config.disable_microhard_detection = *disable_microhard_detection;
-    changed = true;
-  }
-  if (auto force_microhard = extract_bool_field(line, "force_microhard");
-      force_microhard.has_value()) {
-    config.force_microhard = *force_microhard;
-    changed = true;
-  }
-  if (auto microhard_username = extract_string_field(line, "microhard_username");
-      microhard_username.has_value()) {
-    config.microhard_username = *microhard_username;
+  if (is_x20_platform() && config.run_mode.value_or("") != "air") {
+    config.run_mode = "air";
     changed = true;
+    effects |= kSettingEffectHostname;
   }
-  if (auto microhard_password = extract_string_field(line, "microhard_password");
-      microhard_password.has_value()) {
-    config.microhard_password = *microhard_password;
-    changed = true;
+
+  bool ok = true;
+  if (changed) {
+    ok = write_sysutil_config(config);
   }
-  if (auto microhard_ip_air = extract_string_field(line, "microhard_ip_air");
-      microhard_ip_air.has_value()) {
-    config.microhard_ip_air = *microhard_ip_air;
-    changed = true;
+  // Camera and service effects only run through sysutil.settings.transaction;
+  // plain updates keep their historical side effects.
+  if (ok && (effects & kSettingEffectDebug)) {
+    const bool restart_openhd =
+        !config.disable_openhd_service.value_or(false);
+    (void)apply_openhd_debug_marker(config.debug_enabled, restart_openhd);
   }
-  if (auto microhard_ip_ground =
-          extract_string_field(line, "microhard_ip_ground");
-      microhard_ip_ground.has_value()) {
-    config.microhard_ip_ground = *microhard_ip_ground;
-    changed = true;
+  if (ok && (effects & kSettingEffectHostname)) {
+    apply_hostname_if_enabled();
   }
-  if (auto microhard_ip_range =
-          extract_string_field(line, "microhard_ip_range");
-      microhard_ip_range.has_value()) {
-    config.microhard_ip_range = *microhard_ip_range;
-    changed = true;
+
+  out.field("ok", ok).end_object().end_line();
+}
+
+void handle_settings_transaction(const ParsedMessage& request,
+                                 JsonWriter& out) {
+  out.begin_object().field("type", "sysutil.settings.transaction.response");
+  const auto raw_changes = request.get_raw("changes");
+  const ParsedMessage changes(raw_changes.value_or(std::string_view()),
+                              request.encoding());
+  if (!raw_changes || !changes.valid()) {
+    out.field("ok", false)
+        .field("message", "missing changes object")
+        .end_object()
+        .end_line();
+    return;
   }
-  if (auto microhard_video_port =
-          extract_int_field(line, "microhard_video_port");
-      microhard_video_port.has_value()) {
-    config.microhard_video_port = *microhard_video_port;
-    changed = true;
+  SysutilConfig original;
+  if (load_sysutil_config(original) == ConfigLoadResult::Error) {
+    out.field("ok", false)
+        .field("message", "config read failed")
+        .end_object()
+        .end_line();
+    return;
   }
-  if (auto microhard_telemetry_port =
-          extract_int_field(line, "microhard_telemetry_port");
-      microhard_telemetry_port.has_value()) {
-    config.microhard_telemetry_port = *microhard_telemetry_port;
-    changed = true;
+
+  // Validate every change against a scratch copy; nothing is persisted or
+  // run unless all of them are accepted.
+  SysutilConfig config = original;
+  bool has_errors = false;
+  for (std::size_t i = 0; i < changes.size(); ++i) {
+    const char* error = apply_transaction_change(changes, i, config);
+    if (!error) {
+      continue;
+    }
+    if (!has_errors) {
+      out.field("ok", false).begin_array("errors");
+      has_errors = true;
+    }
+    out.begin_object()
+        .field("key", changes.key_at(i))
+        .field("message", error)
+        .end_object();
   }
-  if (auto gen_enable_last_known_position =
-          extract_bool_field(line, "gen_enable_last_known_position");
-      gen_enable_last_known_position.has_value()) {
-    config.gen_enable_last_known_position = *gen_enable_last_known_position;
-    changed = true;
+  if (has_errors) {
+    out.end_array().end_object().end_line();
+    return;
   }
-  if (auto gen_rf_metrics_level =
-          extract_int_field(line, "gen_rf_metrics_level");
-      gen_rf_metrics_level.has_value()) {
-    config.gen_rf_metrics_level = *gen_rf_metrics_level;
-    changed = true;
+  if (is_x20_platform()) {
+    config.run_mode = "air";
   }
-  if (auto disable_openhd_service =
-          extract_bool_field(line, "disable_openhd_service");
-      disable_openhd_service.has_value()) {
-    config.disable_openhd_service = *disable_openhd_service;
-    changed = true;
+
+  unsigned effects = kSettingEffectNone;
+  std::size_t changed = 0;
+  for (const ConfigField& field : kConfigFields) {
+    if (!config_field_equal(original, config, field)) {
+      ++changed;
+      effects |= field.effects;
+    }
   }
-  if (auto debug = extract_bool_field(line, "debug"); debug.has_value()) {
-    config.debug_enabled = *debug;
-    changed = true;
-    debug_changed = true;
-  } else if (auto debug_enabled =
-                 extract_bool_field(line, "debug_enabled");
-             debug_enabled.has_value()) {
-    config.debug_enabled = *debug_enabled;
-    changed = true;
-    debug_changed = true;
+  if (changed > 0 && !write_sysutil_config(config)) {
+    out.field("ok", false)
+        .field("message", "config write failed")
+        .end_object()
+        .end_line();
+    return;
   }
 
-  if (is_x20_platform() && config.run_mode.value_or("") != "air") {
-    config.run_mode = "air";
-    changed = true;
-    hostname_related_change = true;
+  // Side effects run once each, in dependency order: the camera overlay and
+  // hostname only need the new config; the debug marker must exist before
+  // services (re)start, and OpenHD restarts at most once.
+  bool reboot_required = false;
+  if (effects & kSettingEffectCamera) {
+    reboot_required = apply_camera_config_if_needed();
   }
-
-  bool ok = true;
-  if (changed) {
-    ok = write_sysutil_config(config);
+  if (effects & kSettingEffectHostname) {
+    apply_hostname_if_enabled();
   }
-  if (ok && debug_changed) {
-    const bool restart_openhd =
-        !config.disable_openhd_service.value_or(false);
+  if (effects & kSettingEffectService) {
+    // Writes the debug marker from the new config itself; a plain start
+    // would leave a running OpenHD on the old debug setting.
+    start_openhd_services_if_needed((effects & kSettingEffectDebug) != 0);
+  } else if (effects & kSettingEffectDebug) {
+    const bool restart_openhd = !config.disable_openhd_service.value_or(false);
     (void)apply_openhd_debug_marker(config.debug_enabled, restart_openhd);
   }
-  if (ok && hostname_related_change) {
-    apply_hostname_if_enabled();
-  }
 
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.settings.update.response\",\"ok\":"
-      << (ok ? "true" : "false") << "}\n";
-  return out.str();
+  out.field("ok", true)
+      .field("changed", changed)
+      .begin_array("effects");
+  static constexpr std::pair<unsigned, const char*> kEffectNames[] = {
+      {kSettingEffectCamera, "camera"},
+      {kSettingEffectHostname, "hostname"},
+      {kSettingEffectDebug, "debug"},
+      {kSettingEffectService, "service"},
+  };
+  for (const auto& [effect, name] : kEffectNames) {
+    if (effects & effect) {
+      out.value(name);
+    }
+  }
+  out.end_array()
+      .field("reboot_required", reboot_required)
+      .end_object()
+      .end_line();
 }
 
-std::string handle_camera_setup_request(const std::string& line) {
+void handle_camera_setup_request(const ParsedMessage& request,
+                                 JsonWriter& out) {
+  out.begin_object().field("type", "sysutil.camera.setup.response");
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
   if (load_result == ConfigLoadResult::Error) {
-    return "{\"type\":\"sysutil.camera.setup.response\",\"ok\":false}\n";
+    out.field("ok", false).end_object().end_line();
+    return;
   }
 
-  auto camera_type = extract_int_field(line, "camera_type");
+  auto camera_type = request.get_int("camera_type");
   if (!camera_type.has_value()) {
-    return "{\"type\":\"sysutil.camera.setup.response\",\"ok\":false,\"message\":\"missing camera_type\"}\n";
+    out.field("ok", false)
+        .field("message", "missing camera_type")
+        .end_object()
+        .end_line();
+    return;
   }
 
   config.camera_type = normalize_camera_type(*camera_type);
   if (!write_sysutil_config(config)) {
-    return "{\"type\":\"sysutil.camera.setup.response\",\"ok\":false,\"message\":\"config write failed\"}\n";
+    out.field("ok", false)
+        .field("message", "config write failed")
+        .end_object()
+        .end_line();
+    return;
   }
 
   set_status("camera_setup", "Camera setup requested",
@@ -777,10 +684,35 @@ std::string handle_camera_setup_request(const std::string& line) {
     set_status("reboot", "Reboot initiated",
                "Rebooting after camera setup.");
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    (void)flush_persisted_files();
     std::system("reboot");
   }).detach();
 
-  return "{\"type\":\"sysutil.camera.setup.response\",\"ok\":true,\"applied\":false,\"message\":\"queued\"}\n";
+  out.field("ok", true)
+      .field("applied", false)
+      .field("message", "queued")
+      .end_object()
+      .end_line();
+}
+
+// Registers the settings and camera setup request handlers with the dispatcher.
+void register_settings_handlers() {
+  // The response depends on the config and, through run_mode, on X20.
+  register_cached_request_handler(
+      "sysutil.settings.request",
+      [](const ParsedMessage& request, JsonWriter& out) {
+        build_settings_response(request, out);
+      },
+      [] {
+        return sysutil_config_snapshot()->generation * 2 +
+               (is_x20_platform() ? 1 : 0);
+      });
+  register_request_handler("sysutil.settings.update", handle_settings_update,
+                           "config");
+  register_request_handler("sysutil.settings.transaction",
+                           handle_settings_transaction, "config");
+  register_request_handler("sysutil.camera.setup.request",
+                           handle_camera_setup_request, "config");
 }
 
 }  // namespace sysutil
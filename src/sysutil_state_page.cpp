@@ -0,0 +1,195 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#include "sysutil_state_page.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "sysutil_settings.h"
+
+namespace sysutil {
+namespace {
+
+// Guards the shadow copy and the mapping. The seqlock needs a single writer;
+// status, platform, config and update changes arrive on different threads.
+std::mutex g_page_mutex;
+StatePageData g_shadow;
+StatePage* g_page = nullptr;
+// run_mode as configured; the page shows the effective mode, which also
+// depends on the platform.
+std::string g_configured_run_mode;
+
+template <std::size_t N>
+void copy_text(char (&dest)[N], std::string_view text) {
+  const std::size_t length = std::min(text.size(), N - 1);
+  std::memcpy(dest, text.data(), length);
+  std::memset(dest + length, 0, N - length);
+}
+
+void bump_locked(StateModule module) {
+  ++g_shadow.generations[static_cast<std::size_t>(module)];
+}
+
+// Recomputes the effective run mode. Returns true when it changed. Caller
+// holds g_page_mutex.
+bool update_run_mode_locked() {
+  const std::string run_mode =
+      effective_run_mode(g_configured_run_mode, g_shadow.platform_type);
+  if (run_mode == g_shadow.run_mode) {
+    return false;
+  }
+  copy_text(g_shadow.run_mode, run_mode);
+  return true;
+}
+
+// Writes the shadow copy to the page under the seqlock. Caller holds
+// g_page_mutex.
+void flush_locked() {
+  if (g_page == nullptr) {
+    return;
+  }
+  const std::uint32_t sequence =
+      g_page->sequence.load(std::memory_order_relaxed);
+  g_page->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&g_page->data, &g_shadow, sizeof(g_shadow));
+  g_page->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+}  // namespace
+
+bool init_state_page() {
+  std::lock_guard<std::mutex> lock(g_page_mutex);
+  if (g_page != nullptr) {
+    return true;
+  }
+  const std::filesystem::path path(kStatePagePath);
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  // Built under a temp name and renamed, so a reader never maps a page whose
+  // header is still being written.
+  const std::string temp_path = path.string() + ".tmp";
+  const int fd =
+      ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "[sysutils] Unable to create " << temp_path << '\n';
+    return false;
+  }
+  void* mapping = MAP_FAILED;
+  if (::ftruncate(fd, sizeof(StatePage)) == 0) {
+    mapping = ::mmap(nullptr, sizeof(StatePage), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "[sysutils] Unable to map " << temp_path << '\n';
+    ::unlink(temp_path.c_str());
+    return false;
+  }
+  auto* page = new (mapping) StatePage{};
+  page->magic = kStatePageMagic;
+  page->version = kStatePageVersion;
+  page->size = sizeof(StatePage);
+  g_shadow.running = 1;
+  g_page = page;
+  flush_locked();
+  if (::rename(temp_path.c_str(), kStatePagePath) != 0) {
+    std::cerr << "[sysutils] Unable to publish " << kStatePagePath << '\n';
+    ::munmap(mapping, sizeof(StatePage));
+    ::unlink(temp_path.c_str());
+    g_page = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void close_state_page() {
+  std::lock_guard<std::mutex> lock(g_page_mutex);
+  if (g_page == nullptr) {
+    return;
+  }
+  g_shadow.running = 0;
+  flush_locked();
+  ::munmap(g_page, sizeof(StatePage));
+  g_page = nullptr;
+  ::unlink(kStatePagePath);
+}
+
+void state_page_set_status(const StatusSnapshot& status) {
+  std::lock_guard<std::mutex> lock(g_page_mutex);
+  g_shadow.has_status = status.has_data ? 1 : 0;
+  g_shadow.has_error = status.has_error ? 1 : 0;
+  g_shadow.severity = status.severity;
+  g_shadow.status_updated_ms = status.updated_ms;
+  copy_text(g_shadow.status_type, status.type);
+  copy_text(g_shadow.state, status.state);
+  copy_text(g_shadow.description, status.description);
+  copy_text(g_shadow.message, status.message);
+  bump_locked(StateModule::Status);
+  flush_locked();
+}
+
+void state_page_set_platform(int platform_type) {
+  std::lock_guard<std::mutex> lock(g_page_mutex);
+  g_shadow.platform_type = platform_type;
+  bump_locked(StateModule::Platform);
+  // X20 forces air regardless of the configured mode.
+  if (update_run_mode_locked()) {
+    bump_locked(StateModule::Config);
+  }
+  flush_locked();
+}
+
+void state_page_set_config(std::string_view run_mode) {
+  std::lock_guard<std::mutex> lock(g_page_mutex);
+  g_configured_run_mode = run_mode;
+  update_run_mode_locked();
+  bump_locked(StateModule::Config);
+  flush_locked();
+}
+
+void state_page_set_updating(bool updating) {
+  std::lock_guard<std::mutex> lock(g_page_mutex);
+  g_shadow.updating = updating ? 1 : 0;
+  bump_locked(StateModule::Update);
+  flush_locked();
+}
+
+void state_page_bump(StateModule module) {
+  std::lock_guard<std::mutex> lock(g_page_mutex);
+  bump_locked(module);
+  flush_locked();
+}
+
+}  // namespace sysutil
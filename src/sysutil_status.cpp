@@ -24,19 +24,120 @@
 #include "sysutil_status.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cctype>
+#include <cstring>
+#include <functional>
 #include <iostream>
-#include <sstream>
+#include <mutex>
 #include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#include "sysutil_protocol.h"
+#include "sysutil_dispatch.h"
+#include "sysutil_events.h"
 #include "sysutil_led.h"
+#include "sysutil_persist.h"
+#include "sysutil_protocol.h"
+#include "sysutil_state_page.h"
 
 namespace sysutil {
 namespace {
 
-StatusSnapshot g_status;
+// Sources that have not reported for this long stop taking part in the
+// aggregate, except for the most recent one.
+constexpr std::uint64_t kStatusTtlMs = 30000;
+// Source of OpenHD status messages that do not name one.
+constexpr const char* kOpenhdSource = "openhd";
+// OpenHD can send indicator.status many times a second. Its changes are
+// published at most once per tick, the latest state winning.
+constexpr std::uint64_t kCoalesceMs = 50;
+
+// Sources beyond this evict the one that reported least recently.
+constexpr std::size_t kMaxStatusSources = 16;
+
+// Fixed-size copy of one source. Strings are NUL-terminated and truncated to
+// fit.
+struct StatusRecord {
+  bool has_data = false;
+  bool has_error = false;
+  int severity = 0;
+  std::uint64_t updated_ms = 0;
+  char source[32] = {};
+  char type[32] = {};
+  char state[64] = {};
+  char description[128] = {};
+  char message[256] = {};
+};
+
+// Latest status per source and the aggregate shown on the LEDs.
+struct StatusTable {
+  // The worst active source, or an empty record before the first status.
+  StatusRecord aggregate;
+  std::uint32_t source_count = 0;
+  // In the order the sources first reported.
+  StatusRecord sources[kMaxStatusSources];
+};
+
+static_assert(std::is_trivially_copyable<StatusTable>::value,
+              "the seqlock copies published tables with memcpy");
+
+// Published through a seqlock like the state page: g_status_sequence is odd
+// while the writer copies g_status_shadow into g_status, and readers retry
+// a copy that overlapped one. Readers take no lock and writers never
+// allocate to publish.
+std::atomic<std::uint32_t> g_status_sequence{0};
+StatusTable g_status;
+
+// Serializes writers (socket thread, update worker, request workers): the
+// seqlock needs a single writer, and the LEDs and status events must follow
+// the order the tables were published in. Guards g_sources, the shadow
+// table and the timer state.
+std::mutex g_status_write_mutex;
+std::vector<StatusSnapshot> g_sources;
+StatusTable g_status_shadow;
+// The aggregate last handed to the LEDs, state page and subscribers.
+StatusSnapshot g_published_aggregate;
+// steady_now_ms() of the last publish, for coalescing.
+std::uint64_t g_last_publish_ms = 0;
+// A coalesced change is waiting for the next tick.
+bool g_publish_deferred = false;
+// The newest history entry belongs to that deferred change and is replaced
+// by later changes of the same source within the tick.
+bool g_history_deferred = false;
+// True while the timer is due; the notifier runs when this becomes true.
+bool g_timer_pending = false;
+std::function<void()> g_timer_notifier;
+
+// Recent statuses, so errors that flash by during boot can still be read
+// after a client connects. Entries hold fixed-size text, so recording one
+// never allocates.
+constexpr std::size_t kHistoryCapacity = 64;
+constexpr const char* kHistoryFile =
+    "/Config/openhd/sysutil_status_history.json";
+
+struct HistoryEntry {
+  std::uint64_t updated_ms = 0;
+  int severity = 0;
+  bool has_error = false;
+  // Loaded from the file saved at the last shutdown.
+  bool previous_boot = false;
+  char source[32] = {};
+  char state[64] = {};
+  char description[128] = {};
+  char message[256] = {};
+};
+
+// Guards the ring; held only to copy an entry in or to format the history.
+std::mutex g_history_mutex;
+std::array<HistoryEntry, kHistoryCapacity> g_history;
+// Entries recorded so far; the newest lives at (g_history_count - 1) %
+// kHistoryCapacity.
+std::uint64_t g_history_count = 0;
 
 std::uint64_t now_ms() {
   using namespace std::chrono;
@@ -45,21 +146,29 @@ std::uint64_t now_ms() {
           .count());
 }
 
-std::string to_lower(std::string value) {
-  std::transform(value.begin(), value.end(), value.begin(),
-                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-  return value;
+// Monotonic milliseconds for expiry and coalescing; unrelated to the epoch.
+std::uint64_t steady_now_ms() {
+  using namespace std::chrono;
+  return static_cast<std::uint64_t>(
+      duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Case-insensitive substring search without a lowercase copy; needle must
+// be lowercase.
+bool contains_lower(std::string_view haystack, std::string_view needle) {
+  return std::search(haystack.begin(), haystack.end(), needle.begin(),
+                     needle.end(), [](char a, char b) {
+                       return std::tolower(static_cast<unsigned char>(a)) == b;
+                     }) != haystack.end();
 }
 
 bool contains_error_marker(const std::string& value) {
   if (value.empty()) {
     return false;
   }
-  const auto lower = to_lower(value);
-  return lower.find("error") != std::string::npos ||
-         lower.find("fail") != std::string::npos ||
-         lower.find("fatal") != std::string::npos ||
-         lower.find("panic") != std::string::npos;
+  return contains_lower(value, "error") || contains_lower(value, "fail") ||
+         contains_lower(value, "fatal") || contains_lower(value, "panic");
 }
 
 bool compute_has_error(const StatusSnapshot& status) {
@@ -74,66 +183,369 @@ bool compute_has_error(const StatusSnapshot& status) {
   return false;
 }
 
-void update_status(const std::string& type,
+// Truncates to fit. A cut never splits a UTF-8 sequence: it moves back while
+// the first dropped byte is a continuation byte (10xxxxxx).
+template <std::size_t N>
+void copy_text(char (&dest)[N], std::string_view text) {
+  std::size_t length = std::min(text.size(), N - 1);
+  if (length < text.size()) {
+    while (length > 0 &&
+           (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80) {
+      --length;
+    }
+  }
+  std::memcpy(dest, text.data(), length);
+  dest[length] = '\0';
+}
+
+// Caller holds g_history_mutex.
+void push_history_locked(const HistoryEntry& entry) {
+  g_history[g_history_count % kHistoryCapacity] = entry;
+  ++g_history_count;
+}
+
+// A deferred change replaces the entry of an earlier deferred change of the
+// same source, so a flood leaves one entry per tick. Caller holds
+// g_status_write_mutex.
+void record_history(const StatusSnapshot& status, bool deferred) {
+  HistoryEntry entry;
+  entry.updated_ms = status.updated_ms;
+  entry.severity = status.severity;
+  entry.has_error = status.has_error;
+  copy_text(entry.source, status.source);
+  copy_text(entry.state, status.state);
+  copy_text(entry.description, status.description);
+  copy_text(entry.message, status.message);
+  std::lock_guard<std::mutex> lock(g_history_mutex);
+  HistoryEntry& newest =
+      g_history[(g_history_count + kHistoryCapacity - 1) % kHistoryCapacity];
+  if (deferred && g_history_deferred && g_history_count != 0 &&
+      std::strcmp(newest.source, entry.source) == 0) {
+    newest = entry;
+    return;
+  }
+  push_history_locked(entry);
+  g_history_deferred = deferred;
+}
+
+// Writes the entries newer than since_ms, oldest first.
+void append_history_json(JsonWriter& out, std::uint64_t since_ms) {
+  std::lock_guard<std::mutex> lock(g_history_mutex);
+  const std::uint64_t first =
+      g_history_count > kHistoryCapacity ? g_history_count - kHistoryCapacity
+                                         : 0;
+  out.begin_array("entries");
+  for (std::uint64_t i = first; i < g_history_count; ++i) {
+    const HistoryEntry& entry = g_history[i % kHistoryCapacity];
+    if (entry.updated_ms <= since_ms) {
+      continue;
+    }
+    out.begin_object()
+        .field("updated_ms", entry.updated_ms)
+        .field("source", std::string_view(entry.source))
+        .field("severity", entry.severity)
+        .field("has_error", entry.has_error)
+        .field("state", std::string_view(entry.state))
+        .field("description", std::string_view(entry.description))
+        .field("message", std::string_view(entry.message));
+    if (entry.previous_boot) {
+      out.field("previous_boot", true);
+    }
+    out.end_object();
+  }
+  out.end_array();
+}
+
+// Orders sources for the aggregate: errors first, then higher severity.
+int status_rank(const StatusSnapshot& status) {
+  return std::max(status.severity, status.has_error ? 2 : 0);
+}
+
+// True when both snapshots would drive the LEDs the same way.
+bool same_display(const StatusSnapshot& a, const StatusSnapshot& b) {
+  return a.has_data == b.has_data && a.has_error == b.has_error &&
+         a.severity == b.severity && a.source == b.source &&
+         a.type == b.type && a.state == b.state &&
+         a.description == b.description && a.message == b.message;
+}
+
+// The worst source wins; among equals the most recent one.
+const StatusSnapshot* select_aggregate(
+    const std::vector<StatusSnapshot>& sources) {
+  const StatusSnapshot* worst = nullptr;
+  for (const auto& status : sources) {
+    if (worst == nullptr || status_rank(status) > status_rank(*worst) ||
+        (status_rank(status) == status_rank(*worst) &&
+         status.received_ms >= worst->received_ms)) {
+      worst = &status;
+    }
+  }
+  return worst;
+}
+
+// Drops sources older than kStatusTtlMs, keeping the most recent source so
+// there is always something to show. Returns the delay until the next
+// source expires, or 0 when none will. now is steady_now_ms(). Caller holds
+// g_status_write_mutex.
+std::uint64_t expire_locked(std::uint64_t now) {
+  if (g_sources.size() < 2) {
+    return 0;
+  }
+  const auto newest = std::max_element(
+      g_sources.begin(), g_sources.end(),
+      [](const StatusSnapshot& a, const StatusSnapshot& b) {
+        return a.received_ms < b.received_ms;
+      });
+  const std::uint64_t newest_ms = newest->received_ms;
+  g_sources.erase(
+      std::remove_if(g_sources.begin(), g_sources.end(),
+                     [&](const StatusSnapshot& status) {
+                       return status.received_ms != newest_ms &&
+                              status.received_ms + kStatusTtlMs <= now;
+                     }),
+      g_sources.end());
+  std::uint64_t delay = 0;
+  for (const auto& status : g_sources) {
+    if (status.received_ms == newest_ms) {
+      continue;
+    }
+    const std::uint64_t remaining = status.received_ms + kStatusTtlMs - now;
+    if (delay == 0 || remaining < delay) {
+      delay = remaining;
+    }
+  }
+  return delay;
+}
+
+void fill_record(StatusRecord& record, const StatusSnapshot& status) {
+  record.has_data = status.has_data;
+  record.has_error = status.has_error;
+  record.severity = status.severity;
+  record.updated_ms = status.updated_ms;
+  copy_text(record.source, status.source);
+  copy_text(record.type, status.type);
+  copy_text(record.state, status.state);
+  copy_text(record.description, status.description);
+  copy_text(record.message, status.message);
+}
+
+// Copies g_status_shadow to g_status under the seqlock. Caller holds
+// g_status_write_mutex.
+void store_table_locked() {
+  const std::uint32_t sequence =
+      g_status_sequence.load(std::memory_order_relaxed);
+  g_status_sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&g_status, &g_status_shadow, sizeof(g_status));
+  g_status_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Copies a consistent published table, retrying while a writer is storing.
+void load_table(StatusTable& out) {
+  for (;;) {
+    const std::uint32_t before =
+        g_status_sequence.load(std::memory_order_acquire);
+    if (before & 1u) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::memcpy(&out, &g_status, sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (g_status_sequence.load(std::memory_order_relaxed) == before) {
+      return;
+    }
+  }
+}
+
+void format_status(JsonWriter& out, const StatusTable& table,
+                   const char* type, bool with_sources) {
+  const StatusRecord& status = table.aggregate;
+  out.begin_object()
+      .field("type", type)
+      .field("has_data", status.has_data)
+      .field("has_error", status.has_error)
+      .field("severity", status.severity)
+      .field("updated_ms", status.updated_ms)
+      .field("source", std::string_view(status.source))
+      .field("state", std::string_view(status.state))
+      .field("description", std::string_view(status.description))
+      .field("message", std::string_view(status.message));
+  if (with_sources) {
+    out.begin_array("sources");
+    for (std::uint32_t i = 0; i < table.source_count; ++i) {
+      const StatusRecord& source = table.sources[i];
+      out.begin_object()
+          .field("source", std::string_view(source.source))
+          .field("has_error", source.has_error)
+          .field("severity", source.severity)
+          .field("updated_ms", source.updated_ms)
+          .field("state", std::string_view(source.state))
+          .field("description", std::string_view(source.description))
+          .field("message", std::string_view(source.message))
+          .end_object();
+    }
+    out.end_array();
+  }
+  out.end_object().end_line();
+}
+
+std::string format_status_event(const StatusTable& table) {
+  JsonWriter out;
+  format_status(out, table, "sysutil.status.event", false);
+  return out.take();
+}
+
+// Publishes g_sources and re-renders the LEDs when the aggregate changed.
+// Caller holds g_status_write_mutex.
+void publish_locked(std::uint64_t now) {
+  g_last_publish_ms = now;
+  g_publish_deferred = false;
+  g_history_deferred = false;
+  const StatusSnapshot* aggregate = select_aggregate(g_sources);
+  g_status_shadow.source_count =
+      static_cast<std::uint32_t>(g_sources.size());
+  for (std::size_t i = 0; i < g_sources.size(); ++i) {
+    fill_record(g_status_shadow.sources[i], g_sources[i]);
+  }
+  fill_record(g_status_shadow.aggregate,
+              aggregate != nullptr ? *aggregate : StatusSnapshot{});
+  store_table_locked();
+  if (aggregate == nullptr) {
+    return;
+  }
+  // A change to a source that does not win leaves LEDs, page and
+  // subscribers alone.
+  const bool same = same_display(g_published_aggregate, *aggregate);
+  if (same && g_published_aggregate.updated_ms == aggregate->updated_ms) {
+    return;
+  }
+  g_published_aggregate = *aggregate;
+  state_page_set_status(g_published_aggregate);
+  if (!same) {
+    update_leds_from_status(g_published_aggregate);
+  }
+  publish_event(EventTopic::Status,
+                [] { return format_status_event(g_status_shadow); });
+}
+
+// True when a new report only repeats what the source said last time.
+bool same_report(const StatusSnapshot& a, const StatusSnapshot& b) {
+  return a.severity == b.severity && a.type == b.type &&
+         a.state == b.state && a.description == b.description &&
+         a.message == b.message;
+}
+
+// Returns the delay until the timer must run next, or 0. now is
+// steady_now_ms(). Caller holds g_status_write_mutex.
+std::uint64_t timer_delay_locked(std::uint64_t expiry_delay,
+                                 std::uint64_t now) {
+  if (!g_publish_deferred) {
+    return expiry_delay;
+  }
+  const std::uint64_t due = g_last_publish_ms + kCoalesceMs;
+  const std::uint64_t publish_delay = due > now ? due - now : 1;
+  return expiry_delay == 0 ? publish_delay
+                           : std::min(expiry_delay, publish_delay);
+}
+
+// Replaces the entry of next.source (or of every OpenHD source when
+// clear_openhd is set) and republishes. With coalesce set, a change within
+// kCoalesceMs of the last publish waits for the timer instead.
+void publish_status(StatusSnapshot next, bool clear_openhd = false,
+                    bool coalesce = false) {
+  const std::uint64_t now = next.received_ms;
+  std::lock_guard<std::mutex> lock(g_status_write_mutex);
+  const auto existing =
+      std::find_if(g_sources.begin(), g_sources.end(),
+                   [&next](const StatusSnapshot& status) {
+                     return status.source == next.source;
+                   });
+  // Repeats only keep the source from expiring.
+  if (!clear_openhd && existing != g_sources.end() &&
+      same_report(*existing, next)) {
+    existing->updated_ms = next.updated_ms;
+    existing->received_ms = now;
+    return;
+  }
+  if (!next.has_error) {
+    next.has_error = compute_has_error(next);
+  }
+  const bool defer = coalesce && now < g_last_publish_ms + kCoalesceMs;
+  record_history(next, defer);
+  if (clear_openhd) {
+    g_sources.erase(std::remove_if(g_sources.begin(), g_sources.end(),
+                                   [](const StatusSnapshot& status) {
+                                     return status.type != "sysutil.local";
+                                   }),
+                    g_sources.end());
+  }
+  const auto slot =
+      std::find_if(g_sources.begin(), g_sources.end(),
+                   [&next](const StatusSnapshot& status) {
+                     return status.source == next.source;
+                   });
+  if (slot != g_sources.end()) {
+    *slot = std::move(next);
+  } else {
+    if (g_sources.size() == kMaxStatusSources) {
+      g_sources.erase(std::min_element(
+          g_sources.begin(), g_sources.end(),
+          [](const StatusSnapshot& a, const StatusSnapshot& b) {
+            return a.received_ms < b.received_ms;
+          }));
+    }
+    g_sources.push_back(std::move(next));
+  }
+  const std::uint64_t expiry_delay = expire_locked(now);
+  if (defer) {
+    g_publish_deferred = true;
+  } else {
+    publish_locked(now);
+  }
+  if (timer_delay_locked(expiry_delay, now) != 0 && !g_timer_pending) {
+    g_timer_pending = true;
+    if (g_timer_notifier) {
+      g_timer_notifier();
+    }
+  }
+}
+
+void update_status(const std::string& type, const std::string& source,
                    const std::optional<std::string>& state,
                    const std::optional<std::string>& description,
                    const std::optional<std::string>& message,
-                   const std::optional<int>& severity) {
-  g_status.type = type;
-  g_status.state = state.value_or("");
-  g_status.description = description.value_or("");
-  g_status.message = message.value_or("");
-  g_status.severity = severity.value_or(0);
-  g_status.updated_ms = now_ms();
-  g_status.has_data = true;
-  g_status.has_error = compute_has_error(g_status);
-  update_leds_from_status(g_status);
-}
-
-std::string json_escape(const std::string& input) {
-  std::string out;
-  out.reserve(input.size());
-  for (char c : input) {
-    switch (c) {
-      case '\\':
-        out += "\\\\";
-        break;
-      case '"':
-        out += "\\\"";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
-        break;
-      case '\t':
-        out += "\\t";
-        break;
-      default:
-        out += c;
-        break;
-    }
-  }
-  return out;
+                   const std::optional<int>& severity,
+                   bool coalesce = false) {
+  StatusSnapshot next;
+  next.type = type;
+  next.source = source;
+  next.state = state.value_or("");
+  next.description = description.value_or("");
+  next.message = message.value_or("");
+  next.severity = severity.value_or(0);
+  next.updated_ms = now_ms();
+  next.received_ms = steady_now_ms();
+  next.has_data = true;
+  publish_status(std::move(next), false, coalesce);
 }
 
 }  // namespace
 
 // Parses and logs status/indicator messages from OpenHD.
-void handle_status_message(const std::string& line) {
-  if (line.empty()) {
+void handle_status_message(const ParsedMessage& request) {
+  if (request.text().empty()) {
     return;
   }
 
-  auto type = extract_string_field(line, "type");
-  auto state = extract_string_field(line, "state");
-  auto description = extract_string_field(line, "description");
-  auto message = extract_string_field(line, "message");
-  auto severity = extract_int_field(line, "severity");
+  auto type = request.get_string("type");
+  auto state = request.get_string("state");
+  auto description = request.get_string("description");
+  auto message = request.get_string("message");
+  auto severity = request.get_int("severity");
+  const auto source = request.get_string("source").value_or(kOpenhdSource);
 
   if (type && *type == "indicator.set") {
-    update_status(*type, state, description, message, severity);
+    update_status(*type, source, state, description, message, severity);
     std::string display;
     if (description) {
       display = *description;
@@ -146,33 +558,37 @@ void handle_status_message(const std::string& line) {
     } else {
       display = "UNKNOWN";
     }
-    std::cout << "OpenHD state: " << display << std::endl;
+    std::cout << "OpenHD state: " << display << '\n';
     return;
   }
 
   if (type && *type == "indicator.status") {
-    update_status(*type, state, description, message, severity);
+    update_status(*type, source, state, description, message, severity,
+                  true);
     return;
   }
 
   if (type && *type == "indicator.clear") {
-    g_status = StatusSnapshot{};
-    g_status.type = *type;
-    g_status.state = "CLEAR";
-    g_status.description = "OpenHD status cleared.";
-    g_status.updated_ms = now_ms();
-    g_status.has_data = true;
-    g_status.has_error = false;
-    update_leds_from_status(g_status);
-    std::cout << "OpenHD state cleared." << std::endl;
+    StatusSnapshot cleared;
+    cleared.type = *type;
+    cleared.source = source;
+    cleared.state = "CLEAR";
+    cleared.description = "OpenHD status cleared.";
+    cleared.updated_ms = now_ms();
+    cleared.received_ms = steady_now_ms();
+    cleared.has_data = true;
+    cleared.has_error = false;
+    publish_status(std::move(cleared), true);
+    std::cout << "OpenHD state cleared.\n";
     return;
   }
 
   if (state || description || message || severity) {
     if (type) {
-      update_status(*type, state, description, message, severity);
+      update_status(*type, source, state, description, message, severity);
     } else {
-      update_status("status.update", state, description, message, severity);
+      update_status("status.update", source, state, description, message,
+                    severity);
     }
     std::string display;
     if (description) {
@@ -185,39 +601,128 @@ void handle_status_message(const std::string& line) {
       display = *message;
     }
     if (!display.empty()) {
-      std::cout << "OpenHD state: " << display << std::endl;
+      std::cout << "OpenHD state: " << display << '\n';
     } else {
-      std::cout << "OpenHD state update received." << std::endl;
+      std::cout << "OpenHD state update received.\n";
     }
     return;
   }
 
-  std::cout << "OpenHD message: " << line << std::endl;
+  std::cout << "OpenHD message: " << request.text() << '\n';
+}
+
+StatusSnapshot status_snapshot() {
+  StatusTable table;
+  load_table(table);
+  const StatusRecord& record = table.aggregate;
+  StatusSnapshot status;
+  status.has_data = record.has_data;
+  status.has_error = record.has_error;
+  status.severity = record.severity;
+  status.updated_ms = record.updated_ms;
+  status.source = record.source;
+  status.type = record.type;
+  status.state = record.state;
+  status.description = record.description;
+  status.message = record.message;
+  return status;
+}
+
+void build_status_response(JsonWriter& out) {
+  StatusTable table;
+  load_table(table);
+  format_status(out, table, "sysutil.status.response", true);
+}
+
+std::chrono::milliseconds run_status_timer() {
+  std::lock_guard<std::mutex> lock(g_status_write_mutex);
+  const std::uint64_t now = steady_now_ms();
+  const std::size_t before = g_sources.size();
+  const std::uint64_t expiry_delay = expire_locked(now);
+  if (g_sources.size() != before ||
+      (g_publish_deferred && now >= g_last_publish_ms + kCoalesceMs)) {
+    publish_locked(now);
+  }
+  const std::uint64_t delay = timer_delay_locked(expiry_delay, now);
+  g_timer_pending = delay != 0;
+  return std::chrono::milliseconds(delay);
+}
+
+void set_status_timer_notifier(std::function<void()> notifier) {
+  std::lock_guard<std::mutex> lock(g_status_write_mutex);
+  g_timer_notifier = std::move(notifier);
+  // Reports that arrived before the notifier existed may already be due.
+  if (g_timer_notifier && g_timer_pending) {
+    g_timer_notifier();
+  }
 }
 
-bool is_status_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.status.request";
+void build_status_history_response(const ParsedMessage& request,
+                                   JsonWriter& out) {
+  out.begin_object()
+      .field("type", "sysutil.status.history.response")
+      .field("ok", true)
+      .field("capacity", kHistoryCapacity);
+  append_history_json(out, request.get_uint64("since_ms").value_or(0));
+  out.end_object().end_line();
 }
 
-std::string build_status_response() {
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.status.response\",\"has_data\":"
-      << (g_status.has_data ? "true" : "false")
-      << ",\"has_error\":" << (g_status.has_error ? "true" : "false")
-      << ",\"severity\":" << g_status.severity
-      << ",\"updated_ms\":" << g_status.updated_ms
-      << ",\"state\":\"" << json_escape(g_status.state)
-      << "\",\"description\":\"" << json_escape(g_status.description)
-      << "\",\"message\":\"" << json_escape(g_status.message) << "\"}\n";
-  return out.str();
+void load_status_history() {
+  std::string content;
+  if (!read_persisted_file(kHistoryFile, content)) {
+    return;
+  }
+  const ParsedMessage saved(content);
+  const auto entries = saved.get_raw_list("entries");
+  if (!entries) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(g_history_mutex);
+  // The saved entries go in front of anything recorded since startup.
+  const std::uint64_t kept = std::min<std::uint64_t>(
+      g_history_count, kHistoryCapacity);
+  std::array<HistoryEntry, kHistoryCapacity> current;
+  for (std::uint64_t i = 0; i < kept; ++i) {
+    current[i] = g_history[(g_history_count - kept + i) % kHistoryCapacity];
+  }
+  g_history_count = 0;
+  const std::size_t skip = entries->size() + kept > kHistoryCapacity
+                               ? entries->size() + kept - kHistoryCapacity
+                               : 0;
+  for (std::size_t i = skip; i < entries->size(); ++i) {
+    const ParsedMessage item((*entries)[i]);
+    HistoryEntry entry;
+    entry.updated_ms = item.get_uint64("updated_ms").value_or(0);
+    entry.severity = item.get_int("severity").value_or(0);
+    entry.has_error = item.get_bool("has_error").value_or(false);
+    entry.previous_boot = true;
+    copy_text(entry.source, item.get_string("source").value_or(""));
+    copy_text(entry.state, item.get_string("state").value_or(""));
+    copy_text(entry.description, item.get_string("description").value_or(""));
+    copy_text(entry.message, item.get_string("message").value_or(""));
+    push_history_locked(entry);
+  }
+  for (std::uint64_t i = 0; i < kept; ++i) {
+    push_history_locked(current[i]);
+  }
+}
+
+bool save_status_history() {
+  JsonWriter out;
+  out.begin_object();
+  append_history_json(out, 0);
+  out.end_object().end_line();
+  return write_file_atomic(kHistoryFile, out.take());
 }
 
 void set_status(const std::string& state,
                 const std::string& description,
                 const std::string& message,
                 int severity) {
-  update_status("sysutil.local", state, description, message, severity);
+  // Local steps report under their state, so partitioning, updates,
+  // services and camera setup each keep their own entry.
+  update_status("sysutil.local", state, state, description, message,
+                severity);
 }
 
 // Returns true when the path exists and points to a regular file.
@@ -229,4 +734,15 @@ bool is_regular_file(const std::string& path) {
   return S_ISREG(st.st_mode);
 }
 
+// Registers the status request handlers with the dispatcher.
+void register_status_handlers() {
+  register_request_handler(
+      "sysutil.status.request",
+      [](const ParsedMessage&, JsonWriter& out) {
+        build_status_response(out);
+      });
+  register_request_handler("sysutil.status.history",
+                           build_status_history_response);
+}
+
 }  // namespace sysutil
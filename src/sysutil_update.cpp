@@ -45,7 +45,11 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "sysutil_dispatch.h"
+#include "sysutil_events.h"
+#include "sysutil_persist.h"
 #include "sysutil_protocol.h"
+#include "sysutil_state_page.h"
 #include "sysutil_status.h"
 
 namespace sysutil {
@@ -181,10 +185,34 @@ void log_line(std::ofstream& log, const std::string& line) {
   log << line << std::endl;
 }
 
+void publish_update_event(const std::string& step, const std::string& message,
+                          int severity) {
+  publish_event(EventTopic::Update, [&] {
+    JsonWriter out;
+    out.begin_object()
+        .field("type", "sysutil.update.event")
+        .field("is_updating", g_updating.load())
+        .field("step", step)
+        .field("message", message)
+        .field("severity", severity)
+        .end_object()
+        .end_line();
+    return out.take();
+  });
+}
+
 void set_update_status(const std::string& step,
                        const std::string& message,
                        int severity = 0) {
   set_status("updating", step, message, severity);
+  publish_update_event(step, message, severity);
+}
+
+// Marks the update run as finished and tells subscribers.
+void finish_update(const std::string& step) {
+  g_updating = false;
+  state_page_set_updating(false);
+  publish_update_event(step, "", 0);
 }
 
 bool is_valid_package_name(const std::string& name) {
@@ -699,8 +727,9 @@ std::optional<std::string> read_port_from_json(
   std::ostringstream buffer;
   buffer << file.rdbuf();
   const auto content = buffer.str();
+  const ParsedMessage parsed(content);
   for (const auto& key : keys) {
-    auto value = extract_string_field(content, key);
+    auto value = parsed.get_string(key);
     if (value && !value->empty()) {
       return *value;
     }
@@ -861,6 +890,7 @@ void run_update() {
   if (g_updating.exchange(true)) {
     return;
   }
+  state_page_set_updating(true);
 
   std::ofstream log(select_log_path(), std::ios::app);
   log_line(log, "----- OpenHD update started -----");
@@ -876,7 +906,7 @@ void run_update() {
   if (!source) {
     set_update_status("No update", "No update payloads found.");
     log_line(log, "No update payloads found");
-    g_updating = false;
+    finish_update("No update");
     remove_hold_file();
     return;
   }
@@ -888,7 +918,7 @@ void run_update() {
     if (!temp_dir) {
       set_update_status("Update failed", "Unable to extract update.zip", 2);
       log_line(log, "Failed to extract update.zip");
-      g_updating = false;
+      finish_update("Update failed");
       remove_hold_file();
       g_last_failure = std::chrono::steady_clock::now();
       return;
@@ -908,6 +938,7 @@ void run_update() {
       set_update_status("Reboot", "Rebooting after update.");
       log_line(log, "Rebooting after update");
       std::this_thread::sleep_for(std::chrono::milliseconds(800));
+      (void)flush_persisted_files();
       (void)run_shell_command("reboot");
     }
   } else {
@@ -918,7 +949,7 @@ void run_update() {
 
   unmask_openhd_services();
   remove_hold_file();
-  g_updating = false;
+  finish_update(success ? "Update complete" : "Update failed");
 }
 
 void update_worker() {
@@ -955,35 +986,36 @@ void init_update_worker() {
   g_update_thread.detach();
 }
 
-bool is_update_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.update.request";
-}
-
-std::string handle_update_request(const std::string& line) {
-  (void)line;
+void handle_update_request(const ParsedMessage& request, JsonWriter& out) {
+  (void)request;
   g_update_requested = true;
   g_update_cv.notify_all();
-  return "{\"type\":\"sysutil.update.response\",\"accepted\":true}\n";
-}
-
-bool is_update_info_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == kUpdateInfoRequestType;
+  out.begin_object()
+      .field("type", "sysutil.update.response")
+      .field("accepted", true)
+      .end_object()
+      .end_line();
 }
 
-std::string handle_update_info_request(const std::string& line) {
-  (void)line;
-  std::ostringstream out;
-  out << "{\"type\":\"" << kUpdateInfoResponseType << "\""
-      << ",\"ok\":true"
-      << ",\"is_updating\":" << (g_updating.load() ? "true" : "false")
-      << "}\n";
-  return out.str();
+void handle_update_info_request(const ParsedMessage& request,
+                                JsonWriter& out) {
+  (void)request;
+  out.begin_object()
+      .field("type", kUpdateInfoResponseType)
+      .field("ok", true)
+      .field("is_updating", g_updating.load())
+      .end_object()
+      .end_line();
 }
 
 bool is_updating() {
   return g_updating.load();
 }
 
+// Registers the update request handlers with the dispatcher.
+void register_update_handlers() {
+  register_request_handler("sysutil.update.request", handle_update_request);
+  register_request_handler(kUpdateInfoRequestType, handle_update_info_request);
+}
+
 }  // namespace sysutil
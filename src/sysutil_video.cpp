@@ -24,6 +24,7 @@
 #include "sysutil_video.h"
 #include "sysutil_config.h"
 #include "sysutil_debug.h"
+#include "sysutil_dispatch.h"
 #include "sysutil_platform.h"
 #include "sysutil_protocol.h"
 #include "sysutil_status.h"
@@ -123,11 +124,11 @@ bool is_ground_mode() {
         return false;
     }
 
-    SysutilConfig config;
-    const auto load_result = load_sysutil_config(config);
-    if (load_result == ConfigLoadResult::Error) {
+    const auto snapshot = sysutil_config_snapshot();
+    if (snapshot->result == ConfigLoadResult::Error) {
         return false;
     }
+    const SysutilConfig& config = snapshot->config;
 
     // Keep startup behavior aligned with settings responses:
     // when run_mode is missing or invalid, treat the unit as ground by default.
@@ -256,6 +257,14 @@ bool start_unit(const std::string& unit) {
     return run_cmd("systemctl start " + unit);
 }
 
+// Starts the unit, or restarts it when it is already running.
+bool restart_unit(const std::string& unit) {
+    if (!has_systemctl()) {
+        return false;
+    }
+    return run_cmd("systemctl restart " + unit);
+}
+
 bool ensure_openhd_glide_early_unit() {
     std::error_code ec;
     const std::string unit_dir = "/etc/systemd/system";
@@ -577,13 +586,14 @@ void start_openhd_glide_early_if_needed() {
     }
 }
 
-void start_openhd_services_if_needed() {
+void start_openhd_services_if_needed(bool restart_openhd) {
     const bool systemd_ok = has_systemctl();
     const bool ground = is_ground_mode();
     const bool rockchip = is_rockchip_platform();
 
-    SysutilConfig config;
-    if (load_sysutil_config(config) == ConfigLoadResult::Loaded) {
+    const auto snapshot = sysutil_config_snapshot();
+    if (snapshot->result == ConfigLoadResult::Loaded) {
+        const SysutilConfig& config = snapshot->config;
         (void)apply_openhd_debug_marker(config.debug_enabled, false);
         if (config.disable_openhd_service.value_or(false)) {
             apply_openhd_service_disable();
@@ -597,7 +607,8 @@ void start_openhd_services_if_needed() {
         return;
     }
 
-    const bool openhd_started = start_unit("openhd.service");
+    const bool openhd_started = restart_openhd ? restart_unit("openhd.service")
+                                               : start_unit("openhd.service");
     if (!openhd_started) {
         std::cerr << "Failed to start openhd.service" << std::endl;
     }
@@ -616,13 +627,8 @@ void start_openhd_services_if_needed() {
                           qopenhd_requested, rockchip);
 }
 
-bool is_video_request(const std::string& line) {
-    auto type = extract_string_field(line, "type");
-    return type.has_value() && *type == "sysutil.video.request";
-}
-
-std::string handle_video_request(const std::string& line) {
-    auto action = extract_string_field(line, "action").value_or("start");
+void handle_video_request(const ParsedMessage& request, JsonWriter& out) {
+    auto action = request.get_string("action").value_or("start");
     bool ok = true;
     std::string pipeline = "ground_default";
     if (!is_ground_mode()) {
@@ -658,12 +664,19 @@ std::string handle_video_request(const std::string& line) {
         ok = false;
     }
 
-    std::ostringstream out;
-    out << "{\"type\":\"sysutil.video.response\",\"ok\":"
-        << (ok ? "true" : "false")
-        << ",\"action\":\"" << action
-        << "\",\"pipeline\":\"" << pipeline << "\"}\n";
-    return out.str();
+    out.begin_object()
+        .field("type", "sysutil.video.response")
+        .field("ok", ok)
+        .field("action", action)
+        .field("pipeline", pipeline)
+        .end_object()
+        .end_line();
+}
+
+// Registers the video request handlers with the dispatcher.
+void register_video_handlers() {
+    register_request_handler("sysutil.video.request", handle_video_request,
+                             "services");
 }
 
 } // namespace sysutil
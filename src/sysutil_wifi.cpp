@@ -24,7 +24,9 @@
 #include "sysutil_wifi.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstdint>
 #include <cstring>
 #include <cerrno>
 #include <cstdlib>
@@ -32,12 +34,14 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <optional>
 #include <poll.h>
 #include <regex>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <array>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -48,8 +52,12 @@
 #include <utility>
 
 #include "platforms_generated.h"
+#include "sysutil_dispatch.h"
+#include "sysutil_events.h"
+#include "sysutil_persist.h"
 #include "sysutil_platform.h"
 #include "sysutil_protocol.h"
+#include "sysutil_state_page.h"
 #include "sysutil_config.h"
 
 namespace sysutil {
@@ -76,8 +84,13 @@ constexpr int kArtosynTunnelPort = 3;
 constexpr int kArtosynTunnelRxRate = 30000;
 constexpr int kArtosynTunnelTxRate = 40000;
 
+// Detected cards. Refreshes run on worker threads, so readers take a copy
+// under the mutex instead of holding a reference across a swap.
+std::mutex g_wifi_mutex;
 std::vector<WifiCardInfo> g_wifi_cards;
 bool g_wifi_initialized = false;
+// Bumped whenever a refresh finds a different card list.
+std::atomic<std::uint64_t> g_wifi_generation{0};
 bool is_openhd_wifibroadcast_type(const std::string& type_name);
 bool file_exists(const std::string& path);
 std::optional<std::string> read_file(const std::string& path);
@@ -171,10 +184,11 @@ std::string normalized_run_mode(std::string mode) {
 }
 
 std::string artosyn_run_mode() {
-  SysutilConfig cfg;
-  if (load_sysutil_config(cfg) == ConfigLoadResult::Loaded &&
-      cfg.run_mode.has_value() && !cfg.run_mode->empty()) {
-    return normalized_run_mode(*cfg.run_mode);
+  const auto snapshot = sysutil_config_snapshot();
+  const auto& run_mode = snapshot->config.run_mode;
+  if (snapshot->result == ConfigLoadResult::Loaded && run_mode.has_value() &&
+      !run_mode->empty()) {
+    return normalized_run_mode(*run_mode);
   }
   return "ground";
 }
@@ -648,34 +662,6 @@ bool contains_after_uppercase(const std::string& haystack,
   return to_upper(haystack).find(to_upper(needle)) != std::string::npos;
 }
 
-std::string json_escape(const std::string& input) {
-  std::string out;
-  out.reserve(input.size());
-  for (char c : input) {
-    switch (c) {
-      case '\\':
-        out += "\\\\";
-        break;
-      case '"':
-        out += "\\\"";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
-        break;
-      case '\t':
-        out += "\\t";
-        break;
-      default:
-        out += c;
-        break;
-    }
-  }
-  return out;
-}
-
 bool write_all(int fd, const std::string& data) {
   std::size_t offset = 0;
   while (offset < data.size()) {
@@ -772,56 +758,50 @@ std::optional<std::string> send_openhd_control(const std::string& payload) {
   return response;
 }
 
-void append_cards_json(std::ostringstream& out,
+void append_cards_json(JsonWriter& out, const char* key,
                        const std::vector<WifiCardInfo>& cards) {
-  out << "[";
-  for (std::size_t i = 0; i < cards.size(); ++i) {
-    const auto& card = cards[i];
-    if (i > 0) {
-      out << ",";
-    }
-    out << "{\"interface\":\"" << json_escape(card.interface_name) << "\""
-        << ",\"driver\":\"" << json_escape(card.driver_name) << "\""
-        << ",\"phy_index\":" << card.phy_index
-        << ",\"mac\":\"" << json_escape(card.mac) << "\""
-        << ",\"vendor_id\":\"" << json_escape(card.vendor_id) << "\""
-        << ",\"device_id\":\"" << json_escape(card.device_id) << "\""
-        << ",\"detected_type\":\"" << json_escape(card.detected_type) << "\""
-        << ",\"override_type\":\"" << json_escape(card.override_type) << "\""
-        << ",\"type\":\"" << json_escape(card.effective_type) << "\""
-        << ",\"tx_power\":\"" << json_escape(card.tx_power) << "\""
-        << ",\"tx_power_high\":\"" << json_escape(card.tx_power_high) << "\""
-        << ",\"tx_power_low\":\"" << json_escape(card.tx_power_low) << "\""
-        << ",\"card_name\":\"" << json_escape(card.card_name) << "\""
-        << ",\"power_mode\":\"" << json_escape(card.power_mode) << "\""
-        << ",\"power_level\":\"" << json_escape(card.power_level) << "\""
-        << ",\"power_lowest\":\"" << json_escape(card.power_lowest) << "\""
-        << ",\"power_low\":\"" << json_escape(card.power_low) << "\""
-        << ",\"power_mid\":\"" << json_escape(card.power_mid) << "\""
-        << ",\"power_high\":\"" << json_escape(card.power_high) << "\""
-        << ",\"power_min\":\"" << json_escape(card.power_min) << "\""
-        << ",\"power_max\":\"" << json_escape(card.power_max) << "\""
-        << ",\"artosyn_daemon_running\":"
-        << (card.artosyn_daemon_running ? "true" : "false")
-        << ",\"artosyn_daemon_detail\":\""
-        << json_escape(card.artosyn_daemon_detail) << "\""
-        << ",\"artosyn_tunnel_running\":"
-        << (card.artosyn_tunnel_running ? "true" : "false")
-        << ",\"artosyn_tunnel_detail\":\""
-        << json_escape(card.artosyn_tunnel_detail) << "\""
-        << ",\"disabled\":" << (card.disabled ? "true" : "false")
-        << "}";
-  }
-  out << "]";
+  out.begin_array(key);
+  for (const auto& card : cards) {
+    out.begin_object()
+        .field("interface", card.interface_name)
+        .field("driver", card.driver_name)
+        .field("phy_index", card.phy_index)
+        .field("mac", card.mac)
+        .field("vendor_id", card.vendor_id)
+        .field("device_id", card.device_id)
+        .field("detected_type", card.detected_type)
+        .field("override_type", card.override_type)
+        .field("type", card.effective_type)
+        .field("tx_power", card.tx_power)
+        .field("tx_power_high", card.tx_power_high)
+        .field("tx_power_low", card.tx_power_low)
+        .field("card_name", card.card_name)
+        .field("power_mode", card.power_mode)
+        .field("power_level", card.power_level)
+        .field("power_lowest", card.power_lowest)
+        .field("power_low", card.power_low)
+        .field("power_mid", card.power_mid)
+        .field("power_high", card.power_high)
+        .field("power_min", card.power_min)
+        .field("power_max", card.power_max)
+        .field("artosyn_daemon_running", card.artosyn_daemon_running)
+        .field("artosyn_daemon_detail", card.artosyn_daemon_detail)
+        .field("artosyn_tunnel_running", card.artosyn_tunnel_running)
+        .field("artosyn_tunnel_detail", card.artosyn_tunnel_detail)
+        .field("disabled", card.disabled)
+        .end_object();
+  }
+  out.end_array();
 }
 
 std::unordered_map<std::string, std::string> load_overrides() {
   std::unordered_map<std::string, std::string> overrides;
-  std::ifstream file(kOverridesPath);
-  if (!file) {
+  std::string content;
+  if (!read_persisted_file(kOverridesPath, content)) {
     log_wifi(std::string("override file not found or unreadable: ") + kOverridesPath);
     return overrides;
   }
+  std::istringstream file(content);
   std::string line;
   while (std::getline(file, line)) {
     line = trim_copy(line);
@@ -843,21 +823,12 @@ std::unordered_map<std::string, std::string> load_overrides() {
 }
 
 bool write_overrides(const std::unordered_map<std::string, std::string>& data) {
-  std::error_code ec;
-  std::filesystem::create_directories(
-      std::filesystem::path(kOverridesPath).parent_path(), ec);
-  if (ec) {
-    return false;
-  }
-  std::ofstream file(kOverridesPath);
-  if (!file) {
-    return false;
-  }
+  std::ostringstream file;
   file << "# OpenHD SysUtils Wi-Fi overrides\n";
   for (const auto& entry : data) {
     file << entry.first << "=" << entry.second << "\n";
   }
-  return static_cast<bool>(file);
+  return schedule_file_write(kOverridesPath, file.str());
 }
 
 bool has_tx_power_values(const WifiTxPowerOverride& entry) {
@@ -928,62 +899,6 @@ std::vector<std::string> extract_array_objects(const std::string& content,
   return objects;
 }
 
-std::optional<std::string> extract_object_field(const std::string& content,
-                                                const std::string& key) {
-  const std::string needle = "\"" + key + "\"";
-  auto key_pos = content.find(needle);
-  if (key_pos == std::string::npos) {
-    return std::nullopt;
-  }
-  auto colon_pos = content.find(':', key_pos + needle.size());
-  if (colon_pos == std::string::npos) {
-    return std::nullopt;
-  }
-  auto obj_pos = content.find('{', colon_pos + 1);
-  if (obj_pos == std::string::npos) {
-    return std::nullopt;
-  }
-
-  bool in_string = false;
-  bool escape = false;
-  int depth = 0;
-  std::size_t obj_start = std::string::npos;
-  for (std::size_t pos = obj_pos; pos < content.size(); ++pos) {
-    char ch = content[pos];
-    if (in_string) {
-      if (escape) {
-        escape = false;
-      } else if (ch == '\\') {
-        escape = true;
-      } else if (ch == '"') {
-        in_string = false;
-      }
-      continue;
-    }
-    if (ch == '"') {
-      in_string = true;
-      continue;
-    }
-    if (ch == '{') {
-      if (depth == 0) {
-        obj_start = pos;
-      }
-      ++depth;
-      continue;
-    }
-    if (ch == '}') {
-      if (depth > 0) {
-        --depth;
-        if (depth == 0 && obj_start != std::string::npos) {
-          return content.substr(obj_start, pos - obj_start + 1);
-        }
-      }
-      continue;
-    }
-  }
-  return std::nullopt;
-}
-
 std::string to_string_if(int value) {
   if (value <= 0) {
     return "";
@@ -1014,18 +929,18 @@ std::vector<WifiCardProfile> load_wifi_card_profiles() {
   }
 
   for (const auto& object : objects) {
-    auto vendor = extract_string_field(object, "vendor_id");
-    auto device = extract_string_field(object, "device_id");
+    const ParsedMessage entry(object);
+    auto vendor = entry.get_string("vendor_id");
+    auto device = entry.get_string("device_id");
     if (!vendor || !device) {
       continue;
     }
     WifiCardProfile profile{};
     profile.vendor_id = normalize_id(*vendor);
     profile.device_id = normalize_id(*device);
-    profile.chipset =
-        normalize_chipset(extract_string_field(object, "chipset").value_or(""));
-    profile.name = extract_string_field(object, "name").value_or("");
-    profile.power_mode = to_upper(extract_string_field(object, "power_mode").value_or("mw"));
+    profile.chipset = normalize_chipset(entry.get_string("chipset").value_or(""));
+    profile.name = entry.get_string("name").value_or("");
+    profile.power_mode = to_upper(entry.get_string("power_mode").value_or("mw"));
     if (profile.power_mode == "FIXED") {
       profile.min_mw = 0;
       profile.max_mw = 0;
@@ -1036,25 +951,26 @@ std::vector<WifiCardProfile> load_wifi_card_profiles() {
       profiles.push_back(profile);
       continue;
     }
-    profile.min_mw = extract_int_field(object, "min_mw").value_or(0);
-    profile.max_mw = extract_int_field(object, "max_mw").value_or(0);
-    profile.lowest_mw = extract_int_field(object, "lowest").value_or(0);
-    profile.low_mw = extract_int_field(object, "low").value_or(0);
-    profile.mid_mw = extract_int_field(object, "mid").value_or(0);
-    profile.high_mw = extract_int_field(object, "high").value_or(0);
+    profile.min_mw = entry.get_int("min_mw").value_or(0);
+    profile.max_mw = entry.get_int("max_mw").value_or(0);
+    profile.lowest_mw = entry.get_int("lowest").value_or(0);
+    profile.low_mw = entry.get_int("low").value_or(0);
+    profile.mid_mw = entry.get_int("mid").value_or(0);
+    profile.high_mw = entry.get_int("high").value_or(0);
 
-    if (auto levels = extract_object_field(object, "levels_mw")) {
+    if (auto levels_mw = entry.get_raw("levels_mw")) {
+      const ParsedMessage levels(*levels_mw);
       if (profile.lowest_mw <= 0) {
-        profile.lowest_mw = extract_int_field(*levels, "lowest").value_or(0);
+        profile.lowest_mw = levels.get_int("lowest").value_or(0);
       }
       if (profile.low_mw <= 0) {
-        profile.low_mw = extract_int_field(*levels, "low").value_or(0);
+        profile.low_mw = levels.get_int("low").value_or(0);
       }
       if (profile.mid_mw <= 0) {
-        profile.mid_mw = extract_int_field(*levels, "mid").value_or(0);
+        profile.mid_mw = levels.get_int("mid").value_or(0);
       }
       if (profile.high_mw <= 0) {
-        profile.high_mw = extract_int_field(*levels, "high").value_or(0);
+        profile.high_mw = levels.get_int("high").value_or(0);
       }
     }
 
@@ -1134,12 +1050,13 @@ const WifiCardProfile* find_wifi_profile(
 
 std::unordered_map<std::string, WifiTxPowerOverride> load_tx_power_overrides() {
   std::unordered_map<std::string, WifiTxPowerOverride> overrides;
-  std::ifstream file(kTxPowerOverridesPath);
-  if (!file) {
+  std::string content;
+  if (!read_persisted_file(kTxPowerOverridesPath, content)) {
     log_wifi(std::string("TX power override file not found or unreadable: ") +
              kTxPowerOverridesPath);
     return overrides;
   }
+  std::istringstream file(content);
   std::string line;
   while (std::getline(file, line)) {
     line = trim_copy(line);
@@ -1193,16 +1110,7 @@ std::unordered_map<std::string, WifiTxPowerOverride> load_tx_power_overrides() {
 
 bool write_tx_power_overrides(
     const std::unordered_map<std::string, WifiTxPowerOverride>& data) {
-  std::error_code ec;
-  std::filesystem::create_directories(
-      std::filesystem::path(kTxPowerOverridesPath).parent_path(), ec);
-  if (ec) {
-    return false;
-  }
-  std::ofstream file(kTxPowerOverridesPath);
-  if (!file) {
-    return false;
-  }
+  std::ostringstream file;
   file << "# OpenHD SysUtils Wi-Fi TX power overrides\n";
   for (const auto& entry : data) {
     if (!has_tx_power_values(entry.second)) {
@@ -1235,7 +1143,7 @@ bool write_tx_power_overrides(
       file << iface << ".tx_power_low=" << values.tx_power_low << "\n";
     }
   }
-  return static_cast<bool>(file);
+  return schedule_file_write(kTxPowerOverridesPath, file.str());
 }
 
 std::string driver_to_type(const std::string& driver_name) {
@@ -1797,7 +1705,7 @@ void refresh_wifi_info_impl() {
   const auto overrides = load_overrides();
   const auto tx_overrides = load_tx_power_overrides();
   const auto profiles = load_wifi_card_profiles();
-  g_wifi_cards = detect_wifi_cards(overrides, tx_overrides, profiles);
+  auto cards = detect_wifi_cards(overrides, tx_overrides, profiles);
   auto artosyn_cards = detect_artosyn_cards();
   if (!artosyn_cards.empty()) {
     log_wifi("Detected " + std::to_string(artosyn_cards.size()) +
@@ -1824,14 +1732,45 @@ void refresh_wifi_info_impl() {
                ").");
     }
   }
-  g_wifi_cards.insert(g_wifi_cards.end(), artosyn_cards.begin(),
-                      artosyn_cards.end());
-  log_wifi_detection_summary(g_wifi_cards);
+  cards.insert(cards.end(), artosyn_cards.begin(), artosyn_cards.end());
+  log_wifi_detection_summary(cards);
+  std::lock_guard<std::mutex> lock(g_wifi_mutex);
+  // The retry timer refreshes every few seconds while no card is found;
+  // only a different card list counts as a change.
+  if (g_wifi_initialized && cards == g_wifi_cards) {
+    return;
+  }
+  g_wifi_cards.swap(cards);
   g_wifi_initialized = true;
+  ++g_wifi_generation;
+  state_page_bump(StateModule::Wifi);
+  publish_event(EventTopic::Wifi, [] {
+    JsonWriter out;
+    out.begin_object().field("type", "sysutil.wifi.event");
+    append_cards_json(out, "cards", g_wifi_cards);
+    out.end_object().end_line();
+    return out.take();
+  });
 }
 
 }  // namespace
 
+bool operator==(const WifiCardInfo& a, const WifiCardInfo& b) {
+  const auto fields = [](const WifiCardInfo& card) {
+    return std::tie(card.interface_name, card.driver_name, card.mac,
+                    card.phy_index, card.vendor_id, card.device_id,
+                    card.detected_type, card.override_type,
+                    card.effective_type, card.disabled, card.tx_power,
+                    card.tx_power_high, card.tx_power_low, card.card_name,
+                    card.power_mode, card.power_level, card.power_lowest,
+                    card.power_low, card.power_mid, card.power_high,
+                    card.power_min, card.power_max,
+                    card.artosyn_daemon_running, card.artosyn_daemon_detail,
+                    card.artosyn_tunnel_running, card.artosyn_tunnel_detail);
+  };
+  return fields(a) == fields(b);
+}
+
 void refresh_wifi_info() {
   refresh_wifi_info_impl();
 }
@@ -1841,10 +1780,7 @@ void init_wifi_info() {
 }
 
 bool has_openhd_wifibroadcast_cards() {
-  if (!g_wifi_initialized) {
-    refresh_wifi_info();
-  }
-  for (const auto& card : g_wifi_cards) {
+  for (const auto& card : wifi_cards()) {
     if (card.disabled) {
       continue;
     }
@@ -1855,47 +1791,58 @@ bool has_openhd_wifibroadcast_cards() {
   return false;
 }
 
-const std::vector<WifiCardInfo>& wifi_cards() {
-  if (!g_wifi_initialized) {
-    refresh_wifi_info();
+std::vector<WifiCardInfo> wifi_cards() {
+  {
+    std::lock_guard<std::mutex> lock(g_wifi_mutex);
+    if (g_wifi_initialized) {
+      return g_wifi_cards;
+    }
   }
+  refresh_wifi_info();
+  std::lock_guard<std::mutex> lock(g_wifi_mutex);
   return g_wifi_cards;
 }
 
-bool is_wifi_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.wifi.request";
+std::uint64_t wifi_generation() {
+  return g_wifi_generation.load();
 }
 
-std::string build_wifi_response() {
-  const auto& cards = wifi_cards();
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.wifi.response\",\"ok\":true,\"cards\":";
-  append_cards_json(out, cards);
-  out << "}\n";
-  return out.str();
-}
+namespace {
 
-bool is_wifi_update_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.wifi.update";
+// Writes the cached cards under the lock rather than copying them out.
+void append_current_cards(JsonWriter& out) {
+  std::unique_lock<std::mutex> lock(g_wifi_mutex);
+  if (!g_wifi_initialized) {
+    lock.unlock();
+    refresh_wifi_info();
+    lock.lock();
+  }
+  append_cards_json(out, "cards", g_wifi_cards);
 }
 
-std::string handle_wifi_update(const std::string& line) {
-  auto action = extract_string_field(line, "action").value_or("refresh");
-  const auto iface = extract_string_field(line, "interface");
-  const auto override_type = extract_string_field(line, "override_type");
-  const auto tx_power = extract_string_field(line, "tx_power");
-  const auto tx_power_high = extract_string_field(line, "tx_power_high");
-  const auto tx_power_low = extract_string_field(line, "tx_power_low");
-  const auto card_name = extract_string_field(line, "card_name");
-  const auto power_level = extract_string_field(line, "power_level");
+}  // namespace
+
+void build_wifi_response(JsonWriter& out) {
+  out.begin_object().field("type", "sysutil.wifi.response").field("ok", true);
+  append_current_cards(out);
+  out.end_object().end_line();
+}
+
+void handle_wifi_update(const ParsedMessage& request, JsonWriter& out) {
+  auto action = request.get_string("action").value_or("refresh");
+  const auto iface = request.get_string("interface");
+  const auto override_type = request.get_string("override_type");
+  const auto tx_power = request.get_string("tx_power");
+  const auto tx_power_high = request.get_string("tx_power_high");
+  const auto tx_power_low = request.get_string("tx_power_low");
+  const auto card_name = request.get_string("card_name");
+  const auto power_level = request.get_string("power_level");
   const auto profile_vendor_id =
-      extract_string_field(line, "profile_vendor_id");
+      request.get_string("profile_vendor_id");
   const auto profile_device_id =
-      extract_string_field(line, "profile_device_id");
+      request.get_string("profile_device_id");
   const auto profile_chipset =
-      extract_string_field(line, "profile_chipset");
+      request.get_string("profile_chipset");
 
   bool ok = true;
   auto overrides = load_overrides();
@@ -1988,31 +1935,25 @@ std::string handle_wifi_update(const std::string& line) {
     refresh_wifi_info();
   }
 
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.wifi.update.response\",\"ok\":"
-      << (ok ? "true" : "false")
-      << ",\"action\":\"" << json_escape(action) << "\"";
+  out.begin_object()
+      .field("type", "sysutil.wifi.update.response")
+      .field("ok", ok)
+      .field("action", action);
   if (ok) {
-    out << ",\"cards\":";
-    append_cards_json(out, wifi_cards());
+    append_current_cards(out);
   }
-  out << "}\n";
-  return out.str();
+  out.end_object().end_line();
 }
 
-bool is_link_control_request(const std::string& line) {
-  auto type = extract_string_field(line, "type");
-  return type.has_value() && *type == "sysutil.link.control";
-}
-
-std::string handle_link_control_request(const std::string& line) {
-  const auto iface = extract_string_field(line, "interface");
-  const auto frequency = extract_int_field(line, "frequency_mhz");
-  const auto channel_width = extract_int_field(line, "channel_width_mhz");
-  const auto mcs_index = extract_int_field(line, "mcs_index");
-  const auto tx_power_mw = extract_int_field(line, "tx_power_mw");
-  const auto tx_power_index = extract_int_field(line, "tx_power_index");
-  const auto power_level = extract_string_field(line, "power_level");
+void handle_link_control_request(const ParsedMessage& request,
+                                 JsonWriter& out) {
+  const auto iface = request.get_string("interface");
+  const auto frequency = request.get_int("frequency_mhz");
+  const auto channel_width = request.get_int("channel_width_mhz");
+  const auto mcs_index = request.get_int("mcs_index");
+  const auto tx_power_mw = request.get_int("tx_power_mw");
+  const auto tx_power_index = request.get_int("tx_power_index");
+  const auto power_level = request.get_string("power_level");
 
   std::cerr << "[sysutils] link.control request iface="
             << (iface ? *iface : "")
@@ -2043,43 +1984,44 @@ std::string handle_link_control_request(const std::string& line) {
     ok = false;
     message = "40 MHz channel width is disabled.";
   } else {
-    std::ostringstream request;
-    request << "{\"type\":\"openhd.link.control\"";
+    JsonWriter control;
+    control.begin_object().field("type", "openhd.link.control");
     if (iface && !iface->empty()) {
-      request << ",\"interface\":\"" << json_escape(*iface) << "\"";
+      control.field("interface", *iface);
     }
     if (frequency.has_value()) {
-      request << ",\"frequency_mhz\":" << *frequency;
+      control.field("frequency_mhz", *frequency);
     }
     if (channel_width.has_value()) {
-      request << ",\"channel_width_mhz\":" << *channel_width;
+      control.field("channel_width_mhz", *channel_width);
     }
     if (mcs_index.has_value()) {
-      request << ",\"mcs_index\":" << *mcs_index;
+      control.field("mcs_index", *mcs_index);
     }
     if (tx_power_mw.has_value()) {
-      request << ",\"tx_power_mw\":" << *tx_power_mw;
+      control.field("tx_power_mw", *tx_power_mw);
     }
     if (tx_power_index.has_value()) {
-      request << ",\"tx_power_index\":" << *tx_power_index;
+      control.field("tx_power_index", *tx_power_index);
     }
     if (power_level.has_value()) {
       const auto trimmed = trim_copy(*power_level);
       if (!trimmed.empty()) {
-        request << ",\"power_level\":\"" << json_escape(trimmed) << "\"";
+        control.field("power_level", trimmed);
       }
     }
-    request << "}\n";
+    control.end_object().end_line();
 
-    const auto response = send_openhd_control(request.str());
+    const auto response = send_openhd_control(control.str());
     if (!response) {
       ok = false;
       message = "OpenHD control socket not available.";
       std::cerr << "[sysutils] link.control openhd response: <none>"
                 << std::endl;
     } else {
-      ok = extract_bool_field(*response, "ok").value_or(false);
-      message = extract_string_field(*response, "message").value_or("");
+      const ParsedMessage reply(*response);
+      ok = reply.get_bool("ok").value_or(false);
+      message = reply.get_string("message").value_or("");
       if (message.empty() && !ok) {
         message = "OpenHD rejected the RF update.";
       }
@@ -2088,14 +2030,24 @@ std::string handle_link_control_request(const std::string& line) {
     }
   }
 
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.link.control.response\",\"ok\":"
-      << (ok ? "true" : "false");
+  out.begin_object()
+      .field("type", "sysutil.link.control.response")
+      .field("ok", ok);
   if (!message.empty()) {
-    out << ",\"message\":\"" << json_escape(message) << "\"";
+    out.field("message", message);
   }
-  out << "}\n";
-  return out.str();
+  out.end_object().end_line();
+}
+
+// Registers the Wi-Fi and link control request handlers with the dispatcher.
+void register_wifi_handlers() {
+  register_cached_request_handler(
+      "sysutil.wifi.request",
+      [](const ParsedMessage&, JsonWriter& out) { build_wifi_response(out); },
+      wifi_generation);
+  register_request_handler("sysutil.wifi.update", handle_wifi_update, "wifi");
+  register_request_handler("sysutil.link.control", handle_link_control_request,
+                           "wifi");
 }
 
 }  // namespace sysutil
@@ -0,0 +1,137 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#include "sysutil_worker_pool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sysutil {
+namespace {
+
+struct Lane {
+  std::deque<WorkerJob> jobs;
+  // True while a worker runs a job from this lane.
+  bool running = false;
+};
+
+std::mutex g_pool_mutex;
+std::condition_variable g_pool_cv;
+std::unordered_map<std::string, Lane> g_lanes;
+// Lanes that have queued jobs and no running job, in the order they became
+// runnable. A lane is listed at most once.
+std::deque<std::string> g_ready_lanes;
+std::vector<std::thread> g_workers;
+std::size_t g_queued_jobs = 0;
+std::size_t g_max_queued_jobs = 0;
+bool g_pool_running = false;
+
+void worker_loop() {
+  std::unique_lock<std::mutex> lock(g_pool_mutex);
+  while (true) {
+    g_pool_cv.wait(lock,
+                   [] { return !g_pool_running || !g_ready_lanes.empty(); });
+    if (!g_pool_running) {
+      return;
+    }
+    const std::string name = std::move(g_ready_lanes.front());
+    g_ready_lanes.pop_front();
+    auto& lane = g_lanes[name];
+    WorkerJob job = std::move(lane.jobs.front());
+    lane.jobs.pop_front();
+    lane.running = true;
+    --g_queued_jobs;
+
+    lock.unlock();
+    try {
+      job();
+    } catch (const std::exception& ex) {
+      std::cerr << "[sysutils] worker job on lane " << name
+                << " failed: " << ex.what() << std::endl;
+    }
+    lock.lock();
+
+    auto& finished = g_lanes[name];
+    finished.running = false;
+    if (!finished.jobs.empty()) {
+      g_ready_lanes.push_back(name);
+      g_pool_cv.notify_one();
+    }
+  }
+}
+
+}  // namespace
+
+void start_worker_pool(std::size_t thread_count, std::size_t max_queued_jobs) {
+  std::lock_guard<std::mutex> lock(g_pool_mutex);
+  if (g_pool_running) {
+    return;
+  }
+  g_pool_running = true;
+  g_max_queued_jobs = max_queued_jobs;
+  for (std::size_t i = 0; i < thread_count; ++i) {
+    g_workers.emplace_back(worker_loop);
+  }
+}
+
+bool submit_worker_job(const std::string& lane, WorkerJob job) {
+  std::lock_guard<std::mutex> lock(g_pool_mutex);
+  if (!g_pool_running || g_queued_jobs >= g_max_queued_jobs) {
+    return false;
+  }
+  auto& target = g_lanes[lane];
+  target.jobs.push_back(std::move(job));
+  ++g_queued_jobs;
+  if (!target.running && target.jobs.size() == 1) {
+    g_ready_lanes.push_back(lane);
+    g_pool_cv.notify_one();
+  }
+  return true;
+}
+
+void stop_worker_pool() {
+  {
+    std::lock_guard<std::mutex> lock(g_pool_mutex);
+    if (!g_pool_running) {
+      return;
+    }
+    g_pool_running = false;
+    g_lanes.clear();
+    g_ready_lanes.clear();
+    g_queued_jobs = 0;
+  }
+  g_pool_cv.notify_all();
+  for (auto& worker : g_workers) {
+    worker.join();
+  }
+  g_workers.clear();
+}
+
+}  // namespace sysutil
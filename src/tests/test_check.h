@@ -0,0 +1,68 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Minimal checks for the unit tests: each failed CHECK is printed and counted,
+// and main() returns test_failures() so ctest sees the result.
+
+#ifndef SYSUTIL_TEST_CHECK_H
+#define SYSUTIL_TEST_CHECK_H
+
+#include <iostream>
+
+namespace sysutil {
+namespace test {
+
+inline int& failure_count() {
+  static int failures = 0;
+  return failures;
+}
+
+inline int test_failures() {
+  return failure_count() == 0 ? 0 : 1;
+}
+
+}  // namespace test
+}  // namespace sysutil
+
+#define CHECK(condition)                                                     \
+  do {                                                                       \
+    if (!(condition)) {                                                      \
+      std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK failed: "         \
+                << #condition << std::endl;                                  \
+      ++::sysutil::test::failure_count();                                    \
+    }                                                                        \
+  } while (false)
+
+#define CHECK_EQ(actual, expected)                                           \
+  do {                                                                       \
+    const auto& check_actual = (actual);                                     \
+    const auto& check_expected = (expected);                                 \
+    if (!(check_actual == check_expected)) {                                 \
+      std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK_EQ failed: "      \
+                << #actual << " is " << check_actual << ", expected "        \
+                << check_expected << std::endl;                              \
+      ++::sysutil::test::failure_count();                                    \
+    }                                                                        \
+  } while (false)
+
+#endif  // SYSUTIL_TEST_CHECK_H
@@ -0,0 +1,89 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <stdexcept>
+#include <string>
+
+#include "sysutil_dispatch.h"
+#include "sysutil_protocol.h"
+#include "test_check.h"
+
+namespace sysutil {
+namespace {
+
+// Runs a request the way the socket thread does: the writer leads with the
+// request id before the handler runs.
+std::string run(const std::string& line) {
+  const auto request = ParsedMessage::owning(line);
+  const auto* info = find_request_handler(*request.get_string("type"));
+  JsonWriter writer;
+  if (const auto id = request.get_raw_scalar("id")) {
+    writer.lead_with("id", *id);
+  }
+  run_request_handler(*info, request, writer);
+  return writer.take();
+}
+
+void test_handler_answers_normally() {
+  CHECK(register_request_handler(
+      "test.ok", [](const ParsedMessage&, JsonWriter& out) {
+        out.begin_object().field("type", "test.ok.response").end_object();
+        out.end_line();
+      }));
+  CHECK_EQ(run(R"({"type":"test.ok","id":1})"),
+           std::string(R"({"id":1,"type":"test.ok.response"})" "\n"));
+}
+
+void test_throwing_handler_becomes_error_response() {
+  CHECK(register_request_handler(
+      "test.throw",
+      [](const ParsedMessage&, JsonWriter& out) {
+        // Partial output must not leak into the error response.
+        out.begin_object().field("type", "test.throw.response");
+        throw std::runtime_error("boom");
+      },
+      "test"));
+  CHECK_EQ(run(R"({"type":"test.throw","id":"a"})"),
+           std::string(R"({"id":"a","type":"sysutil.error","ok":false,)"
+                       R"("message":"test.throw failed: boom"})" "\n"));
+}
+
+void test_non_standard_exception_becomes_error_response() {
+  CHECK(register_request_handler(
+      "test.throw_int",
+      [](const ParsedMessage&, JsonWriter&) { throw 42; }));
+  CHECK_EQ(run(R"({"type":"test.throw_int"})"),
+           std::string(R"({"type":"sysutil.error","ok":false,)"
+                       R"("message":"test.throw_int failed: )"
+                       R"(unknown exception"})" "\n"));
+}
+
+}  // namespace
+}  // namespace sysutil
+
+int main() {
+  sysutil::test_handler_answers_normally();
+  sysutil::test_throwing_handler_becomes_error_response();
+  sysutil::test_non_standard_exception_becomes_error_response();
+  return sysutil::test::test_failures();
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <optional>
+#include <string>
+
+#include "sysutil_protocol.h"
+#include "test_check.h"
+
+namespace sysutil {
+namespace {
+
+// Returns the echoed id of {"id":<raw>}, or "(none)".
+std::string raw_id(const std::string& raw) {
+  const auto message = ParsedMessage::owning(R"({"id":)" + raw + "}");
+  const auto id = message.get_raw_scalar("id");
+  return id ? std::string(*id) : std::string("(none)");
+}
+
+void test_raw_scalar_integers() {
+  CHECK_EQ(raw_id("42"), std::string("42"));
+  CHECK_EQ(raw_id("-12"), std::string("-12"));
+  CHECK_EQ(raw_id("0"), std::string("0"));
+  CHECK_EQ(raw_id("-0"), std::string("-0"));
+  CHECK_EQ(raw_id(R"("abc")"), std::string(R"("abc")"));
+}
+
+void test_raw_scalar_rejects_malformed_numbers() {
+  CHECK_EQ(raw_id("-"), std::string("(none)"));
+  CHECK_EQ(raw_id("007"), std::string("(none)"));
+  CHECK_EQ(raw_id("-01"), std::string("(none)"));
+  CHECK_EQ(raw_id("1.5"), std::string("(none)"));
+  CHECK_EQ(raw_id("1e3"), std::string("(none)"));
+}
+
+// Returns get_bool of {"flag":<raw>} as "true", "false" or "(none)".
+std::string flag(const std::string& raw) {
+  const auto message = ParsedMessage::owning(R"({"flag":)" + raw + "}");
+  const auto value = message.get_bool("flag");
+  return value ? (*value ? "true" : "false") : "(none)";
+}
+
+void test_bool_accepts_literals_and_zero_one() {
+  CHECK_EQ(flag("true"), std::string("true"));
+  CHECK_EQ(flag("false"), std::string("false"));
+  CHECK_EQ(flag("1"), std::string("true"));
+  CHECK_EQ(flag("0"), std::string("false"));
+}
+
+void test_bool_rejects_other_numbers() {
+  CHECK_EQ(flag("10"), std::string("(none)"));
+  CHECK_EQ(flag("0.5"), std::string("(none)"));
+  CHECK_EQ(flag("1e3"), std::string("(none)"));
+  CHECK_EQ(flag("-1"), std::string("(none)"));
+}
+
+}  // namespace
+}  // namespace sysutil
+
+int main() {
+  sysutil::test_raw_scalar_integers();
+  sysutil::test_raw_scalar_rejects_malformed_numbers();
+  sysutil::test_bool_accepts_literals_and_zero_one();
+  sysutil::test_bool_rejects_other_numbers();
+  return sysutil::test::test_failures();
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <string>
+
+#include "sysutil_dispatch.h"
+#include "sysutil_events.h"
+#include "sysutil_protocol.h"
+#include "sysutil_wifi.h"
+#include "test_check.h"
+
+namespace sysutil {
+namespace {
+
+std::string request_wifi() {
+  const auto request =
+      ParsedMessage::owning(R"({"type":"sysutil.wifi.request"})");
+  JsonWriter out;
+  run_request_handler(*find_request_handler("sysutil.wifi.request"), request,
+                      out);
+  return out.take();
+}
+
+// The retry timer refreshes while no card is found; refreshes that detect
+// the same cards must keep the cached response and stay silent.
+void test_unchanged_refresh_keeps_cached_line() {
+  int events = 0;
+  set_event_sink([&events](EventTopic, std::string) { ++events; });
+  add_event_subscriber(EventTopic::Wifi);
+  register_wifi_handlers();
+
+  init_wifi_info();
+  const std::uint64_t generation = wifi_generation();
+  const int events_after_init = events;
+  const std::string line = request_wifi();
+
+  refresh_wifi_info();
+  refresh_wifi_info();
+  CHECK_EQ(wifi_generation(), generation);
+  CHECK_EQ(events, events_after_init);
+  CHECK_EQ(request_wifi(), line);
+  set_event_sink(nullptr);
+}
+
+}  // namespace
+}  // namespace sysutil
+
+int main() {
+  sysutil::test_unchanged_refresh_keeps_cached_line();
+  return sysutil::test::test_failures();
+}
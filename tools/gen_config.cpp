@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <clocale>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "gen_json.h"
+
+// -----------------------------------------------------------------------------
+// Schema
+// -----------------------------------------------------------------------------
+
+struct FieldSpec {
+    std::string name;
+    std::string key;
+    std::string type;
+    std::vector<std::string> comment;
+    std::string response = "hidden";
+    std::string has_key;
+    std::shared_ptr<JsonValue> default_value;
+    std::string update = "read_only";
+    std::string alias;
+    bool has_range = false;
+    int min_value = 0;
+    int max_value = 0;
+    int min_length = 0;
+    int max_length = 0;
+    std::vector<std::string> effects;
+};
+
+const JsonValue* find_member(const JsonObject& obj, const std::string& key) {
+    auto it = obj.find(key);
+    return it == obj.end() ? nullptr : it->second.get();
+}
+
+std::string string_member(const JsonObject& obj, const std::string& key,
+                          const std::string& fallback) {
+    const JsonValue* value = find_member(obj, key);
+    if (!value) return fallback;
+    if (!value->is_string()) throw std::runtime_error("'" + key + "' must be a string");
+    return value->as_string();
+}
+
+int int_member(const JsonObject& obj, const std::string& key, int fallback) {
+    const JsonValue* value = find_member(obj, key);
+    if (!value) return fallback;
+    if (!value->is_number()) throw std::runtime_error("'" + key + "' must be a number");
+    return static_cast<int>(value->as_number());
+}
+
+FieldSpec parse_field(const JsonValue& value) {
+    if (!value.is_object()) throw std::runtime_error("field entries must be objects");
+    const auto& obj = value.as_object();
+    FieldSpec field;
+    field.name = string_member(obj, "name", "");
+    if (field.name.empty()) throw std::runtime_error("field without a name");
+    field.key = string_member(obj, "key", field.name);
+    field.type = string_member(obj, "type", "");
+    if (field.type != "bool" && field.type != "int" && field.type != "string") {
+        throw std::runtime_error(field.name + ": unknown type '" + field.type + "'");
+    }
+    if (const JsonValue* comment = find_member(obj, "comment")) {
+        if (comment->is_string()) {
+            field.comment.push_back(comment->as_string());
+        } else if (comment->is_array()) {
+            for (const auto& line : comment->as_array()) {
+                field.comment.push_back(line->as_string());
+            }
+        }
+    }
+
+    const JsonValue* settings = find_member(obj, "settings");
+    if (!settings) return field;
+    const auto& s = settings->as_object();
+    field.response = string_member(s, "response", "hidden");
+    field.has_key = string_member(s, "has_key", "has_" + field.key);
+    field.update = string_member(s, "update", "read_only");
+    field.alias = string_member(s, "alias", "");
+    if (find_member(s, "min") || find_member(s, "max")) {
+        field.has_range = true;
+        field.min_value = int_member(s, "min", 0);
+        field.max_value = int_member(s, "max", 0);
+    }
+    field.min_length = int_member(s, "min_length", 0);
+    field.max_length = int_member(s, "max_length", 0);
+    if (auto it = s.find("default"); it != s.end()) {
+        field.default_value = it->second;
+    }
+    if (const JsonValue* effects = find_member(s, "effects")) {
+        for (const auto& effect : effects->as_array()) {
+            field.effects.push_back(effect->as_string());
+        }
+    }
+
+    static const std::set<std::string> kResponses = {"hidden", "value", "has_flag", "custom"};
+    static const std::set<std::string> kUpdates = {"read_only", "assign", "camera_type", "custom"};
+    static const std::set<std::string> kEffects = {"hostname", "debug", "camera", "service"};
+    if (!kResponses.count(field.response)) {
+        throw std::runtime_error(field.name + ": unknown response '" + field.response + "'");
+    }
+    if (!kUpdates.count(field.update)) {
+        throw std::runtime_error(field.name + ": unknown update '" + field.update + "'");
+    }
+    for (const auto& effect : field.effects) {
+        if (!kEffects.count(effect)) {
+            throw std::runtime_error(field.name + ": unknown effect '" + effect + "'");
+        }
+    }
+    if ((field.response == "value" || field.response == "has_flag") && !field.default_value) {
+        throw std::runtime_error(field.name + ": reported settings need a default");
+    }
+    if (field.update == "camera_type" && field.type != "int") {
+        throw std::runtime_error(field.name + ": camera_type updates need an int field");
+    }
+    if (field.default_value) {
+        const auto& d = *field.default_value;
+        const bool matches = (field.type == "bool" && d.is_bool()) ||
+                             (field.type == "int" && d.is_number()) ||
+                             (field.type == "string" && d.is_string());
+        if (!matches) throw std::runtime_error(field.name + ": default does not match type");
+    }
+    return field;
+}
+
+// -----------------------------------------------------------------------------
+// C++ Code Generator
+// -----------------------------------------------------------------------------
+
+std::string cpp_type(const FieldSpec& field) {
+    if (field.type == "bool") return "bool";
+    if (field.type == "int") return "int";
+    return "std::string";
+}
+
+std::string quoted_or_null(const std::string& value) {
+    return value.empty() ? "nullptr" : "\"" + escape_cpp_string(value) + "\"";
+}
+
+std::string enum_name(const std::string& value) {
+    std::string out;
+    bool upper = true;
+    for (char ch : value) {
+        if (ch == '_') {
+            upper = true;
+            continue;
+        }
+        out += upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(ch))) : ch;
+        upper = false;
+    }
+    return out;
+}
+
+void render_header(const std::vector<FieldSpec>& fields, std::ostream& out) {
+    out << "// Generated by tools/gen_config.cpp from misc/sysutil_config.json. Do not edit by hand.\n";
+    out << "#pragma once\n\n";
+    out << "#include <cstddef>\n";
+    out << "#include <optional>\n";
+    out << "#include <string>\n";
+    out << "#include <string_view>\n\n";
+    out << "namespace sysutil {\n\n";
+
+    out << "struct SysutilConfig {\n";
+    for (const auto& field : fields) {
+        for (const auto& line : field.comment) {
+            out << "  // " << line << "\n";
+        }
+        out << "  std::optional<" << cpp_type(field) << "> " << field.name << ";\n";
+    }
+    out << "};\n\n";
+
+    out << "enum class ConfigFieldType { Bool, Int, String };\n\n";
+    out << "// How sysutil.settings.response reports a field.\n";
+    out << "enum class SettingResponse { Hidden, Value, HasFlag, Custom };\n\n";
+    out << "// How sysutil.settings.update applies a field.\n";
+    out << "enum class SettingUpdate { ReadOnly, Assign, CameraType, Custom };\n\n";
+    out << "// Follow-up work once an update changed the field.\n";
+    out << "enum SettingEffect : unsigned {\n";
+    out << "  kSettingEffectNone = 0,\n";
+    out << "  kSettingEffectHostname = 1u << 0,\n";
+    out << "  kSettingEffectDebug = 1u << 1,\n";
+    out << "  kSettingEffectCamera = 1u << 2,\n";
+    out << "  kSettingEffectService = 1u << 3,\n";
+    out << "};\n\n";
+
+    out << "struct ConfigField {\n";
+    out << "  // Key in config.json and in settings messages.\n";
+    out << "  const char* key;\n";
+    out << "  ConfigFieldType type;\n";
+    out << "  // Exactly one member pointer is set, matching type.\n";
+    out << "  std::optional<bool> SysutilConfig::*bool_member;\n";
+    out << "  std::optional<int> SysutilConfig::*int_member;\n";
+    out << "  std::optional<std::string> SysutilConfig::*string_member;\n";
+    out << "  SettingResponse response;\n";
+    out << "  const char* has_key;\n";
+    out << "  // Reported when the field is unset.\n";
+    out << "  bool default_bool;\n";
+    out << "  int default_int;\n";
+    out << "  const char* default_string;\n";
+    out << "  SettingUpdate update;\n";
+    out << "  // Second request key accepted when key is absent.\n";
+    out << "  const char* update_alias;\n";
+    out << "  // Updates outside these bounds are ignored.\n";
+    out << "  bool has_range;\n";
+    out << "  int min_value;\n";
+    out << "  int max_value;\n";
+    out << "  std::size_t min_length;\n";
+    out << "  // 0 means unlimited.\n";
+    out << "  std::size_t max_length;\n";
+    out << "  unsigned effects;\n";
+    out << "};\n\n";
+
+    out << "// Fields in declaration order; config.json and the settings response\n";
+    out << "// follow this order.\n";
+    out << "inline constexpr ConfigField kConfigFields[] = {\n";
+    for (const auto& field : fields) {
+        const std::string member = "&SysutilConfig::" + field.name;
+        bool default_bool = false;
+        int default_int = 0;
+        std::string default_string;
+        if (field.default_value) {
+            if (field.type == "bool") default_bool = field.default_value->as_bool();
+            if (field.type == "int") default_int = static_cast<int>(field.default_value->as_number());
+            if (field.type == "string") default_string = field.default_value->as_string();
+        }
+        std::string effects;
+        for (const auto& effect : field.effects) {
+            if (!effects.empty()) effects += " | ";
+            effects += "kSettingEffect" + enum_name(effect);
+        }
+        if (effects.empty()) effects = "kSettingEffectNone";
+
+        out << "  {\"" << escape_cpp_string(field.key) << "\", ConfigFieldType::"
+            << enum_name(field.type) << ",\n";
+        out << "   " << (field.type == "bool" ? member : "nullptr") << ", "
+            << (field.type == "int" ? member : "nullptr") << ", "
+            << (field.type == "string" ? member : "nullptr") << ",\n";
+        out << "   SettingResponse::" << enum_name(field.response) << ", "
+            << (field.response == "has_flag" ? quoted_or_null(field.has_key) : "nullptr") << ", "
+            << (default_bool ? "true" : "false") << ", " << default_int << ", \""
+            << escape_cpp_string(default_string) << "\",\n";
+        out << "   SettingUpdate::" << enum_name(field.update) << ", "
+            << quoted_or_null(field.alias) << ", " << (field.has_range ? "true" : "false")
+            << ", " << field.min_value << ", " << field.max_value << ", " << field.min_length
+            << ", " << field.max_length << ", " << effects << "},\n";
+    }
+    out << "};\n\n";
+
+    std::vector<std::size_t> by_key(fields.size());
+    for (std::size_t i = 0; i < fields.size(); ++i) by_key[i] = i;
+    std::sort(by_key.begin(), by_key.end(), [&](std::size_t a, std::size_t b) {
+        return fields[a].key < fields[b].key;
+    });
+    out << "// Indices into kConfigFields sorted by key.\n";
+    out << "inline constexpr std::size_t kConfigFieldsByKey[] = {";
+    for (std::size_t i = 0; i < by_key.size(); ++i) {
+        out << (i % 12 == 0 ? "\n    " : " ") << by_key[i] << ",";
+    }
+    out << "\n};\n\n";
+
+    out << "// Returns the field stored under key, or nullptr.\n";
+    out << "inline const ConfigField* find_config_field(std::string_view key) {\n";
+    out << "  std::size_t low = 0;\n";
+    out << "  std::size_t high = sizeof(kConfigFieldsByKey) / sizeof(kConfigFieldsByKey[0]);\n";
+    out << "  while (low < high) {\n";
+    out << "    const std::size_t mid = low + (high - low) / 2;\n";
+    out << "    const ConfigField& field = kConfigFields[kConfigFieldsByKey[mid]];\n";
+    out << "    const int order = key.compare(field.key);\n";
+    out << "    if (order == 0) {\n";
+    out << "      return &field;\n";
+    out << "    }\n";
+    out << "    if (order < 0) {\n";
+    out << "      high = mid;\n";
+    out << "    } else {\n";
+    out << "      low = mid + 1;\n";
+    out << "    }\n";
+    out << "  }\n";
+    out << "  return nullptr;\n";
+    out << "}\n\n";
+
+    out << "}  // namespace sysutil\n";
+}
+
+int main(int argc, char* argv[]) {
+    // Ensure standard C locale for consistent JSON parsing (e.g. decimal dots)
+    std::setlocale(LC_ALL, "C");
+
+    std::string input_path;
+    std::string output_path;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--input" && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output_path = argv[++i];
+        }
+    }
+
+    if (input_path.empty() || output_path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --input <json> --output <header>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream ifs(input_path);
+    if (!ifs) {
+        std::cerr << "Failed to open input: " << input_path << std::endl;
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << ifs.rdbuf();
+    JsonParser parser(buffer.str());
+
+    try {
+        auto root = parser.parse();
+        if (!root || !root->is_object()) {
+            std::cerr << "Invalid JSON root" << std::endl;
+            return 1;
+        }
+
+        std::vector<FieldSpec> fields;
+        std::set<std::string> names;
+        std::set<std::string> keys;
+        for (const auto& value : root->as_object().at("fields")->as_array()) {
+            FieldSpec field = parse_field(*value);
+            if (!names.insert(field.name).second) {
+                throw std::runtime_error("Duplicate config field: " + field.name);
+            }
+            if (!keys.insert(field.key).second) {
+                throw std::runtime_error("Duplicate config key: " + field.key);
+            }
+            fields.push_back(std::move(field));
+        }
+
+        std::ofstream ofs(output_path);
+        if (!ofs) {
+            std::cerr << "Failed to open output: " << output_path << std::endl;
+            return 1;
+        }
+        render_header(fields, ofs);
+
+    } catch (const std::exception& e) {
+        std::cerr << "Config schema error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
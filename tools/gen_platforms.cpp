@@ -10,280 +10,12 @@
 #include <stdexcept>
 #include <utility>
 
-// -----------------------------------------------------------------------------
-// Minimal JSON DOM & Parser
-// -----------------------------------------------------------------------------
-
-enum class JsonType { Null, Object, Array, String, Number, Boolean };
-
-struct JsonValue;
-
-using JsonObject = std::map<std::string, std::shared_ptr<JsonValue>>;
-using JsonArray = std::vector<std::shared_ptr<JsonValue>>;
-
-struct JsonValue {
-    JsonType type = JsonType::Null;
-    JsonObject object_val;
-    JsonArray array_val;
-    std::string string_val;
-    double number_val = 0.0;
-    bool bool_val = false;
-
-    bool is_object() const { return type == JsonType::Object; }
-    bool is_array() const { return type == JsonType::Array; }
-    bool is_string() const { return type == JsonType::String; }
-    bool is_number() const { return type == JsonType::Number; }
-    bool is_bool() const { return type == JsonType::Boolean; }
-    bool is_null() const { return type == JsonType::Null; }
-
-    const JsonObject& as_object() const { return object_val; }
-    const JsonArray& as_array() const { return array_val; }
-    const std::string& as_string() const { return string_val; }
-    double as_number() const { return number_val; }
-    bool as_bool() const { return bool_val; }
-};
-
-class JsonParser {
-public:
-    explicit JsonParser(std::string input) : input_(std::move(input)), pos_(0) {}
-
-    std::shared_ptr<JsonValue> parse() {
-        skip_whitespace();
-        if (pos_ >= input_.size()) return nullptr;
-        return parse_value();
-    }
-
-private:
-    std::string input_;
-    size_t pos_;
-
-    void skip_whitespace() {
-        while (pos_ < input_.size()) {
-            unsigned char c = static_cast<unsigned char>(input_[pos_]);
-            if (std::isspace(c)) {
-                pos_++;
-            } else {
-                break;
-            }
-        }
-    }
-
-    std::shared_ptr<JsonValue> parse_value() {
-        skip_whitespace();
-        if (pos_ >= input_.size()) return nullptr;
-
-        char c = input_[pos_];
-        if (c == '{') return parse_object();
-        if (c == '[') return parse_array();
-        if (c == '"') return parse_string();
-        if (c == 't' || c == 'f') return parse_bool();
-        if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) return parse_number();
-        if (c == 'n') {
-            if (input_.compare(pos_, 4, "null") == 0) {
-                pos_ += 4;
-                return std::make_shared<JsonValue>();
-            }
-        }
-
-        throw std::runtime_error("Unexpected character at pos " + std::to_string(pos_) +
-                                 ": '" + std::string(1, c) + "'");
-    }
-
-    std::shared_ptr<JsonValue> parse_object() {
-        auto val = std::make_shared<JsonValue>();
-        val->type = JsonType::Object;
-        pos_++; // skip '{'
-
-        skip_whitespace();
-        if (pos_ < input_.size() && input_[pos_] == '}') {
-            pos_++;
-            return val;
-        }
-
-        while (true) {
-            skip_whitespace();
-            if (pos_ >= input_.size()) throw std::runtime_error("Unexpected end in object");
-
-            if (input_[pos_] != '"') {
-                 throw std::runtime_error("Expected string key in object at pos " + std::to_string(pos_));
-            }
-            auto key_val = parse_string();
-            std::string key = key_val->as_string();
-
-            skip_whitespace();
-            if (pos_ >= input_.size() || input_[pos_] != ':') throw std::runtime_error("Expected ':'");
-            pos_++;
-
-            val->object_val[key] = parse_value();
-
-            skip_whitespace();
-            if (pos_ >= input_.size()) throw std::runtime_error("Unexpected end in object");
-
-            if (input_[pos_] == '}') {
-                pos_++;
-                break;
-            }
-            if (input_[pos_] == ',') {
-                pos_++;
-            } else {
-                throw std::runtime_error("Expected ',' or '}' in object");
-            }
-        }
-        return val;
-    }
-
-    std::shared_ptr<JsonValue> parse_array() {
-        auto val = std::make_shared<JsonValue>();
-        val->type = JsonType::Array;
-        pos_++; // skip '['
-
-        skip_whitespace();
-        if (pos_ < input_.size() && input_[pos_] == ']') {
-            pos_++;
-            return val;
-        }
-
-        while (true) {
-            val->array_val.push_back(parse_value());
-
-            skip_whitespace();
-            if (pos_ >= input_.size()) throw std::runtime_error("Unexpected end in array");
-
-            if (input_[pos_] == ']') {
-                pos_++;
-                break;
-            }
-            if (input_[pos_] == ',') {
-                pos_++;
-            } else {
-                throw std::runtime_error("Expected ',' or ']'");
-            }
-        }
-        return val;
-    }
-
-    void append_utf8(std::string& out, int cp) {
-        if (cp < 0x80) {
-            out += static_cast<char>(cp);
-        } else if (cp < 0x800) {
-            out += static_cast<char>(0xC0 | (cp >> 6));
-            out += static_cast<char>(0x80 | (cp & 0x3F));
-        } else if (cp < 0x10000) {
-            out += static_cast<char>(0xE0 | (cp >> 12));
-            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-            out += static_cast<char>(0x80 | (cp & 0x3F));
-        } else {
-            out += static_cast<char>(0xF0 | (cp >> 18));
-            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
-            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-            out += static_cast<char>(0x80 | (cp & 0x3F));
-        }
-    }
-
-    std::shared_ptr<JsonValue> parse_string() {
-        auto val = std::make_shared<JsonValue>();
-        val->type = JsonType::String;
-        pos_++; // skip '"'
-
-        std::string res;
-        while (pos_ < input_.size()) {
-            char c = input_[pos_];
-            if (c == '"') {
-                pos_++;
-                val->string_val = res;
-                return val;
-            }
-            if (c == '\\') {
-                pos_++;
-                if (pos_ >= input_.size()) throw std::runtime_error("Unterminated escape sequence");
-                char esc = input_[pos_];
-                if (esc == '"') res += '"';
-                else if (esc == '\\') res += '\\';
-                else if (esc == '/') res += '/';
-                else if (esc == 'b') res += '\b';
-                else if (esc == 'f') res += '\f';
-                else if (esc == 'n') res += '\n';
-                else if (esc == 'r') res += '\r';
-                else if (esc == 't') res += '\t';
-                else if (esc == 'u') {
-                    pos_++; // skip 'u'
-                    if (pos_ + 4 > input_.size()) throw std::runtime_error("Incomplete unicode escape");
-                    std::string hex = input_.substr(pos_, 4);
-                    try {
-                        int cp = std::stoi(hex, nullptr, 16);
-                        append_utf8(res, cp);
-                    } catch (...) {
-                         throw std::runtime_error("Invalid unicode escape");
-                    }
-                    pos_ += 4;
-                    // decrement because loop increments
-                    pos_--;
-                }
-                else res += esc;
-                pos_++;
-            } else {
-                res += c;
-                pos_++;
-            }
-        }
-        throw std::runtime_error("Unterminated string");
-    }
-
-    std::shared_ptr<JsonValue> parse_bool() {
-        auto val = std::make_shared<JsonValue>();
-        val->type = JsonType::Boolean;
-        if (input_.compare(pos_, 4, "true") == 0) {
-            val->bool_val = true;
-            pos_ += 4;
-        } else {
-            val->bool_val = false;
-            pos_ += 5;
-        }
-        return val;
-    }
-
-    std::shared_ptr<JsonValue> parse_number() {
-        auto val = std::make_shared<JsonValue>();
-        val->type = JsonType::Number;
-        size_t start = pos_;
-        if (pos_ < input_.size() && input_[pos_] == '-') pos_++;
-        while (pos_ < input_.size() && std::isdigit(static_cast<unsigned char>(input_[pos_]))) pos_++;
-        if (pos_ < input_.size() && input_[pos_] == '.') {
-            pos_++;
-            while (pos_ < input_.size() && std::isdigit(static_cast<unsigned char>(input_[pos_]))) pos_++;
-        }
-        if (pos_ < input_.size() && (input_[pos_] == 'e' || input_[pos_] == 'E')) {
-            pos_++;
-            if (pos_ < input_.size() && (input_[pos_] == '+' || input_[pos_] == '-')) pos_++;
-            while (pos_ < input_.size() && std::isdigit(static_cast<unsigned char>(input_[pos_]))) pos_++;
-        }
-
-        try {
-             val->number_val = std::stod(input_.substr(start, pos_ - start));
-        } catch (...) {
-             throw std::runtime_error("Invalid number format at pos " + std::to_string(start));
-        }
-        return val;
-    }
-};
+#include "gen_json.h"
 
 // -----------------------------------------------------------------------------
 // C++ Code Generator
 // -----------------------------------------------------------------------------
 
-std::string escape_cpp_string(const std::string& value) {
-    std::string out;
-    for (char ch : value) {
-        if (ch == '\\') out += "\\\\";
-        else if (ch == '"') out += "\\\"";
-        else if (ch == '\n') out += "\\n";
-        else if (ch == '\r') out += "\\r";
-        else if (ch == '\t') out += "\\t";
-        else out += ch;
-    }
-    return out;
-}
-
 void render_header(std::shared_ptr<JsonValue> root, std::ostream& out) {
     auto& obj = root->as_object();
     auto platforms = obj.at("platforms")->as_array();